@@ -0,0 +1,34 @@
+cmake_minimum_required(VERSION 3.18 FATAL_ERROR)
+
+# Project Info
+enable_language(C)
+enable_language(CXX)
+
+# CMake Settings
+# Set the source and binary directories explicitly
+set(BENCH_SOURCE_DIR ${CMAKE_CURRENT_SOURCE_DIR}/bench/ecs)
+set(BENCH_BINARY_DIR ${CMAKE_BINARY_DIR}/bench/ecs)
+
+set(BENCH_SOURCE_FILES ${BENCH_SOURCE_DIR}/src/main.cpp)
+
+# Add executable, runs headless and writes results as JSON
+add_executable(
+    mara_bench_ecs
+    "${BENCH_SOURCE_FILES}"
+)
+
+# Link to the engine
+target_link_libraries(
+    mara_bench_ecs
+    mara
+)
+
+# Change output directory for executable
+set_target_properties(mara_bench_ecs PROPERTIES
+    RUNTIME_OUTPUT_DIRECTORY ${BENCH_BINARY_DIR}/bin
+)
+
+# Change working directory to bin (for MSVC)
+if (CMAKE_CXX_COMPILER_ID MATCHES "MSVC")
+    set_property(TARGET mara_bench_ecs PROPERTY VS_DEBUGGER_WORKING_DIRECTORY ${BENCH_BINARY_DIR})
+endif()
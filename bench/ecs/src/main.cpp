@@ -0,0 +1,402 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#include <mara/mara.h>
+
+#include <base/commandline.h>
+#include <base/timer.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace
+{
+	MARA_DEFINE_COMPONENT(kPosition);
+	MARA_DEFINE_COMPONENT(kVelocity);
+	MARA_DEFINE_COMPONENT(kTag);
+
+	struct Position
+	{
+		F32 x, y, z;
+	};
+
+	struct Velocity
+	{
+		F32 x, y, z;
+	};
+
+	static const U32 kMaxSamples = 64;
+
+	/// Default time to first frame budget, headless `mara::init` plus first `mara::update`.
+	static const I64 kStartupBudgetUs = 5000;
+
+	struct Result
+	{
+		const char* name;
+		U32 numEntities;
+		U32 numSamples;
+		I64 samples[kMaxSamples];
+	};
+
+	static Result s_results[128];
+	static U32 s_numResults = 0;
+	static Result s_startup;
+
+	static mara::EntityHandle* s_entities = NULL;
+	static mara::EntityHandle* s_shuffled = NULL;
+	static volatile F32 s_sink = 0.0f;
+
+	static I64 ticksToNs(I64 _ticks)
+	{
+		return _ticks * 1000000000 / base::getHPFrequency();
+	}
+
+	static int compareI64(const void* _a, const void* _b)
+	{
+		const I64 a = *(const I64*)_a;
+		const I64 b = *(const I64*)_b;
+		return a < b ? -1 : (a > b ? 1 : 0);
+	}
+
+	/// Release handles of destroyed entities, handles are recycled by `mara::update`.
+	static void flush()
+	{
+		mara::update(0, 0);
+	}
+
+	static void createWorld(U32 _num)
+	{
+		mara::createEntities(_num, kPosition | kVelocity, s_entities);
+
+		for (U32 ii = 0; ii < _num; ++ii)
+		{
+			Position* pos = (Position*)mara::getComponentData(s_entities[ii], kPosition);
+			pos->x = F32(ii);
+			pos->y = 0.0f;
+			pos->z = 0.0f;
+
+			Velocity* vel = (Velocity*)mara::getComponentData(s_entities[ii], kVelocity);
+			vel->x = 1.0f;
+			vel->y = 2.0f;
+			vel->z = 3.0f;
+		}
+	}
+
+	static void destroyWorld(U32 _num)
+	{
+		mara::destroyEntities(s_entities, _num);
+		flush();
+	}
+
+	/// Runs `_fn` once per sample, `_setup` and `_teardown` are not measured.
+	template<typename SetupT, typename FnT, typename TeardownT>
+	static void measure(Result& _result, const char* _name, U32 _num, U32 _numSamples, SetupT _setup, FnT _fn, TeardownT _teardown)
+	{
+		Result& result = _result;
+		result.name = _name;
+		result.numEntities = _num;
+		result.numSamples = base::min<U32>(_numSamples, kMaxSamples);
+
+		for (U32 ii = 0; ii < result.numSamples; ++ii)
+		{
+			_setup();
+
+			const I64 start = base::getHPCounter();
+			_fn();
+			result.samples[ii] = ticksToNs(base::getHPCounter() - start);
+
+			_teardown();
+		}
+
+		qsort(result.samples, result.numSamples, sizeof(I64), compareI64);
+	}
+
+	template<typename SetupT, typename FnT, typename TeardownT>
+	static void bench(const char* _name, U32 _num, U32 _numSamples, SetupT _setup, FnT _fn, TeardownT _teardown)
+	{
+		measure(s_results[s_numResults++], _name, _num, _numSamples, _setup, _fn, _teardown);
+	}
+
+	static void none()
+	{
+	}
+
+	/// Context construction, init and first frame, with empty world.
+	static void benchStartup(const mara::Init& _init, U32 _numSamples)
+	{
+		measure(s_startup, "startup", 0, _numSamples
+			, none
+			, [&]()
+			{
+				mara::init(_init);
+				mara::update(0, 0);
+			}
+			, []()
+			{
+				mara::shutdown();
+			}
+			);
+	}
+
+	static void run(U32 _num, U32 _numSamples)
+	{
+		// Create and destroy.
+		bench("create_single", _num, _numSamples
+			, none
+			, [_num]()
+			{
+				for (U32 ii = 0; ii < _num; ++ii)
+				{
+					s_entities[ii] = mara::createEntity();
+					mara::addComponent(s_entities[ii], kPosition, NULL);
+					mara::addComponent(s_entities[ii], kVelocity, NULL);
+				}
+			}
+			, [_num]() { destroyWorld(_num); }
+			);
+
+		bench("create_batch", _num, _numSamples
+			, none
+			, [_num]() { mara::createEntities(_num, kPosition | kVelocity, s_entities); }
+			, [_num]() { destroyWorld(_num); }
+			);
+
+		bench("destroy_single", _num, _numSamples
+			, [_num]() { createWorld(_num); }
+			, [_num]()
+			{
+				for (U32 ii = 0; ii < _num; ++ii)
+				{
+					mara::destroy(s_entities[ii]);
+				}
+			}
+			, flush
+			);
+
+		bench("destroy_batch", _num, _numSamples
+			, [_num]() { createWorld(_num); }
+			, [_num]() { mara::destroyEntities(s_entities, _num); }
+			, flush
+			);
+
+		// Structural changes on existing entities.
+		createWorld(_num);
+
+		bench("add_component", _num, _numSamples
+			, none
+			, [_num]()
+			{
+				for (U32 ii = 0; ii < _num; ++ii)
+				{
+					mara::addComponent(s_entities[ii], kTag, NULL);
+				}
+			}
+			, [_num]()
+			{
+				for (U32 ii = 0; ii < _num; ++ii)
+				{
+					mara::removeComponent(s_entities[ii], kTag);
+				}
+			}
+			);
+
+		bench("remove_component", _num, _numSamples
+			, [_num]()
+			{
+				for (U32 ii = 0; ii < _num; ++ii)
+				{
+					mara::addComponent(s_entities[ii], kTag, NULL);
+				}
+			}
+			, [_num]()
+			{
+				for (U32 ii = 0; ii < _num; ++ii)
+				{
+					mara::removeComponent(s_entities[ii], kTag);
+				}
+			}
+			, none
+			);
+
+		// Reads.
+		bench("query_entities", _num, _numSamples
+			, none
+			, []()
+			{
+				const mara::EntityQuery* query = mara::queryEntities(kPosition | kVelocity);
+				s_sink = s_sink + F32(query->m_count);
+			}
+			, flush
+			);
+
+		for (U32 ii = 0; ii < _num; ++ii)
+		{
+			s_shuffled[ii] = s_entities[ii];
+		}
+
+		for (U32 ii = _num - 1; ii > 0; --ii)
+		{
+			const U32 jj = U32(rand() ) % (ii + 1);
+			base::swap(s_shuffled[ii], s_shuffled[jj]);
+		}
+
+		bench("get_component_random", _num, _numSamples
+			, none
+			, [_num]()
+			{
+				F32 sum = 0.0f;
+				for (U32 ii = 0; ii < _num; ++ii)
+				{
+					const Position* pos = (const Position*)mara::getComponentData(s_shuffled[ii], kPosition);
+					sum += pos->x;
+				}
+
+				s_sink = s_sink + sum;
+			}
+			, none
+			);
+
+		bench("iterate_linear", _num, _numSamples
+			, none
+			, []()
+			{
+				mara::EntityChunk chunks[1024];
+				const U32 numChunks = mara::queryChunks(kPosition | kVelocity, chunks, BASE_COUNTOF(chunks) );
+
+				for (U32 ii = 0; ii < numChunks; ++ii)
+				{
+					Position* pos = (Position*)mara::getChunkData(chunks[ii], kPosition);
+					const Velocity* vel = (const Velocity*)mara::getChunkData(chunks[ii], kVelocity);
+
+					for (U32 jj = 0, num = chunks[ii].m_count; jj < num; ++jj)
+					{
+						pos[jj].x += vel[jj].x;
+						pos[jj].y += vel[jj].y;
+						pos[jj].z += vel[jj].z;
+					}
+				}
+			}
+			, none
+			);
+
+		destroyWorld(_num);
+	}
+
+	static void writeJson(FILE* _file, U32 _numWorkers, I64 _startupBudgetNs)
+	{
+		fprintf(_file, "{\n");
+		fprintf(_file, "\t\"benchmark\": \"mara_bench_ecs\",\n");
+		fprintf(_file, "\t\"max_entities\": %d,\n", MARA_CONFIG_MAX_ENTITIES);
+		fprintf(_file, "\t\"workers\": %u,\n", _numWorkers);
+		fprintf(_file
+			, "\t\"startup\": { \"samples\": %u, \"min_ns\": %lld, \"median_ns\": %lld, \"budget_ns\": %lld, \"within_budget\": %s },\n"
+			, s_startup.numSamples
+			, (long long)s_startup.samples[0]
+			, (long long)s_startup.samples[s_startup.numSamples / 2]
+			, (long long)_startupBudgetNs
+			, s_startup.samples[s_startup.numSamples / 2] <= _startupBudgetNs ? "true" : "false"
+			);
+		fprintf(_file, "\t\"results\": [\n");
+
+		for (U32 ii = 0; ii < s_numResults; ++ii)
+		{
+			const Result& result = s_results[ii];
+			const I64 min = result.samples[0];
+			const I64 median = result.samples[result.numSamples / 2];
+
+			fprintf(_file
+				, "\t\t{ \"name\": \"%s\", \"entities\": %u, \"samples\": %u, \"min_ns\": %lld, \"median_ns\": %lld, \"ns_per_entity\": %.3f }%s\n"
+				, result.name
+				, result.numEntities
+				, result.numSamples
+				, (long long)min
+				, (long long)median
+				, F64(min) / F64(result.numEntities)
+				, ii + 1 < s_numResults ? "," : ""
+				);
+		}
+
+		fprintf(_file, "\t]\n");
+		fprintf(_file, "}\n");
+	}
+
+} // namespace
+
+int _main_(int _argc, char** _argv)
+{
+	base::CommandLine cmdLine(_argc, _argv);
+
+	// Usage: mara_bench_ecs [--samples N] [--out results.json] [--startup-budget-us N]
+	const char* samplesArg = cmdLine.findOption("samples");
+	const U32 numSamples = base::max<U32>(NULL != samplesArg ? U32(atoi(samplesArg) ) : 9, 1);
+	const char* outPath = cmdLine.findOption("out");
+	const char* budgetArg = cmdLine.findOption("startup-budget-us");
+	const I64 startupBudgetNs = (NULL != budgetArg ? I64(atoi(budgetArg) ) : kStartupBudgetUs) * 1000;
+
+	mara::Init init;
+	init.headless = true;
+	init.numWorkers = 0;
+
+	// Measured before entity benchmarks, so their allocations don't affect it.
+	benchStartup(init, numSamples);
+
+	if (!mara::init(init) )
+	{
+		fprintf(stderr, "Failed to initialize mara.\n");
+		return EXIT_FAILURE;
+	}
+
+	mara::registerComponent(kPosition, sizeof(Position) );
+	mara::registerComponent(kVelocity, sizeof(Velocity) );
+	mara::registerComponent(kTag, sizeof(U32) );
+
+	// Entity handles are 16 bit, largest size is clamped to what config allows.
+	const U32 sizes[] = { 1000, 10000, 100000 };
+	const U32 maxEntities = MARA_CONFIG_MAX_ENTITIES - 1;
+
+	s_entities = (mara::EntityHandle*)malloc(maxEntities * sizeof(mara::EntityHandle) );
+	s_shuffled = (mara::EntityHandle*)malloc(maxEntities * sizeof(mara::EntityHandle) );
+	srand(1337);
+
+	U32 last = 0;
+	for (U32 ii = 0; ii < BASE_COUNTOF(sizes); ++ii)
+	{
+		const U32 num = base::min(sizes[ii], maxEntities);
+		if (num != last)
+		{
+			run(num, numSamples);
+			last = num;
+		}
+	}
+
+	FILE* file = NULL != outPath ? fopen(outPath, "w") : stdout;
+	if (NULL == file)
+	{
+		fprintf(stderr, "Failed to open %s.\n", outPath);
+		file = stdout;
+	}
+
+	writeJson(file, mara::getNumWorkers(), startupBudgetNs);
+
+	if (stdout != file)
+	{
+		fclose(file);
+	}
+
+	free(s_shuffled);
+	free(s_entities);
+
+	mara::shutdown();
+
+	// Non zero exit code lets CI catch time to first frame regressions.
+	const I64 startupNs = s_startup.samples[s_startup.numSamples / 2];
+	if (startupNs > startupBudgetNs)
+	{
+		fprintf(stderr, "Startup took %lld ns, budget is %lld ns.\n", (long long)startupNs, (long long)startupBudgetNs);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -9,6 +9,7 @@
 #include <base/types.h>
 #include <base/readerwriter.h>
 #include <base/handlealloc.h>
+#include <base/bounds.h>
 
 #include <graphics/entry.h>
 #include <graphics/graphics.h>
@@ -24,7 +25,7 @@
 
 #define MARA_INVALID_HANDLE { mara::kInvalidHandle }
 
-#define MARA_DEFINE_COMPONENT(name) static const U32 name = (1u << __COUNTER__);
+#define MARA_DEFINE_COMPONENT(name) static const mara::ComponentType name = { U16(__COUNTER__) };
 
 /// MARA
 namespace mara 
@@ -53,6 +54,9 @@ namespace mara
 	MARA_HANDLE(MaterialHandle)
 	MARA_HANDLE(MeshHandle)
 	MARA_HANDLE(PrefabHandle)
+	MARA_HANDLE(QueryHandle)
+	MARA_HANDLE(SystemHandle)
+	MARA_HANDLE(ObserverHandle)
 
 	/// Callback interface to implement application specific behavior.
 	/// Cached items are currently used for OpenGL and Direct3D 12 binary
@@ -193,6 +197,148 @@ namespace mara
 	{
 	}
 
+	/// Component type, index of component bit in `mara::ComponentMask`.
+	///
+	struct ComponentType
+	{
+		U16 idx;
+	};
+
+	/// Set of component types, with one bit per component type. Types are
+	/// combined with `|`, e.g. `createQuery(Position | Velocity)`.
+	///
+	struct ComponentMask
+	{
+		static const U32 kNumWords = MARA_CONFIG_MAX_COMPONENT_TYPES / 64;
+
+		///
+		ComponentMask()
+		{
+			clear();
+		}
+
+		///
+		ComponentMask(ComponentType _type)
+		{
+			clear();
+			set(_type);
+		}
+
+		///
+		void clear()
+		{
+			for (U32 ii = 0; ii < kNumWords; ++ii)
+			{
+				m_bits[ii] = 0;
+			}
+		}
+
+		///
+		void set(ComponentType _type)
+		{
+			m_bits[_type.idx / 64] |= U64(1) << (_type.idx % 64);
+		}
+
+		///
+		void unset(ComponentType _type)
+		{
+			m_bits[_type.idx / 64] &= ~(U64(1) << (_type.idx % 64) );
+		}
+
+		///
+		bool test(ComponentType _type) const
+		{
+			return 0 != (m_bits[_type.idx / 64] & (U64(1) << (_type.idx % 64) ) );
+		}
+
+		///
+		bool isEmpty() const
+		{
+			U64 bits = 0;
+			for (U32 ii = 0; ii < kNumWords; ++ii)
+			{
+				bits |= m_bits[ii];
+			}
+
+			return 0 == bits;
+		}
+
+		///
+		ComponentMask& operator|=(const ComponentMask& _other)
+		{
+			for (U32 ii = 0; ii < kNumWords; ++ii)
+			{
+				m_bits[ii] |= _other.m_bits[ii];
+			}
+
+			return *this;
+		}
+
+		BASE_ALIGN_DECL_16(U64 m_bits[kNumWords]);
+	};
+
+	///
+	inline ComponentMask operator|(const ComponentMask& _a, const ComponentMask& _b)
+	{
+		ComponentMask result = _a;
+		result |= _b;
+		return result;
+	}
+
+	/// System update function, called once per frame from `mara::update`.
+	///
+	/// @param[in] _userData User data passed to `mara::registerSystem`.
+	///
+	typedef void (*SystemFn)(void* _userData);
+
+	/// Observer function, called from `mara::update` once per frame for the
+	/// observed component type, if it was added to or removed from entities.
+	///
+	/// @param[in] _type Observed component type.
+	/// @param[in] _added Entities that have component now, but didn't have it
+	///   before, or had it removed and added again.
+	/// @param[in] _numAdded Number of entities in `_added`.
+	/// @param[in] _removed Entities that had component before, and lost it or
+	///   were destroyed.
+	/// @param[in] _numRemoved Number of entities in `_removed`.
+	/// @param[in] _userData User data passed to `mara::registerObserver`.
+	///
+	/// @remarks
+	///   Events are folded to net change of each entity since last call, entity
+	///   is at most once in each list. Component added and removed within frame
+	///   is not reported. Entity in both lists lost component first and got it
+	///   again after, which includes destroyed entity whose handle was reused.
+	///   Handle `_removed` before `_added`.
+	///
+	typedef void (*ObserverFn)(ComponentType _type, const EntityHandle* _added, U32 _numAdded, const EntityHandle* _removed, U32 _numRemoved, void* _userData);
+
+	/// Job function.
+	///
+	/// @param[in] _userData User data passed to `mara::runJob`.
+	///
+	typedef void (*JobFn)(void* _userData);
+
+	/// Parallel for job function, processes range [_begin, _end).
+	///
+	/// @param[in] _begin First index of range.
+	/// @param[in] _end One past last index of range.
+	/// @param[in] _userData User data passed to `mara::parallelFor`.
+	///
+	typedef void (*JobRangeFn)(U32 _begin, U32 _end, void* _userData);
+
+	/// Counts unfinished jobs, incremented when job is submitted and
+	/// decremented when it finishes. See: `mara::wait`.
+	///
+	struct JobCounter
+	{
+		JobCounter()
+			: m_value(0)
+		{
+		}
+
+		volatile I32 m_value;
+	};
+
 	/// Component interface to implement destructor for it's data.
 	///
 	struct BASE_NO_VTABLE ComponentI
@@ -205,6 +351,184 @@ namespace mara
 	{
 	}
 
+	/// Component destructor, called on component data before its memory is
+	/// released or reused.
+	///
+	/// @param[in] _data Component data.
+	///
+	typedef void (*ComponentDestroyFn)(void* _data);
+
+	/// Component storage used by `mara::registerComponent`.
+	///
+	struct ComponentStorage
+	{
+		/// Component storage enum.
+		///
+		enum Enum
+		{
+			Table,  //!< Stored in archetype chunks, fast iteration together with other components.
+			Sparse, //!< Stored in sparse set pool, fast add and remove without moving entity.
+			Singleton, //!< Single instance per world, not attached to entities. See: `mara::getSingletonData`.
+
+			Count
+		};
+	};
+
+	/// Sparse set of components indexed by entity. Component data is kept
+	/// tightly packed in dense array, sparse array maps entity index into it.
+	/// Elements are moved with `memcpy` on swap-remove, so component types
+	/// must be trivially relocatable.
+	///
+	struct ComponentPoolBase
+	{
+		///
+		ComponentPoolBase();
+
+		///
+		ComponentPoolBase(U32 _size, U32 _align, ComponentDestroyFn _destroyFn, base::AllocatorI* _allocator = NULL);
+
+		///
+		~ComponentPoolBase();
+
+		/// Initialize pool, `_allocator` NULL uses `entry::getAllocator()`.
+		///
+		void init(U32 _size, U32 _align, ComponentDestroyFn _destroyFn, base::AllocatorI* _allocator = NULL);
+
+		/// Destroy all components and release memory.
+		///
+		void shutdown();
+
+		/// Returns uninitialized memory for entity component, entity must not
+		/// already be in pool.
+		///
+		void* insert(EntityHandle _entity);
+
+		/// Destroy entity component and move last component into its place.
+		///
+		void remove(EntityHandle _entity);
+
+		/// Destroy all components.
+		///
+		void clear();
+
+		/// Returns entity component, or NULL if entity is not in pool.
+		///
+		void* get(EntityHandle _entity) const
+		{
+			if (_entity.idx >= m_sparseSize
+			||  UINT16_MAX == m_sparse[_entity.idx])
+			{
+				return NULL;
+			}
+
+			return m_dense + m_sparse[_entity.idx] * m_size;
+		}
+
+		///
+		bool has(EntityHandle _entity) const
+		{
+			return _entity.idx < m_sparseSize
+				&& UINT16_MAX != m_sparse[_entity.idx]
+				;
+		}
+
+		/// Returns number of components in pool.
+		///
+		U32 getNum() const
+		{
+			return m_num;
+		}
+
+		/// Returns entities owning components, in same order as component data.
+		///
+		const EntityHandle* getEntities() const
+		{
+			return m_entities;
+		}
+
+		///
+		void* getData() const
+		{
+			return m_dense;
+		}
+
+		/// Returns change tick of entity component, or 0 if entity is not in pool.
+		///
+		U32 getTick(EntityHandle _entity) const
+		{
+			return has(_entity) ? m_ticks[m_sparse[_entity.idx] ] : 0;
+		}
+
+		/// Set change tick of entity component, new components start with 0.
+		///
+		void setTick(EntityHandle _entity, U32 _tick)
+		{
+			if (has(_entity) )
+			{
+				m_ticks[m_sparse[_entity.idx] ] = _tick;
+			}
+		}
+
+		base::AllocatorI* m_allocator;
+		ComponentDestroyFn m_destroyFn;
+		U32 m_size;
+		U32 m_align;
+
+		U8* m_dense;
+		EntityHandle* m_entities;
+		U32* m_ticks;
+		U32 m_num;
+		U32 m_capacity;
+
+		U16* m_sparse;
+		U32 m_sparseSize;
+	};
+
+	/// Typed sparse set component pool. See: `mara::ComponentPoolBase`.
+	///
+	template<typename Ty>
+	struct ComponentPool : public ComponentPoolBase
+	{
+		///
+		ComponentPool(base::AllocatorI* _allocator = NULL)
+			: ComponentPoolBase(sizeof(Ty), alignof(Ty), destroy, _allocator)
+		{
+		}
+
+		/// Construct entity component in place.
+		///
+		template<typename... ArgsT>
+		Ty* emplace(EntityHandle _entity, ArgsT&&... _args)
+		{
+			return BASE_PLACEMENT_NEW(insert(_entity), Ty)(static_cast<ArgsT&&>(_args)...);
+		}
+
+		///
+		Ty* get(EntityHandle _entity) const
+		{
+			return (Ty*)ComponentPoolBase::get(_entity);
+		}
+
+		///
+		Ty* begin() const
+		{
+			return (Ty*)m_dense;
+		}
+
+		///
+		Ty* end() const
+		{
+			return (Ty*)m_dense + m_num;
+		}
+
+		///
+		static void destroy(void* _data)
+		{
+			BASE_UNUSED(_data);
+			((Ty*)_data)->~Ty();
+		}
+	};
+
 	///
 	struct BASE_NO_VTABLE ResourceI
 	{
@@ -238,6 +562,14 @@ namespace mara
 
 		/// Backbuffer resolution and reset parameters. See: `graphics::Resolution`.
 		graphics::Resolution resolution;
+
+		/// Number of job worker threads, not counting thread calling `mara::init`.
+		/// When set to UINT16_MAX number of hardware threads minus one is used.
+		U16 numWorkers;
+
+		/// Run without window events and renderer, only ECS, jobs and resources
+		/// not requiring graphics are usable. Intended for tools and benchmarks.
+		bool headless;
 	};
 
 	/// Engine statistics data.
@@ -257,10 +589,12 @@ namespace mara
 
 
 		U16 numPaks;			//!< Number of loaded of paks.
-		U16 numPakEntries;		//!< Number of loaded of pak entries.
+		U32 numPakEntries;		//!< Number of loaded of pak entries.
 		U16 numResources;		//!< Number of loaded resources.
 		U16 numEntities;		//!< Number of loaded entities.
 		U16 numComponents;		//!< Number of loaded components.
+		U16 numArchetypes;		//!< Number of created archetypes.
+		U16 numSystems;			//!< Number of registered systems.
 		U16 numGeometries;		//!< Number of loaded geometries.
 		U16 numShaders;			//!< Number of loaded shaders.
 		U16 numTextures;		//!< Number of loaded textures.
@@ -269,13 +603,94 @@ namespace mara
 		U16 numPrefabs;			//!< Number of loaded prefabs.
 	};
 
-	/// Queried entities data.
+	/// Queried entities data. Allocated from frame memory, valid until next
+	/// `mara::update` call.
 	///
 	struct EntityQuery
 	{
+		/// Returns data of optional component `_optional` for entity `_index`,
+		/// or NULL if entity doesn't have it. Optional components are numbered
+		/// in ascending component type order. See: `QueryFilter::optional`.
+		///
+		void* getOptional(U32 _index, U32 _optional) const
+		{
+			return m_optional[_optional * m_count + _index];
+		}
+
 		U32 m_count;				   //!< Number of queried entities.
-		EntityHandle m_entities[MARA_CONFIG_MAX_ENTITIES_TO_QUERY]; //!< List of queried entities.
-		// @todo Should be allocated on heap, making it dynamic
+		EntityHandle* m_entities;	   //!< List of queried entities.
+		U32 m_numOptional;			   //!< Number of optional component types.
+		void** m_optional;			   //!< Component data, `m_count` pointers per optional type.
+	};
+
+	/// Records structural changes from worker threads. See: `mara::getCommandBuffer`.
+	///
+	struct EntityCommandBuffer;
+
+	/// Additional conditions for `mara::queryEntities`.
+	///
+	struct QueryFilter
+	{
+		QueryFilter()
+			: m_changedSince(0)
+		{
+		}
+
+		/// Only match entities where any of `_types` was written at or after
+		/// frame `_frame`. See: `mara::getFrame`, `mara::getComponentDataMut`.
+		///
+		/// @param[in] _frame Frame number.
+		/// @param[in] _types Component types to check. If empty, all queried types
+		///   are checked.
+		///
+		QueryFilter& changedSince(U32 _frame, const ComponentMask& _types = ComponentMask() )
+		{
+			m_changedSince = _frame;
+			m_changed = _types;
+			return *this;
+		}
+
+		/// Don't match entities having any of `_types`.
+		///
+		QueryFilter& without(const ComponentMask& _types)
+		{
+			m_exclude |= _types;
+			return *this;
+		}
+
+		/// Only match entities having at least one of `_types`.
+		///
+		QueryFilter& anyOf(const ComponentMask& _types)
+		{
+			m_any |= _types;
+			return *this;
+		}
+
+		/// Return data pointers of `_types` with query result, NULL for entities
+		/// that don't have the component. Doesn't affect matching.
+		/// See: `EntityQuery::getOptional`.
+		///
+		QueryFilter& optional(const ComponentMask& _types)
+		{
+			m_optional |= _types;
+			return *this;
+		}
+
+		ComponentMask m_changed;
+		ComponentMask m_exclude;  //!< Entity must have none of these types.
+		ComponentMask m_any;      //!< Entity must have one of these types, if not empty.
+		ComponentMask m_optional; //!< Types returned when present.
+		U32 m_changedSince; //!< 0 disables change filter.
+	};
+
+	/// Chunk of entities sharing the same set of table components. Each
+	/// component type is stored as one tightly packed array inside the chunk.
+	///
+	struct EntityChunk
+	{
+		U16 m_archetype; //!< Archetype the chunk belongs to.
+		U16 m_chunk;	 //!< Chunk index inside archetype.
+		U32 m_count;	 //!< Number of entities in chunk.
 	};
 
 	///
@@ -300,6 +715,22 @@ namespace mara
 		UniformData parameters[MARA_CONFIG_MAX_UNIFORMS_PER_SHADER];
 	};
 
+	/// Resource load status.
+	///
+	struct ResourceStatus
+	{
+		/// Resource status enum.
+		///
+		enum Enum
+		{
+			Loading, //!< Being read by loader threads, or waiting for dependencies.
+			Ready,   //!< Resource and all resources it depends on are loaded.
+			Failed,  //!< Resource, or one of its dependencies, failed to load.
+
+			Count
+		};
+	};
+
 	///
 	struct ResourceInfo
 	{
@@ -403,13 +834,264 @@ namespace mara
 	void destroy(ComponentHandle _handle);
 
 	//
-	void addComponent(EntityHandle _entity, U32 _type, ComponentHandle _component);
+	void addComponent(EntityHandle _entity, ComponentType _type, ComponentHandle _component);
+
+	/// Register component type to be stored by value.
+	///
+	/// @param[in] _type Component type.
+	/// @param[in] _size Size of component data in bytes. Data is moved with
+	///   `memcpy`, so it must be trivially relocatable.
+	/// @param[in] _storage Store in archetype chunks, in sparse set pool, or
+	///   as single world instance. See: `mara::ComponentStorage`.
+	/// @param[in] _destroyFn Called on component data when it's removed from
+	///   entity, or entity is destroyed. Can be NULL.
+	///
+	void registerComponent(ComponentType _type, U32 _size, ComponentStorage::Enum _storage = ComponentStorage::Table, ComponentDestroyFn _destroyFn = NULL);
+
+	/// Add registered component to entity. Table components move entity to
+	/// matching archetype, sparse components are inserted into type pool.
+	///
+	/// @param[in] _entity Entity handle.
+	/// @param[in] _type Component type registered with `mara::registerComponent`.
+	/// @param[in] _data Component data to copy. If NULL data is zero initialized.
+	///
+	/// @returns Pointer to component data inside archetype chunk or pool.
+	///
+	void* addComponent(EntityHandle _entity, ComponentType _type, const void* _data);
+
+	/// Remove component from entity.
+	///
+	void removeComponent(EntityHandle _entity, ComponentType _type);
+
+	/// Returns component data for reading, or NULL if entity doesn't have component.
+	///
+	void* getComponentData(EntityHandle _entity, ComponentType _type);
+
+	/// Returns component data for writing and marks component as changed in
+	/// current frame.
+	///
+	void* getComponentDataMut(EntityHandle _entity, ComponentType _type);
+
+	/// Returns frame component was last added or written with
+	/// `mara::getComponentDataMut`, or 0 if entity doesn't have component.
+	///
+	U32 getComponentTick(EntityHandle _entity, ComponentType _type);
+
+	/// Returns singleton data for reading. Singleton is component type
+	/// registered with `ComponentStorage::Singleton`, its data is zero
+	/// initialized on registration. Systems should declare singleton type in
+	/// their read or write mask like any other component, so scheduler orders
+	/// conflicting systems.
+	///
+	void* getSingletonData(ComponentType _type);
+
+	/// Returns singleton data for writing and marks it as changed in current frame.
+	///
+	void* getSingletonDataMut(ComponentType _type);
+
+	/// Returns frame singleton was registered or last written with
+	/// `mara::getSingletonDataMut`.
+	///
+	U32 getSingletonTick(ComponentType _type);
+
+	/// Returns current frame number, incremented by `mara::update`. First frame is 1.
+	///
+	U32 getFrame();
+
+	/// Query entities containing all component types.
+	///
+	/// @param[in] _types Component types mask.
+	/// @param[in] _filter Additional conditions. See: `mara::QueryFilter`.
+	///
+	/// @returns Query result allocated from frame memory. Result must not be
+	///   freed, and it's valid until next `mara::update` call.
+	///
+	EntityQuery* queryEntities(const ComponentMask& _types, const QueryFilter& _filter = QueryFilter() );
+
+	/// Set world space bounds of entity and add it to spatial index used by
+	/// `mara::queryBox`, `mara::querySphere` and `mara::queryFrustum`.
+	///
+	void setEntityBounds(EntityHandle _entity, const base::Aabb& _aabb);
+
+	/// Remove entity from spatial index.
+	///
+	void removeEntityBounds(EntityHandle _entity);
+
+	/// Returns world space bounds of entity, or NULL if entity has no bounds.
+	///
+	const base::Aabb* getEntityBounds(EntityHandle _entity);
+
+	/// Query entities whose bounds overlap box.
+	///
+	/// @returns Query result allocated from frame memory, valid until next `mara::update` call.
+	///
+	EntityQuery* queryBox(const base::Aabb& _aabb);
+
+	/// Query entities whose bounds overlap sphere.
+	///
+	/// @returns Query result allocated from frame memory, valid until next `mara::update` call.
+	///
+	EntityQuery* querySphere(const base::Sphere& _sphere);
+
+	/// Query entities whose bounds are not fully behind any of planes.
+	///
+	/// @param[in] _planes Frustum planes with normals pointing inside, point
+	///   is inside plane if `dot(normal, point) + dist >= 0`.
+	/// @param[in] _num Number of planes.
+	///
+	/// @returns Query result allocated from frame memory, valid until next `mara::update` call.
+	///
+	EntityQuery* queryFrustum(const base::Plane* _planes, U32 _num = 6);
+
+	/// Query chunks of entities containing all registered component types.
+	///
+	/// @param[in] _types Component types mask.
+	/// @param[out] _outChunks Chunks matching query. If NULL only count is returned.
+	/// @param[in] _max Maximum number of chunks to write.
+	///
+	/// @returns Number of matching chunks.
+	///
+	U32 queryChunks(const ComponentMask& _types, EntityChunk* _outChunks, U32 _max);
+
+	/// Returns pointer to first element of component array inside chunk.
+	///
+	void* getChunkData(const EntityChunk& _chunk, ComponentType _type);
+
+	/// Returns entities stored inside chunk.
+	///
+	const EntityHandle* getChunkEntities(const EntityChunk& _chunk);
+
+	/// Returns per row change ticks of component array inside chunk. Systems
+	/// writing through `mara::getChunkData` should store `mara::getFrame` for
+	/// rows they modify.
+	///
+	U32* getChunkTicks(const EntityChunk& _chunk, ComponentType _type);
+
+	/// Add transform to entity. World matrix is computed from parent world
+	/// matrix and entity local matrix every `mara::update`, only for entities
+	/// whose local matrix or parent changed.
+	///
+	/// @param[in] _entity Entity handle.
+	/// @param[in] _parent Parent entity, must have transform. If invalid entity is root.
+	///
+	/// @returns True if transform was added.
+	///
+	bool addTransform(EntityHandle _entity, EntityHandle _parent = MARA_INVALID_HANDLE);
+
+	/// Remove transform from entity. Children become roots.
+	///
+	void removeTransform(EntityHandle _entity);
+
+	/// Change transform parent. Fails if `_parent` is `_entity` or one of its
+	/// descendants.
+	///
+	bool setTransformParent(EntityHandle _entity, EntityHandle _parent);
+
+	/// Returns transform parent, or invalid handle if entity is root.
+	///
+	EntityHandle getTransformParent(EntityHandle _entity);
+
+	/// Set 4x4 local matrix relative to parent.
+	///
+	/// @remarks
+	///   Systems can set local matrices of different entities concurrently.
+	///
+	void setLocalTransform(EntityHandle _entity, const F32* _mtx);
+
+	/// Returns 4x4 local matrix, or NULL if entity doesn't have transform.
+	///
+	const F32* getLocalTransform(EntityHandle _entity);
+
+	/// Returns 4x4 world matrix computed by last `mara::update`, or NULL if
+	/// entity doesn't have transform.
+	///
+	const F32* getWorldTransform(EntityHandle _entity);
+
+	/// Create persistent entity query. Matching entities are kept up to date
+	/// when components are added or removed, so iterating the query never rescans
+	/// the world.
+	///
+	/// @param[in] _include Component types entity must have.
+	/// @param[in] _exclude Component types entity must not have.
+	///
+	QueryHandle createQuery(const ComponentMask& _include, const ComponentMask& _exclude = ComponentMask() );
+
+	//
+	void destroy(QueryHandle _handle);
+
+	/// Returns number of entities matching query.
+	///
+	U32 getNumEntities(QueryHandle _handle);
+
+	/// Returns entities matching query. Pointer is valid until next structural change.
+	///
+	const EntityHandle* getEntities(QueryHandle _handle);
+
+	/// Register system that is run every frame from `mara::update`. Systems
+	/// that don't write component types the other reads or writes are run
+	/// concurrently on worker threads, conflicting systems run in registration
+	/// order.
+	///
+	/// @param[in] _name System name, used for profiling. Must outlive system.
+	/// @param[in] _fn System update function.
+	/// @param[in] _read Component types system reads.
+	/// @param[in] _write Component types system writes.
+	/// @param[in] _userData User data passed to `_fn`.
+	///
+	/// @remarks
+	///   Systems must not add or remove components, or create and destroy
+	///   entities while running.
+	///
+	SystemHandle registerSystem(const char* _name, SystemFn _fn, const ComponentMask& _read, const ComponentMask& _write, void* _userData = NULL);
 
 	//
-	void* getComponentData(EntityHandle _entity, U32 _type);
+	void destroy(SystemHandle _handle);
+
+	/// Register observer of component type. Add and remove events are collected
+	/// during frame and delivered in one batch from `mara::update`, after systems
+	/// ran and command buffers were played back.
+	///
+	/// @param[in] _type Observed component type.
+	/// @param[in] _fn Observer function.
+	/// @param[in] _userData User data passed to `_fn`.
+	///
+	/// @remarks
+	///   Changes made by observer are delivered next frame.
+	///
+	ObserverHandle registerObserver(ComponentType _type, ObserverFn _fn, void* _userData = NULL);
 
 	//
-	EntityQuery* queryEntities(U32 _types);
+	void destroy(ObserverHandle _handle);
+
+	/// Submit job to worker threads.
+	///
+	/// @param[in] _fn Job function.
+	/// @param[in] _userData User data passed to `_fn`.
+	/// @param[in] _counter Counter incremented now and decremented when job finishes.
+	///
+	/// @remarks
+	///   Only thread calling `mara::init`, or jobs and systems can submit jobs.
+	///
+	void runJob(JobFn _fn, void* _userData, JobCounter* _counter = NULL);
+
+	/// Split range [_begin, _end) into jobs of `_grainSize` indices each.
+	///
+	/// @param[in] _begin First index of range.
+	/// @param[in] _end One past last index of range.
+	/// @param[in] _grainSize Number of indices per job, 0 picks size from number of workers.
+	/// @param[in] _fn Range function.
+	/// @param[in] _userData User data passed to `_fn`.
+	/// @param[in] _counter Counter incremented for each submitted job.
+	///
+	void parallelFor(U32 _begin, U32 _end, U32 _grainSize, JobRangeFn _fn, void* _userData, JobCounter* _counter);
+
+	/// Wait until counter reaches zero, executing other jobs while waiting.
+	///
+	void wait(JobCounter* _counter);
+
+	/// Returns number of threads executing jobs, including thread calling `mara::init`.
+	///
+	U32 getNumWorkers();
 
 	//
 	EntityHandle createEntity();
@@ -417,24 +1099,125 @@ namespace mara
 	//
 	void destroy(EntityHandle _handle);
 
-	//
-	bool createPak(const base::FilePath& _filePath);
+	/// Create entities with zero initialized components in one batch.
+	///
+	/// @param[in] _num Number of entities to create.
+	/// @param[in] _types Registered component types to add to every entity.
+	/// @param[out] _outHandles Created entity handles, must hold `_num` handles.
+	///
+	/// @returns Number of created entities, less than `_num` if out of handles.
+	///
+	U32 createEntities(U32 _num, const ComponentMask& _types, EntityHandle* _outHandles);
 
-	//
-	bool loadPak(const base::FilePath& _filePath);
+	/// Destroy entities and their components in one batch.
+	///
+	/// @param[in] _handles Entities to destroy. Handles listed more than once, or
+	///   of entities already destroyed, are skipped.
+	/// @param[in] _num Number of handles in `_handles`.
+	///
+	void destroyEntities(const EntityHandle* _handles, U32 _num);
+
+	/// Returns command buffer of calling worker thread. Commands recorded into it
+	/// are played back at end of `mara::update`, after systems ran.
+	///
+	/// @remarks
+	///   Recording doesn't lock and doesn't touch world state, so systems and
+	///   jobs can change world structure while running.
+	///
+	EntityCommandBuffer* getCommandBuffer();
+
+	/// Set sort key of following commands. Commands from all buffers are played
+	/// back ordered by sort key, commands with same key keep recording order.
+	/// Use key unique to work item (e.g. chunk or entity index) for deterministic
+	/// playback independent of which worker recorded commands.
+	///
+	void setSortKey(EntityCommandBuffer* _ecb, U32 _sortKey);
+
+	/// Record entity creation.
+	///
+	/// @returns Placeholder handle, it can only be used with commands recorded
+	///   into same command buffer in same frame.
+	///
+	EntityHandle createEntity(EntityCommandBuffer* _ecb);
+
+	/// Record entity destruction.
+	///
+	void destroy(EntityCommandBuffer* _ecb, EntityHandle _handle);
+
+	/// Record adding registered component to entity, `_data` is copied into buffer.
+	///
+	void addComponent(EntityCommandBuffer* _ecb, EntityHandle _entity, ComponentType _type, const void* _data);
+
+	/// Record removing component from entity.
+	///
+	void removeComponent(EntityCommandBuffer* _ecb, EntityHandle _entity, ComponentType _type);
+
+	/// Write all loaded resources into pak.
+	///
+	/// @param[in] _filePath Pak file path.
+	/// @param[in] _compress Compress entries in blocks. Blocks are decompressed
+	///   in parallel on job workers when loaded. Entries that don't get smaller
+	///   are stored raw.
+	///
+	bool createPak(const base::FilePath& _filePath, bool _compress = false);
+
+	/// Load pak table of contents, resources inside pak can then be loaded by
+	/// path. When `_mapped` is true whole pak is memory mapped, and geometry,
+	/// shader and texture payloads reference mapping directly instead of being
+	/// copied. Falls back to file reads if pak can't be mapped. Table of
+	/// contents is read as one block and searched in place, so loading cost
+	/// doesn't depend on number of entries. Fails if pak was written by
+	/// different pak version.
+	///
+	bool loadPak(const base::FilePath& _filePath, bool _mapped = false);
 
 	//
 	bool unloadPak(const base::FilePath& _filePath);
 
+	/// Save all entities and their registered components to binary snapshot.
+	/// Component storage is written as raw blocks, preceded by schema of
+	/// component types.
+	///
+	/// @remarks
+	///   Components are saved bitwise, component types must not contain pointers.
+	///
+	bool saveWorld(const base::FilePath& _filePath);
+
+	/// Load snapshot written by `mara::saveWorld`. Entity handles keep their
+	/// saved values. Snapshot is read with single read and its blocks are copied
+	/// directly into component storage.
+	///
+	/// @remarks
+	///   World must have no entities, and component types must be registered
+	///   with same size and storage as when snapshot was saved.
+	///
+	bool loadWorld(const base::FilePath& _filePath);
+
 	// 
 	U32 getResourceInfo(ResourceInfo* _outInfoList, bool _sort = false);
 
+	/// Returns status of resource. Status of resources loaded with one of
+	/// `mara::load*Async` functions changes only inside `mara::update` and
+	/// `mara::waitResource`.
+	///
+	ResourceStatus::Enum getResourceStatus(ResourceHandle _handle);
+
+	/// Block until resource and its dependencies are loaded, or failed to load.
+	///
+	ResourceStatus::Enum waitResource(ResourceHandle _handle);
+
 	//
 	GeometryHandle createGeometry(ResourceHandle _resource);
 
 	//
 	ResourceHandle loadGeometry(const base::FilePath& _filePath);
 
+	/// Start loading geometry from loaded pak without blocking. Returned resource
+	/// is usable once `mara::getResourceStatus` returns `ResourceStatus::Ready`.
+	/// Returns invalid handle if resource is not in any loaded pak.
+	///
+	ResourceHandle loadGeometryAsync(const base::FilePath& _filePath);
+
 	//
 	ResourceHandle createResource(const GeometryCreate& _data, const base::FilePath& _vfp);
 
@@ -447,6 +1230,12 @@ namespace mara
 	//
 	ResourceHandle loadShader(const base::FilePath& _filePath);
 
+	/// Start loading shader from loaded pak without blocking. Returned resource
+	/// is usable once `mara::getResourceStatus` returns `ResourceStatus::Ready`.
+	/// Returns invalid handle if resource is not in any loaded pak.
+	///
+	ResourceHandle loadShaderAsync(const base::FilePath& _filePath);
+
 	//
 	ResourceHandle createResource(const ShaderCreate& _data, const base::FilePath& _vfp);
 
@@ -459,6 +1248,12 @@ namespace mara
 	//
 	ResourceHandle loadTexture(const base::FilePath& _filePath);
 
+	/// Start loading texture from loaded pak without blocking. Returned resource
+	/// is usable once `mara::getResourceStatus` returns `ResourceStatus::Ready`.
+	/// Returns invalid handle if resource is not in any loaded pak.
+	///
+	ResourceHandle loadTextureAsync(const base::FilePath& _filePath);
+
 	//
 	ResourceHandle createResource(const TextureCreate& _data, const base::FilePath& _vfp);
 
@@ -471,6 +1266,11 @@ namespace mara
 	//
 	ResourceHandle loadMaterial(const base::FilePath& _filePath);
 
+	/// Start loading material, and shaders and textures it uses, from loaded paks
+	/// without blocking. See: `mara::loadGeometryAsync`.
+	///
+	ResourceHandle loadMaterialAsync(const base::FilePath& _filePath);
+
 	//
 	ResourceHandle createResource(const MaterialCreate& _data, const base::FilePath& _vfp);
 
@@ -483,6 +1283,11 @@ namespace mara
 	//
 	ResourceHandle loadMesh(const base::FilePath& _filePath);
 
+	/// Start loading mesh, and material and geometry it uses, from loaded paks
+	/// without blocking. See: `mara::loadGeometryAsync`.
+	///
+	ResourceHandle loadMeshAsync(const base::FilePath& _filePath);
+
 	//
 	ResourceHandle createResource(const MeshCreate& _data, const base::FilePath& _vfp);
 
@@ -495,9 +1300,36 @@ namespace mara
 	//
 	PrefabHandle createPrefab(ResourceHandle _resource);
 
+	/// Create prefab capturing registered components of entity, and its local
+	/// transform, as template for `mara::instantiate`.
+	///
+	/// @remarks
+	///   Component payloads are copied bitwise, component types must not own
+	///   memory or other resources.
+	///
+	PrefabHandle createPrefab(EntityHandle _entity);
+
+	/// Create `_num` entities from prefab template. All instances are created
+	/// in one batch, component payloads are block copied into storage.
+	///
+	/// @param[in] _handle Prefab created with `mara::createPrefab(EntityHandle)`.
+	/// @param[in] _num Number of instances.
+	/// @param[in] _transforms `_num` 4x4 local matrices. If NULL, instances
+	///   get transform of template entity if it had one.
+	/// @param[out] _outEntities Created entities, can be NULL.
+	///
+	/// @returns Number of created entities.
+	///
+	U32 instantiate(PrefabHandle _handle, U32 _num, const F32* _transforms = NULL, EntityHandle* _outEntities = NULL);
+
 	//
 	ResourceHandle loadPrefab(const base::FilePath& _filePath);
 
+	/// Start loading prefab, and meshes it uses, from loaded paks without
+	/// blocking. See: `mara::loadGeometryAsync`.
+	///
+	ResourceHandle loadPrefabAsync(const base::FilePath& _filePath);
+
 	//
 	ResourceHandle createResource(const PrefabCreate& _data, const base::FilePath& _vfp);
 
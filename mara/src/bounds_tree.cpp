@@ -0,0 +1,383 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#include "mara_p.h"
+
+namespace mara
+{
+	static base::Aabb boundsMerge(const base::Aabb& _a, const base::Aabb& _b)
+	{
+		base::Aabb result;
+		result.min.x = base::min(_a.min.x, _b.min.x);
+		result.min.y = base::min(_a.min.y, _b.min.y);
+		result.min.z = base::min(_a.min.z, _b.min.z);
+		result.max.x = base::max(_a.max.x, _b.max.x);
+		result.max.y = base::max(_a.max.y, _b.max.y);
+		result.max.z = base::max(_a.max.z, _b.max.z);
+		return result;
+	}
+
+	static bool boundsContains(const base::Aabb& _outer, const base::Aabb& _inner)
+	{
+		return _outer.min.x <= _inner.min.x && _outer.max.x >= _inner.max.x
+			&& _outer.min.y <= _inner.min.y && _outer.max.y >= _inner.max.y
+			&& _outer.min.z <= _inner.min.z && _outer.max.z >= _inner.max.z
+			;
+	}
+
+	/// Half of surface area, used as insertion cost.
+	static F32 boundsArea(const base::Aabb& _aabb)
+	{
+		const F32 dx = _aabb.max.x - _aabb.min.x;
+		const F32 dy = _aabb.max.y - _aabb.min.y;
+		const F32 dz = _aabb.max.z - _aabb.min.z;
+		return dx*dy + dy*dz + dz*dx;
+	}
+
+	BoundsTree::BoundsTree()
+		: m_allocator(NULL)
+		, m_nodes(NULL)
+		, m_numNodes(0)
+		, m_capacity(0)
+		, m_free(UINT32_MAX)
+		, m_root(UINT32_MAX)
+		, m_leaf(NULL)
+		, m_bounds(NULL)
+		, m_leafSize(0)
+	{
+	}
+
+	void BoundsTree::init(base::AllocatorI* _allocator)
+	{
+		m_allocator = _allocator;
+	}
+
+	void BoundsTree::shutdown()
+	{
+		base::free(m_allocator, m_nodes);
+		base::free(m_allocator, m_leaf);
+		base::free(m_allocator, m_bounds);
+
+		m_nodes = NULL;
+		m_numNodes = 0;
+		m_capacity = 0;
+		m_free = UINT32_MAX;
+		m_root = UINT32_MAX;
+		m_leaf = NULL;
+		m_bounds = NULL;
+		m_leafSize = 0;
+	}
+
+	U32 BoundsTree::allocNode()
+	{
+		if (UINT32_MAX == m_free)
+		{
+			// Every leaf has one internal parent, except root.
+			const U32 capacity = base::max<U32>(m_capacity * 2, 64);
+			m_nodes = (Node*)base::realloc(m_allocator, m_nodes, capacity * sizeof(Node) );
+
+			for (U32 ii = m_capacity; ii < capacity; ++ii)
+			{
+				m_nodes[ii].m_parent = ii + 1 < capacity ? ii + 1 : UINT32_MAX;
+			}
+
+			m_free = m_capacity;
+			m_capacity = capacity;
+		}
+
+		const U32 idx = m_free;
+		Node& node = m_nodes[idx];
+		m_free = node.m_parent;
+
+		node.m_parent = UINT32_MAX;
+		node.m_child[0] = UINT32_MAX;
+		node.m_child[1] = UINT32_MAX;
+		node.m_height = 0;
+		node.m_entity.idx = kInvalidHandle;
+		++m_numNodes;
+
+		return idx;
+	}
+
+	void BoundsTree::freeNode(U32 _node)
+	{
+		m_nodes[_node].m_parent = m_free;
+		m_nodes[_node].m_height = -1;
+		m_free = _node;
+		--m_numNodes;
+	}
+
+	void BoundsTree::set(EntityHandle _entity, const base::Aabb& _aabb)
+	{
+		if (_entity.idx >= m_leafSize)
+		{
+			const U32 leafSize = base::max<U32>(base::max<U32>(m_leafSize * 2, 256), _entity.idx + 1);
+			m_leaf   = (U32*)base::realloc(m_allocator, m_leaf, leafSize * sizeof(U32) );
+			m_bounds = (base::Aabb*)base::realloc(m_allocator, m_bounds, leafSize * sizeof(base::Aabb) );
+			base::memSet(&m_leaf[m_leafSize], 0xff, (leafSize - m_leafSize) * sizeof(U32) );
+			m_leafSize = leafSize;
+		}
+
+		m_bounds[_entity.idx] = _aabb;
+
+		U32 leaf = m_leaf[_entity.idx];
+		if (UINT32_MAX != leaf)
+		{
+			if (boundsContains(m_nodes[leaf].m_aabb, _aabb) )
+			{
+				return;
+			}
+
+			removeLeaf(leaf);
+		}
+		else
+		{
+			leaf = allocNode();
+			m_nodes[leaf].m_entity = _entity;
+			m_leaf[_entity.idx] = leaf;
+		}
+
+		const F32 margin = MARA_CONFIG_BOUNDS_TREE_MARGIN;
+		base::Aabb& fat = m_nodes[leaf].m_aabb;
+		fat.min.x = _aabb.min.x - margin;
+		fat.min.y = _aabb.min.y - margin;
+		fat.min.z = _aabb.min.z - margin;
+		fat.max.x = _aabb.max.x + margin;
+		fat.max.y = _aabb.max.y + margin;
+		fat.max.z = _aabb.max.z + margin;
+
+		insertLeaf(leaf);
+	}
+
+	void BoundsTree::remove(EntityHandle _entity)
+	{
+		const U32 leaf = find(_entity);
+		if (UINT32_MAX == leaf)
+		{
+			return;
+		}
+
+		removeLeaf(leaf);
+		freeNode(leaf);
+		m_leaf[_entity.idx] = UINT32_MAX;
+	}
+
+	void BoundsTree::insertLeaf(U32 _leaf)
+	{
+		if (UINT32_MAX == m_root)
+		{
+			m_root = _leaf;
+			m_nodes[_leaf].m_parent = UINT32_MAX;
+			return;
+		}
+
+		// Descend towards sibling with lowest cost of enlarging ancestors.
+		const base::Aabb leafAabb = m_nodes[_leaf].m_aabb;
+		U32 idx = m_root;
+		while (!isLeaf(idx) )
+		{
+			const Node& node = m_nodes[idx];
+			const F32 area = boundsArea(node.m_aabb);
+			const F32 combinedArea = boundsArea(boundsMerge(node.m_aabb, leafAabb) );
+
+			// Cost of creating new parent for this node and the leaf.
+			const F32 cost = 2.0f * combinedArea;
+
+			// Minimum cost of pushing the leaf further down the tree.
+			const F32 inheritanceCost = 2.0f * (combinedArea - area);
+
+			F32 childCost[2];
+			for (U32 ii = 0; ii < 2; ++ii)
+			{
+				const Node& child = m_nodes[node.m_child[ii] ];
+				const F32 mergedArea = boundsArea(boundsMerge(child.m_aabb, leafAabb) );
+				childCost[ii] = isLeaf(node.m_child[ii])
+					? mergedArea + inheritanceCost
+					: mergedArea - boundsArea(child.m_aabb) + inheritanceCost
+					;
+			}
+
+			if (cost < childCost[0]
+			&&  cost < childCost[1])
+			{
+				break;
+			}
+
+			idx = node.m_child[childCost[0] < childCost[1] ? 0 : 1];
+		}
+
+		const U32 sibling = idx;
+		const U32 oldParent = m_nodes[sibling].m_parent;
+		const U32 newParent = allocNode();
+
+		Node& parent = m_nodes[newParent];
+		parent.m_parent = oldParent;
+		parent.m_aabb = boundsMerge(leafAabb, m_nodes[sibling].m_aabb);
+		parent.m_height = m_nodes[sibling].m_height + 1;
+		parent.m_child[0] = sibling;
+		parent.m_child[1] = _leaf;
+
+		if (UINT32_MAX != oldParent)
+		{
+			Node& op = m_nodes[oldParent];
+			op.m_child[op.m_child[0] == sibling ? 0 : 1] = newParent;
+		}
+		else
+		{
+			m_root = newParent;
+		}
+
+		m_nodes[sibling].m_parent = newParent;
+		m_nodes[_leaf].m_parent = newParent;
+
+		// Refit ancestors.
+		for (idx = m_nodes[_leaf].m_parent; UINT32_MAX != idx; idx = m_nodes[idx].m_parent)
+		{
+			idx = balance(idx);
+
+			Node& node = m_nodes[idx];
+			const Node& child0 = m_nodes[node.m_child[0] ];
+			const Node& child1 = m_nodes[node.m_child[1] ];
+			node.m_height = 1 + base::max(child0.m_height, child1.m_height);
+			node.m_aabb = boundsMerge(child0.m_aabb, child1.m_aabb);
+		}
+	}
+
+	void BoundsTree::removeLeaf(U32 _leaf)
+	{
+		if (_leaf == m_root)
+		{
+			m_root = UINT32_MAX;
+			return;
+		}
+
+		const U32 parent = m_nodes[_leaf].m_parent;
+		const U32 grandParent = m_nodes[parent].m_parent;
+		const U32 sibling = m_nodes[parent].m_child[m_nodes[parent].m_child[0] == _leaf ? 1 : 0];
+
+		freeNode(parent);
+		m_nodes[_leaf].m_parent = UINT32_MAX;
+
+		if (UINT32_MAX == grandParent)
+		{
+			m_root = sibling;
+			m_nodes[sibling].m_parent = UINT32_MAX;
+			return;
+		}
+
+		// Sibling takes place of removed parent.
+		Node& gp = m_nodes[grandParent];
+		gp.m_child[gp.m_child[0] == parent ? 0 : 1] = sibling;
+		m_nodes[sibling].m_parent = grandParent;
+
+		for (U32 idx = grandParent; UINT32_MAX != idx; idx = m_nodes[idx].m_parent)
+		{
+			idx = balance(idx);
+
+			Node& node = m_nodes[idx];
+			const Node& child0 = m_nodes[node.m_child[0] ];
+			const Node& child1 = m_nodes[node.m_child[1] ];
+			node.m_height = 1 + base::max(child0.m_height, child1.m_height);
+			node.m_aabb = boundsMerge(child0.m_aabb, child1.m_aabb);
+		}
+	}
+
+	U32 BoundsTree::balance(U32 _node)
+	{
+		const U32 iA = _node;
+		Node& a = m_nodes[iA];
+		if (isLeaf(iA)
+		||  a.m_height < 2)
+		{
+			return iA;
+		}
+
+		const U32 iB = a.m_child[0];
+		const U32 iC = a.m_child[1];
+		Node& b = m_nodes[iB];
+		Node& c = m_nodes[iC];
+
+		const I32 diff = c.m_height - b.m_height;
+		if (diff > 1)
+		{
+			// Rotate C up, A becomes child of C.
+			const U32 iF = c.m_child[0];
+			const U32 iG = c.m_child[1];
+			Node& f = m_nodes[iF];
+			Node& g = m_nodes[iG];
+
+			c.m_child[0] = iA;
+			c.m_parent = a.m_parent;
+			a.m_parent = iC;
+
+			if (UINT32_MAX != c.m_parent)
+			{
+				Node& cp = m_nodes[c.m_parent];
+				cp.m_child[cp.m_child[0] == iA ? 0 : 1] = iC;
+			}
+			else
+			{
+				m_root = iC;
+			}
+
+			// Taller grandchild stays with C.
+			const bool keepF = f.m_height > g.m_height;
+			const U32 iKeep = keepF ? iF : iG;
+			const U32 iMove = keepF ? iG : iF;
+
+			c.m_child[1] = iKeep;
+			a.m_child[1] = iMove;
+			m_nodes[iMove].m_parent = iA;
+
+			a.m_aabb = boundsMerge(b.m_aabb, m_nodes[iMove].m_aabb);
+			c.m_aabb = boundsMerge(a.m_aabb, m_nodes[iKeep].m_aabb);
+			a.m_height = 1 + base::max(b.m_height, m_nodes[iMove].m_height);
+			c.m_height = 1 + base::max(a.m_height, m_nodes[iKeep].m_height);
+
+			return iC;
+		}
+
+		if (diff < -1)
+		{
+			// Rotate B up, A becomes child of B.
+			const U32 iD = b.m_child[0];
+			const U32 iE = b.m_child[1];
+			Node& d = m_nodes[iD];
+			Node& e = m_nodes[iE];
+
+			b.m_child[0] = iA;
+			b.m_parent = a.m_parent;
+			a.m_parent = iB;
+
+			if (UINT32_MAX != b.m_parent)
+			{
+				Node& bp = m_nodes[b.m_parent];
+				bp.m_child[bp.m_child[0] == iA ? 0 : 1] = iB;
+			}
+			else
+			{
+				m_root = iB;
+			}
+
+			const bool keepD = d.m_height > e.m_height;
+			const U32 iKeep = keepD ? iD : iE;
+			const U32 iMove = keepD ? iE : iD;
+
+			b.m_child[1] = iKeep;
+			a.m_child[0] = iMove;
+			m_nodes[iMove].m_parent = iA;
+
+			a.m_aabb = boundsMerge(c.m_aabb, m_nodes[iMove].m_aabb);
+			b.m_aabb = boundsMerge(a.m_aabb, m_nodes[iKeep].m_aabb);
+			a.m_height = 1 + base::max(c.m_height, m_nodes[iMove].m_height);
+			b.m_height = 1 + base::max(a.m_height, m_nodes[iKeep].m_height);
+
+			return iB;
+		}
+
+		return iA;
+	}
+
+} // namespace mara
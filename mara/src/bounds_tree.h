@@ -0,0 +1,170 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#ifndef MARA_BOUNDS_TREE_H_HEADER_GUARD
+#define MARA_BOUNDS_TREE_H_HEADER_GUARD
+
+#include <mara/mara.h>
+
+namespace mara
+{
+	/// Dynamic AABB tree over entity bounds. Leaves store bounds enlarged by
+	/// `MARA_CONFIG_BOUNDS_TREE_MARGIN`, so moving entity is only reinserted
+	/// when it leaves its enlarged bounds. Tree is kept balanced with rotations
+	/// on insert and remove.
+	///
+	struct BoundsTree
+	{
+		struct Node
+		{
+			base::Aabb m_aabb;
+			EntityHandle m_entity;
+			U32 m_parent;   //!< Parent node, or next free node when node is unused.
+			U32 m_child[2]; //!< Children, UINT32_MAX for leaves.
+			I32 m_height;   //!< Leaves have height 0.
+		};
+
+		BoundsTree();
+
+		void init(base::AllocatorI* _allocator);
+		void shutdown();
+
+		void set(EntityHandle _entity, const base::Aabb& _aabb);
+		void remove(EntityHandle _entity);
+		bool has(EntityHandle _entity) const
+		{
+			return UINT32_MAX != find(_entity);
+		}
+
+		/// Leaf node of entity, UINT32_MAX if entity has no bounds.
+		U32 find(EntityHandle _entity) const
+		{
+			return _entity.idx < m_leafSize ? m_leaf[_entity.idx] : UINT32_MAX;
+		}
+
+		const base::Aabb* get(EntityHandle _entity) const
+		{
+			return has(_entity) ? &m_bounds[_entity.idx] : NULL;
+		}
+
+		/// Collect entities whose bounds pass `_test`. If `_out` is NULL only count is returned.
+		template<typename TestT>
+		U32 query(const TestT& _test, EntityHandle* _out, U32 _max) const;
+
+		U32 allocNode();
+		void freeNode(U32 _node);
+		void insertLeaf(U32 _leaf);
+		void removeLeaf(U32 _leaf);
+		U32 balance(U32 _node);
+
+		bool isLeaf(U32 _node) const
+		{
+			return UINT32_MAX == m_nodes[_node].m_child[0];
+		}
+
+		base::AllocatorI* m_allocator;
+
+		Node* m_nodes;
+		U32 m_numNodes;
+		U32 m_capacity;
+		U32 m_free;
+		U32 m_root;
+
+		U32* m_leaf;          //!< Entity to leaf node, UINT32_MAX if entity has no bounds.
+		base::Aabb* m_bounds; //!< Exact entity bounds, indexed by entity.
+		U32 m_leafSize;       //!< Size of `m_leaf` and `m_bounds`, grows with highest entity with bounds.
+	};
+
+	inline bool boundsOverlap(const base::Aabb& _a, const base::Aabb& _b)
+	{
+		return _a.max.x >= _b.min.x && _a.min.x <= _b.max.x
+			&& _a.max.y >= _b.min.y && _a.min.y <= _b.max.y
+			&& _a.max.z >= _b.min.z && _a.min.z <= _b.max.z
+			;
+	}
+
+	inline bool boundsOverlap(const base::Aabb& _aabb, const base::Sphere& _sphere)
+	{
+		const F32 dx = base::clamp(_sphere.center.x, _aabb.min.x, _aabb.max.x) - _sphere.center.x;
+		const F32 dy = base::clamp(_sphere.center.y, _aabb.min.y, _aabb.max.y) - _sphere.center.y;
+		const F32 dz = base::clamp(_sphere.center.z, _aabb.min.z, _aabb.max.z) - _sphere.center.z;
+		return dx*dx + dy*dy + dz*dz <= _sphere.radius*_sphere.radius;
+	}
+
+	/// Conservative test, box is rejected only if it's fully behind one of planes.
+	inline bool boundsOverlap(const base::Aabb& _aabb, const base::Plane* _planes, U32 _num)
+	{
+		for (U32 ii = 0; ii < _num; ++ii)
+		{
+			const base::Plane& plane = _planes[ii];
+
+			// Corner furthest along plane normal.
+			const F32 x = plane.normal.x >= 0.0f ? _aabb.max.x : _aabb.min.x;
+			const F32 y = plane.normal.y >= 0.0f ? _aabb.max.y : _aabb.min.y;
+			const F32 z = plane.normal.z >= 0.0f ? _aabb.max.z : _aabb.min.z;
+
+			if (plane.normal.x*x + plane.normal.y*y + plane.normal.z*z + plane.dist < 0.0f)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	template<typename TestT>
+	inline U32 BoundsTree::query(const TestT& _test, EntityHandle* _out, U32 _max) const
+	{
+		if (UINT32_MAX == m_root)
+		{
+			return 0;
+		}
+
+		// Balanced tree height stays logarithmic, stack only holds siblings along one path.
+		U32 stack[128];
+		U32 depth = 0;
+		stack[depth++] = m_root;
+
+		U32 num = 0;
+		while (0 != depth)
+		{
+			const U32 idx = stack[--depth];
+			const Node& node = m_nodes[idx];
+			if (!_test(node.m_aabb) )
+			{
+				continue;
+			}
+
+			if (isLeaf(idx) )
+			{
+				if (_test(m_bounds[node.m_entity.idx]) )
+				{
+					if (NULL != _out)
+					{
+						if (num == _max)
+						{
+							break;
+						}
+
+						_out[num] = node.m_entity;
+					}
+
+					++num;
+				}
+			}
+			else
+			{
+				BASE_ASSERT(depth + 2 <= BASE_COUNTOF(stack), "Bounds tree too deep.");
+				stack[depth++] = node.m_child[0];
+				stack[depth++] = node.m_child[1];
+			}
+		}
+
+		return num;
+	}
+
+} // namespace mara
+
+#endif // MARA_BOUNDS_TREE_H_HEADER_GUARD
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#include "mara_p.h"
+
+namespace mara
+{
+	BASE_STATIC_ASSERT(MARA_CONFIG_MAX_ENTITIES <= kPlaceholderEntityBit, "Entity handles would collide with placeholder handles.");
+	BASE_STATIC_ASSERT(0 == sizeof(EntityCommandBuffer::Header) % 16);
+
+	EntityCommandBuffer::EntityCommandBuffer()
+		: m_allocator(NULL)
+		, m_data(NULL)
+		, m_size(0)
+		, m_capacity(0)
+		, m_numCommands(0)
+		, m_numCreated(0)
+		, m_idx(0)
+		, m_sortKey(0)
+	{
+	}
+
+	void EntityCommandBuffer::init(base::AllocatorI* _allocator, U16 _idx)
+	{
+		m_allocator = _allocator;
+		m_idx = _idx;
+		reset();
+	}
+
+	void EntityCommandBuffer::shutdown()
+	{
+		base::free(m_allocator, m_data, 16);
+		m_data = NULL;
+		m_capacity = 0;
+		reset();
+	}
+
+	void EntityCommandBuffer::reset()
+	{
+		m_size = 0;
+		m_numCommands = 0;
+		m_numCreated = 0;
+		m_sortKey = 0;
+	}
+
+	void* EntityCommandBuffer::record(Command::Enum _command, EntityHandle _entity, ComponentType _type, U32 _size)
+	{
+		const U32 size = sizeof(Header) + ( (_size + 15) & ~15u);
+		if (m_size + size > m_capacity)
+		{
+			// Aligned memory can't be reallocated in place, copy recorded commands over.
+			const U32 capacity = base::max<U32>(base::max<U32>(m_capacity * 2, 4 << 10), m_size + size);
+			U8* data = (U8*)base::alloc(m_allocator, capacity, 16);
+			if (NULL != m_data)
+			{
+				base::memCopy(data, m_data, m_size);
+				base::free(m_allocator, m_data, 16);
+			}
+
+			m_data = data;
+			m_capacity = capacity;
+		}
+
+		Header* header = (Header*)&m_data[m_size];
+		header->m_sortKey = m_sortKey;
+		header->m_command = U16(_command);
+		header->m_type = _type.idx;
+		header->m_entity = _entity;
+		header->m_buffer = m_idx;
+		header->m_size = _size;
+
+		m_size += size;
+		++m_numCommands;
+
+		return &header[1];
+	}
+
+	EntityHandle EntityCommandBuffer::createEntity()
+	{
+		BASE_ASSERT(m_numCreated < kPlaceholderEntityBit - 1, "Too many entities created by command buffer in one frame.");
+
+		EntityHandle handle = { U16(kPlaceholderEntityBit | m_numCreated++) };
+		record(Command::CreateEntity, handle, { 0 }, 0);
+
+		return handle;
+	}
+
+} // namespace mara
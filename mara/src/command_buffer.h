@@ -0,0 +1,67 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#ifndef MARA_COMMAND_BUFFER_H_HEADER_GUARD
+#define MARA_COMMAND_BUFFER_H_HEADER_GUARD
+
+#include <mara/mara.h>
+
+namespace mara
+{
+	/// Placeholder entity handles returned by `EntityCommandBuffer::createEntity`
+	/// have this bit set, remaining bits index entities created by same buffer.
+	static const U16 kPlaceholderEntityBit = 0x8000;
+
+	/// Records structural changes without touching context, owned by a single
+	/// worker thread. Recorded commands are played back by `mara::update`.
+	///
+	struct EntityCommandBuffer
+	{
+		struct Command
+		{
+			enum Enum
+			{
+				CreateEntity,
+				DestroyEntity,
+				AddComponent,
+				RemoveComponent,
+
+				Count
+			};
+		};
+
+		struct Header
+		{
+			U32 m_sortKey;
+			U16 m_command;
+			U16 m_type;
+			EntityHandle m_entity;
+			U16 m_buffer;
+			U32 m_size; //!< Size of data following header.
+		};
+
+		EntityCommandBuffer();
+
+		void init(base::AllocatorI* _allocator, U16 _idx);
+		void shutdown();
+		void reset();
+
+		void* record(Command::Enum _command, EntityHandle _entity, ComponentType _type, U32 _size);
+
+		EntityHandle createEntity();
+
+		base::AllocatorI* m_allocator;
+		U8* m_data;
+		U32 m_size;
+		U32 m_capacity;
+		U32 m_numCommands;
+		U16 m_numCreated;
+		U16 m_idx;
+		U32 m_sortKey;
+	};
+
+} // namespace mara
+
+#endif // MARA_COMMAND_BUFFER_H_HEADER_GUARD
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#include "mara_p.h"
+
+namespace mara
+{
+	ComponentPoolBase::ComponentPoolBase()
+		: m_allocator(NULL)
+		, m_destroyFn(NULL)
+		, m_size(0)
+		, m_align(0)
+		, m_dense(NULL)
+		, m_entities(NULL)
+		, m_ticks(NULL)
+		, m_num(0)
+		, m_capacity(0)
+		, m_sparse(NULL)
+		, m_sparseSize(0)
+	{
+	}
+
+	ComponentPoolBase::ComponentPoolBase(U32 _size, U32 _align, ComponentDestroyFn _destroyFn, base::AllocatorI* _allocator)
+		: ComponentPoolBase()
+	{
+		init(_size, _align, _destroyFn, _allocator);
+	}
+
+	ComponentPoolBase::~ComponentPoolBase()
+	{
+		shutdown();
+	}
+
+	void ComponentPoolBase::init(U32 _size, U32 _align, ComponentDestroyFn _destroyFn, base::AllocatorI* _allocator)
+	{
+		BASE_ASSERT(0 == m_size, "Component pool is already initialized.");
+		BASE_ASSERT(0 != _size, "Component size cannot be zero.");
+
+		m_allocator = NULL != _allocator ? _allocator : entry::getAllocator();
+		m_destroyFn = _destroyFn;
+		m_size = _size;
+		m_align = base::max<U32>(_align, 16);
+	}
+
+	void ComponentPoolBase::shutdown()
+	{
+		if (0 == m_size)
+		{
+			return;
+		}
+
+		clear();
+
+		base::free(m_allocator, m_dense, m_align);
+		base::free(m_allocator, m_entities);
+		base::free(m_allocator, m_ticks);
+		base::free(m_allocator, m_sparse);
+
+		m_dense = NULL;
+		m_entities = NULL;
+		m_ticks = NULL;
+		m_sparse = NULL;
+		m_capacity = 0;
+		m_sparseSize = 0;
+		m_size = 0;
+	}
+
+	void* ComponentPoolBase::insert(EntityHandle _entity)
+	{
+		BASE_ASSERT(!has(_entity), "Entities cannot have duplicated components!");
+
+		if (_entity.idx >= m_sparseSize)
+		{
+			const U32 sparseSize = base::max<U32>(base::max<U32>(m_sparseSize * 2, 64), _entity.idx + 1);
+			m_sparse = (U16*)base::realloc(m_allocator, m_sparse, sparseSize * sizeof(U16) );
+			base::memSet(&m_sparse[m_sparseSize], 0xff, (sparseSize - m_sparseSize) * sizeof(U16) );
+			m_sparseSize = sparseSize;
+		}
+
+		if (m_num == m_capacity)
+		{
+			const U32 capacity = base::max<U32>(m_capacity * 2, 16);
+
+			// Aligned memory can't be reallocated in place, copy packed data over.
+			U8* dense = (U8*)base::alloc(m_allocator, capacity * m_size, m_align);
+			if (NULL != m_dense)
+			{
+				base::memCopy(dense, m_dense, m_num * m_size);
+				base::free(m_allocator, m_dense, m_align);
+			}
+
+			m_dense = dense;
+			m_entities = (EntityHandle*)base::realloc(m_allocator, m_entities, capacity * sizeof(EntityHandle) );
+			m_ticks = (U32*)base::realloc(m_allocator, m_ticks, capacity * sizeof(U32) );
+			m_capacity = capacity;
+		}
+
+		const U32 idx = m_num++;
+		m_sparse[_entity.idx] = U16(idx);
+		m_entities[idx] = _entity;
+		m_ticks[idx] = 0;
+
+		return m_dense + idx * m_size;
+	}
+
+	void ComponentPoolBase::remove(EntityHandle _entity)
+	{
+		if (!has(_entity) )
+		{
+			return;
+		}
+
+		const U32 idx = m_sparse[_entity.idx];
+		U8* data = m_dense + idx * m_size;
+
+		if (NULL != m_destroyFn)
+		{
+			m_destroyFn(data);
+		}
+
+		// Swap remove, last component is moved into the hole to keep data tightly packed.
+		const U32 last = --m_num;
+		if (idx != last)
+		{
+			const EntityHandle moved = m_entities[last];
+			base::memCopy(data, m_dense + last * m_size, m_size);
+			m_entities[idx] = moved;
+			m_ticks[idx] = m_ticks[last];
+			m_sparse[moved.idx] = U16(idx);
+		}
+
+		m_sparse[_entity.idx] = UINT16_MAX;
+	}
+
+	void ComponentPoolBase::clear()
+	{
+		for (U32 ii = 0; ii < m_num; ++ii)
+		{
+			if (NULL != m_destroyFn)
+			{
+				m_destroyFn(m_dense + ii * m_size);
+			}
+
+			m_sparse[m_entities[ii].idx] = UINT16_MAX;
+		}
+
+		m_num = 0;
+	}
+
+} // namespace mara
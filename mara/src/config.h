@@ -14,8 +14,9 @@
 #define MARA_CONFIG_MAX_PAKS 10
 #endif
 
-#ifndef MARA_CONFIG_MAX_PAK_ENTRIES
-#define MARA_CONFIG_MAX_PAK_ENTRIES 10000
+/// Uncompressed size of compressed pak entry block, unit of parallel decompression.
+#ifndef MARA_CONFIG_PAK_BLOCK_SIZE
+#define MARA_CONFIG_PAK_BLOCK_SIZE (256<<10)
 #endif
 
 #ifndef MARA_CONFIG_MAX_RESOURCES
@@ -26,8 +27,9 @@
 #define MARA_CONFIG_MAX_COMPONENTS 10000
 #endif
 
+/// Entity handles with top bit set are reserved for command buffer placeholders.
 #ifndef MARA_CONFIG_MAX_ENTITIES
-#define MARA_CONFIG_MAX_ENTITIES 10000
+#define MARA_CONFIG_MAX_ENTITIES (32<<10)
 #endif
 
 #ifndef MARA_CONFIG_MAX_COMPONENTS_PER_TYPE
@@ -38,9 +40,65 @@
 #define MARA_CONFIG_MAX_COMPONENTS_PER_ENTITY 10000
 #endif
 
-#ifndef MARA_CONFIG_MAX_ENTITIES_TO_QUERY
-#define MARA_CONFIG_MAX_ENTITIES_TO_QUERY 10000
-#endif 
+/// Number of elements per page of handle tables, tables are committed one page
+/// at a time so `MARA_CONFIG_MAX_*` limits only bound handle range. Must be power of two.
+#ifndef MARA_CONFIG_HANDLE_PAGE_SIZE
+#define MARA_CONFIG_HANDLE_PAGE_SIZE 64
+#endif
+
+#ifndef MARA_CONFIG_FRAME_MEMORY_SIZE
+#define MARA_CONFIG_FRAME_MEMORY_SIZE (1<<20)
+#endif
+
+#ifndef MARA_CONFIG_MAX_QUERIES
+#define MARA_CONFIG_MAX_QUERIES 64
+#endif
+
+#ifndef MARA_CONFIG_MAX_SYSTEMS
+#define MARA_CONFIG_MAX_SYSTEMS 64
+#endif
+
+#ifndef MARA_CONFIG_MAX_OBSERVERS
+#define MARA_CONFIG_MAX_OBSERVERS 64
+#endif
+
+#ifndef MARA_CONFIG_MAX_WORKERS
+#define MARA_CONFIG_MAX_WORKERS 32
+#endif
+
+#ifndef MARA_CONFIG_MAX_TRANSFORM_DEPTH
+#define MARA_CONFIG_MAX_TRANSFORM_DEPTH 64
+#endif
+
+/// Distance bounds are enlarged by when stored in spatial index, so small
+/// movements don't require reinsertion.
+#ifndef MARA_CONFIG_BOUNDS_TREE_MARGIN
+#define MARA_CONFIG_BOUNDS_TREE_MARGIN 0.1f
+#endif
+
+/// Threads reading and deserializing resources loaded with `mara::load*Async`.
+/// Pak reads don't serialize, more threads keep more reads in flight.
+#ifndef MARA_CONFIG_NUM_LOADER_THREADS
+#define MARA_CONFIG_NUM_LOADER_THREADS 4
+#endif
+
+/// Must be power of two.
+#ifndef MARA_CONFIG_MAX_JOBS_PER_WORKER
+#define MARA_CONFIG_MAX_JOBS_PER_WORKER 4096
+#endif
+
+/// Must be multiple of 128.
+#ifndef MARA_CONFIG_MAX_COMPONENT_TYPES
+#define MARA_CONFIG_MAX_COMPONENT_TYPES 256
+#endif
+
+#ifndef MARA_CONFIG_MAX_ARCHETYPES
+#define MARA_CONFIG_MAX_ARCHETYPES 256
+#endif
+
+#ifndef MARA_CONFIG_ARCHETYPE_CHUNK_SIZE
+#define MARA_CONFIG_ARCHETYPE_CHUNK_SIZE (16<<10)
+#endif
 
 #ifndef MARA_CONFIG_MAX_GEOMETRIES
 #define MARA_CONFIG_MAX_GEOMETRIES 10000
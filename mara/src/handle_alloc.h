@@ -0,0 +1,313 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#ifndef MARA_HANDLE_ALLOC_H_HEADER_GUARD
+#define MARA_HANDLE_ALLOC_H_HEADER_GUARD
+
+#include <mara/mara.h>
+
+namespace mara
+{
+	/// Handle allocator with same interface and allocation order as
+	/// `base::HandleAllocT`, but constructed without touching its arrays.
+	/// Entries past highest handle ever allocated are initialized on first
+	/// alloc, so untouched memory stays uncommitted.
+	///
+	template<U16 MaxT>
+	struct LazyHandleAllocT
+	{
+		LazyHandleAllocT()
+			: m_numHandles(0)
+			, m_highWater(0)
+		{
+		}
+
+		U16 alloc()
+		{
+			if (m_numHandles < MaxT)
+			{
+				const U16 index = m_numHandles++;
+				if (index == m_highWater)
+				{
+					m_dense[index] = index;
+					++m_highWater;
+				}
+
+				const U16 handle = m_dense[index];
+				m_sparse[handle] = index;
+				return handle;
+			}
+
+			return kInvalidHandle;
+		}
+
+		void free(U16 _handle)
+		{
+			BASE_ASSERT(isValid(_handle), "Handle %d is not valid.", _handle);
+
+			const U16 index = m_sparse[_handle];
+			--m_numHandles;
+			const U16 temp = m_dense[m_numHandles];
+			m_dense[m_numHandles] = _handle;
+			m_sparse[temp] = index;
+			m_dense[index] = temp;
+		}
+
+		bool isValid(U16 _handle) const
+		{
+			if (_handle >= m_highWater)
+			{
+				return false;
+			}
+
+			const U16 index = m_sparse[_handle];
+			return index < m_numHandles
+				&& m_dense[index] == _handle
+				;
+		}
+
+		void reset()
+		{
+			m_numHandles = 0;
+			m_highWater = 0;
+		}
+
+		const U16* getHandles() const
+		{
+			return m_dense;
+		}
+
+		U16 getHandleAt(U16 _at) const
+		{
+			return m_dense[_at];
+		}
+
+		U16 getNumHandles() const
+		{
+			return m_numHandles;
+		}
+
+		U16 getMaxHandles() const
+		{
+			return MaxT;
+		}
+
+		U16 m_numHandles;
+		U16 m_highWater; //!< Highest handle ever allocated plus one.
+		U16 m_dense[MaxT];
+		U16 m_sparse[MaxT];
+	};
+
+	/// Key to handle map with same interface as `base::HandleHashMapT`. Table
+	/// is allocated on first insert and doubled when it gets 3/4 full, so empty
+	/// map costs nothing to construct. `MaxT` only limits number of elements.
+	///
+	template<U32 MaxT, typename KeyT = U32>
+	struct LazyHandleHashMapT
+	{
+		LazyHandleHashMapT()
+			: m_allocator(NULL)
+			, m_keys(NULL)
+			, m_handles(NULL)
+			, m_capacity(0)
+			, m_numElements(0)
+		{
+		}
+
+		void init(base::AllocatorI* _allocator)
+		{
+			m_allocator = _allocator;
+		}
+
+		void shutdown()
+		{
+			base::free(m_allocator, m_keys);
+			base::free(m_allocator, m_handles);
+
+			m_keys = NULL;
+			m_handles = NULL;
+			m_capacity = 0;
+			m_numElements = 0;
+		}
+
+		bool insert(KeyT _key, U16 _handle)
+		{
+			if (kInvalidHandle == _handle
+			||  m_numElements == MaxT
+			||  kInvalidHandle != find(_key) )
+			{
+				return false;
+			}
+
+			if ( (m_numElements + 1) * 4 > m_capacity * 3)
+			{
+				grow(base::max<U32>(m_capacity * 2, 64) );
+			}
+
+			insertUnique(_key, _handle);
+			++m_numElements;
+			return true;
+		}
+
+		bool removeByKey(KeyT _key)
+		{
+			const U32 idx = findIndex(_key);
+			if (UINT32_MAX != idx)
+			{
+				removeIndex(idx);
+				return true;
+			}
+
+			return false;
+		}
+
+		bool removeByHandle(U16 _handle)
+		{
+			if (kInvalidHandle != _handle)
+			{
+				for (U32 idx = 0; idx < m_capacity; ++idx)
+				{
+					if (_handle == m_handles[idx])
+					{
+						removeIndex(idx);
+						return true;
+					}
+				}
+			}
+
+			return false;
+		}
+
+		U16 find(KeyT _key) const
+		{
+			const U32 idx = findIndex(_key);
+			return UINT32_MAX != idx ? m_handles[idx] : kInvalidHandle;
+		}
+
+		KeyT findByHandle(U16 _handle) const
+		{
+			for (U32 idx = 0; idx < m_capacity; ++idx)
+			{
+				if (_handle == m_handles[idx])
+				{
+					return m_keys[idx];
+				}
+			}
+
+			return KeyT(0);
+		}
+
+		void reset()
+		{
+			if (0 != m_capacity)
+			{
+				base::memSet(m_handles, 0xff, m_capacity * sizeof(U16) );
+			}
+
+			m_numElements = 0;
+		}
+
+		U32 getNumElements() const
+		{
+			return m_numElements;
+		}
+
+		U32 getMaxCapacity() const
+		{
+			return MaxT;
+		}
+
+		U32 mix(KeyT _key) const
+		{
+			const U64 key = U64(_key);
+			return U32( (key ^ (key >> 32) ) * UINT64_C(0x9e3779b97f4a7c15) >> 32) & (m_capacity - 1);
+		}
+
+		U32 findIndex(KeyT _key) const
+		{
+			if (0 == m_capacity)
+			{
+				return UINT32_MAX;
+			}
+
+			for (U32 idx = mix(_key); kInvalidHandle != m_handles[idx]; idx = (idx + 1) & (m_capacity - 1) )
+			{
+				if (_key == m_keys[idx])
+				{
+					return idx;
+				}
+			}
+
+			return UINT32_MAX;
+		}
+
+		void insertUnique(KeyT _key, U16 _handle)
+		{
+			U32 idx = mix(_key);
+			while (kInvalidHandle != m_handles[idx])
+			{
+				idx = (idx + 1) & (m_capacity - 1);
+			}
+
+			m_keys[idx] = _key;
+			m_handles[idx] = _handle;
+		}
+
+		/// Backward shift deletion, keeps probe sequences intact without tombstones.
+		void removeIndex(U32 _idx)
+		{
+			m_handles[_idx] = kInvalidHandle;
+			--m_numElements;
+
+			for (U32 idx = (_idx + 1) & (m_capacity - 1); kInvalidHandle != m_handles[idx]; idx = (idx + 1) & (m_capacity - 1) )
+			{
+				const U32 home = mix(m_keys[idx]);
+				const bool between = _idx <= idx
+					? (_idx < home && home <= idx)
+					: (_idx < home || home <= idx)
+					;
+				if (!between)
+				{
+					m_keys[_idx] = m_keys[idx];
+					m_handles[_idx] = m_handles[idx];
+					m_handles[idx] = kInvalidHandle;
+					_idx = idx;
+				}
+			}
+		}
+
+		void grow(U32 _capacity)
+		{
+			KeyT* keys = m_keys;
+			U16* handles = m_handles;
+			const U32 capacity = m_capacity;
+
+			m_keys = (KeyT*)base::alloc(m_allocator, _capacity * sizeof(KeyT) );
+			m_handles = (U16*)base::alloc(m_allocator, _capacity * sizeof(U16) );
+			m_capacity = _capacity;
+			base::memSet(m_handles, 0xff, _capacity * sizeof(U16) );
+
+			for (U32 idx = 0; idx < capacity; ++idx)
+			{
+				if (kInvalidHandle != handles[idx])
+				{
+					insertUnique(keys[idx], handles[idx]);
+				}
+			}
+
+			base::free(m_allocator, keys);
+			base::free(m_allocator, handles);
+		}
+
+		base::AllocatorI* m_allocator;
+		KeyT* m_keys;
+		U16* m_handles;  //!< kInvalidHandle marks empty slot.
+		U32 m_capacity;  //!< Power of two.
+		U32 m_numElements;
+	};
+
+} // namespace mara
+
+#endif // MARA_HANDLE_ALLOC_H_HEADER_GUARD
@@ -0,0 +1,404 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#include "mara_p.h"
+
+#if BASE_PLATFORM_WINDOWS
+#	include <windows.h>
+#else
+#	include <unistd.h>
+#endif // BASE_PLATFORM_WINDOWS
+
+namespace mara
+{
+	static thread_local U32 s_workerIdx = UINT32_MAX;
+
+	U32 getNumHardwareThreads()
+	{
+#if BASE_PLATFORM_WINDOWS
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return U32(info.dwNumberOfProcessors);
+#else
+		const long num = sysconf(_SC_NPROCESSORS_ONLN);
+		return num > 0 ? U32(num) : 1;
+#endif // BASE_PLATFORM_WINDOWS
+	}
+
+	JobDeque::JobDeque()
+		: m_top(0)
+		, m_bottom(0)
+	{
+	}
+
+	void JobDeque::push(Job* _job)
+	{
+		const I32 bottom = m_bottom;
+		BASE_ASSERT(bottom - m_top < MARA_CONFIG_MAX_JOBS_PER_WORKER, "Job deque overflow.");
+
+		m_jobs[bottom & (MARA_CONFIG_MAX_JOBS_PER_WORKER - 1)] = _job;
+
+		// Job must be visible before thieves can see new bottom.
+		base::writeBarrier();
+		m_bottom = bottom + 1;
+	}
+
+	Job* JobDeque::pop()
+	{
+		const I32 bottom = m_bottom - 1;
+		m_bottom = bottom;
+
+		// Store to bottom must happen before load of top.
+		base::memoryBarrier();
+		const I32 top = m_top;
+
+		if (top <= bottom)
+		{
+			Job* job = m_jobs[bottom & (MARA_CONFIG_MAX_JOBS_PER_WORKER - 1)];
+			if (top != bottom)
+			{
+				return job;
+			}
+
+			// Last job in deque, race against thieves.
+			if (top != base::atomicCompareAndSwap<I32>(&m_top, top, top + 1) )
+			{
+				job = NULL;
+			}
+
+			m_bottom = top + 1;
+			return job;
+		}
+
+		m_bottom = top;
+		return NULL;
+	}
+
+	Job* JobDeque::steal()
+	{
+		const I32 top = m_top;
+
+		// Load of top must happen before load of bottom.
+		base::memoryBarrier();
+		const I32 bottom = m_bottom;
+
+		if (top < bottom)
+		{
+			Job* job = m_jobs[top & (MARA_CONFIG_MAX_JOBS_PER_WORKER - 1)];
+			if (top != base::atomicCompareAndSwap<I32>(&m_top, top, top + 1) )
+			{
+				return NULL;
+			}
+
+			return job;
+		}
+
+		return NULL;
+	}
+
+	U32 JobSystem::getWorkerIndex()
+	{
+		return s_workerIdx;
+	}
+
+	JobSystem::JobSystem()
+		: m_allocator(NULL)
+		, m_workers(NULL)
+		, m_numWorkers(0)
+		, m_numQueues(0)
+		, m_numAttached(0)
+		, m_numSleeping(0)
+		, m_exit(false)
+	{
+	}
+
+	void JobSystem::init(base::AllocatorI* _allocator, U32 _numWorkers, U32 _numExternal)
+	{
+		BASE_STATIC_ASSERT(0 == (MARA_CONFIG_MAX_JOBS_PER_WORKER & (MARA_CONFIG_MAX_JOBS_PER_WORKER - 1) ) );
+
+		m_allocator = _allocator;
+		m_numWorkers = base::clamp<U32>(_numWorkers, 1, MARA_CONFIG_MAX_WORKERS);
+		m_numQueues = m_numWorkers + _numExternal;
+		m_numAttached = 0;
+		m_numSleeping = 0;
+		m_exit = false;
+
+		// External threads get queues after workers, so worker indices stay dense.
+		m_workers = (JobWorker*)base::alloc(m_allocator, m_numQueues * sizeof(JobWorker), BASE_CACHE_LINE_SIZE);
+		for (U32 ii = 0; ii < m_numQueues; ++ii)
+		{
+			JobWorker* worker = BASE_PLACEMENT_NEW(&m_workers[ii], JobWorker);
+			worker->m_numAllocated = 0;
+			worker->m_random = ii * 0x9e3779b9u + 1;
+			worker->m_jobSystem = this;
+			worker->m_idx = ii;
+
+			for (U32 jj = 0; jj < MARA_CONFIG_MAX_JOBS_PER_WORKER; ++jj)
+			{
+				worker->m_jobs[jj].m_busy = 0;
+			}
+		}
+
+		// Calling thread is worker 0.
+		s_workerIdx = 0;
+
+		for (U32 ii = 1; ii < m_numWorkers; ++ii)
+		{
+			m_workers[ii].m_thread.init(workerThreadFunc, &m_workers[ii], 0, "mara worker");
+		}
+	}
+
+	void JobSystem::shutdown()
+	{
+		if (NULL == m_workers)
+		{
+			return;
+		}
+
+		m_exit = true;
+		m_sem.post(m_numWorkers);
+
+		for (U32 ii = 1; ii < m_numWorkers; ++ii)
+		{
+			m_workers[ii].m_thread.shutdown();
+		}
+
+		for (U32 ii = 0; ii < m_numQueues; ++ii)
+		{
+			m_workers[ii].~JobWorker();
+		}
+
+		base::free(m_allocator, m_workers, BASE_CACHE_LINE_SIZE);
+		m_workers = NULL;
+		m_numWorkers = 0;
+		m_numQueues = 0;
+	}
+
+	bool JobSystem::attach()
+	{
+		if (s_workerIdx < m_numQueues)
+		{
+			return true;
+		}
+
+		const U32 idx = m_numWorkers + U32(base::atomicFetchAndAdd<I32>(&m_numAttached, 1) );
+		if (idx >= m_numQueues)
+		{
+			return false;
+		}
+
+		s_workerIdx = idx;
+		return true;
+	}
+
+	Job* JobSystem::allocJob(JobWorker& _worker)
+	{
+		// Ring buffer wraps, jobs complete out of order so slot might still be in flight. Deque
+		// only holds busy jobs, so it can't overflow either.
+		Job* job = &_worker.m_jobs[_worker.m_numAllocated & (MARA_CONFIG_MAX_JOBS_PER_WORKER - 1)];
+		if (0 != job->m_busy)
+		{
+			return NULL;
+		}
+
+		++_worker.m_numAllocated;
+		job->m_busy = 1;
+		return job;
+	}
+
+	void JobSystem::submit(JobWorker& _worker, Job* _job)
+	{
+		if (NULL != _job->m_counter)
+		{
+			base::atomicAddAndFetch<I32>(&_job->m_counter->m_value, 1);
+		}
+
+		_worker.m_deque.push(_job);
+
+		// Pairs with sleeping worker checking queues again after announcing it sleeps.
+		base::memoryBarrier();
+		if (0 != m_numSleeping)
+		{
+			m_sem.post();
+		}
+	}
+
+	Job* JobSystem::getJob(U32 _workerIdx)
+	{
+		JobWorker& worker = m_workers[_workerIdx];
+
+		Job* job = worker.m_deque.pop();
+		if (NULL != job)
+		{
+			return job;
+		}
+
+		// Steal from other workers, starting at random victim.
+		U32 random = worker.m_random;
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		worker.m_random = random;
+
+		for (U32 ii = 0; ii < m_numQueues; ++ii)
+		{
+			const U32 victim = (random + ii) % m_numQueues;
+			if (victim == _workerIdx)
+			{
+				continue;
+			}
+
+			job = m_workers[victim].m_deque.steal();
+			if (NULL != job)
+			{
+				return job;
+			}
+		}
+
+		return NULL;
+	}
+
+	void JobSystem::execute(Job* _job)
+	{
+		if (NULL != _job->m_rangeFn)
+		{
+			_job->m_rangeFn(_job->m_begin, _job->m_end, _job->m_userData);
+		}
+		else
+		{
+			_job->m_fn(_job->m_userData);
+		}
+
+		if (NULL != _job->m_counter)
+		{
+			base::atomicSubAndFetch<I32>(&_job->m_counter->m_value, 1);
+		}
+
+		// Job is done with its slot, owner may reuse it.
+		base::memoryBarrier();
+		_job->m_busy = 0;
+	}
+
+	I32 JobSystem::workerThreadFunc(base::Thread* _thread, void* _userData)
+	{
+		BASE_UNUSED(_thread);
+
+		JobWorker* worker = (JobWorker*)_userData;
+		JobSystem* js = worker->m_jobSystem;
+		s_workerIdx = worker->m_idx;
+
+		while (!js->m_exit)
+		{
+			Job* job = js->getJob(s_workerIdx);
+			if (NULL != job)
+			{
+				js->execute(job);
+				continue;
+			}
+
+			// Announce sleeping, then check once more so no submitted job is missed.
+			base::atomicAddAndFetch<I32>(&js->m_numSleeping, 1);
+			job = js->getJob(s_workerIdx);
+			if (NULL != job)
+			{
+				base::atomicSubAndFetch<I32>(&js->m_numSleeping, 1);
+				js->execute(job);
+				continue;
+			}
+
+			js->m_sem.wait();
+			base::atomicSubAndFetch<I32>(&js->m_numSleeping, 1);
+		}
+
+		return 0;
+	}
+
+	void JobSystem::run(JobFn _fn, void* _userData, JobCounter* _counter)
+	{
+		BASE_ASSERT(s_workerIdx < m_numQueues, "Jobs can only be submitted from worker or attached threads.");
+
+		JobWorker& worker = m_workers[s_workerIdx];
+
+		Job* job = allocJob(worker);
+		if (NULL == job)
+		{
+			// Too many jobs in flight, run on calling thread.
+			_fn(_userData);
+			return;
+		}
+
+		job->m_fn = _fn;
+		job->m_rangeFn = NULL;
+		job->m_userData = _userData;
+		job->m_counter = _counter;
+
+		submit(worker, job);
+	}
+
+	void JobSystem::parallelFor(U32 _begin, U32 _end, U32 _grainSize, JobRangeFn _fn, void* _userData, JobCounter* _counter)
+	{
+		BASE_ASSERT(s_workerIdx < m_numQueues, "Jobs can only be submitted from worker or attached threads.");
+
+		if (_begin >= _end)
+		{
+			return;
+		}
+
+		const U32 num = _end - _begin;
+
+		// By default split range into a few batches per worker, so there is something left to steal.
+		U32 grainSize = 0 != _grainSize
+			? _grainSize
+			: base::max<U32>(num / (m_numWorkers * 4), 1)
+			;
+		grainSize = base::max<U32>(grainSize, num / (MARA_CONFIG_MAX_JOBS_PER_WORKER / 2) + 1);
+
+		JobWorker& worker = m_workers[s_workerIdx];
+		for (U32 begin = _begin; begin < _end; begin += grainSize)
+		{
+			Job* job = allocJob(worker);
+			if (NULL == job)
+			{
+				// Too many jobs in flight, run on calling thread.
+				_fn(begin, base::min<U32>(begin + grainSize, _end), _userData);
+				continue;
+			}
+
+			job->m_fn = NULL;
+			job->m_rangeFn = _fn;
+			job->m_userData = _userData;
+			job->m_counter = _counter;
+			job->m_begin = begin;
+			job->m_end = base::min<U32>(begin + grainSize, _end);
+
+			submit(worker, job);
+		}
+	}
+
+	void JobSystem::wait(JobCounter* _counter)
+	{
+		BASE_ASSERT(s_workerIdx < m_numQueues, "Only worker or attached threads can wait on jobs.");
+
+		// Help out instead of blocking, waiting job might be sitting in our own deque.
+		// Attached threads don't steal, they'd pick up jobs expecting worker index.
+		const bool external = s_workerIdx >= m_numWorkers;
+		while (0 != _counter->m_value)
+		{
+			Job* job = external
+				? m_workers[s_workerIdx].m_deque.pop()
+				: getJob(s_workerIdx)
+				;
+			if (NULL != job)
+			{
+				execute(job);
+			}
+			else
+			{
+				base::yield();
+			}
+		}
+	}
+
+} // namespace mara
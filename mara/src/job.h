@@ -0,0 +1,119 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#ifndef MARA_JOB_H_HEADER_GUARD
+#define MARA_JOB_H_HEADER_GUARD
+
+#include <mara/mara.h>
+
+#include <base/thread.h>
+#include <base/semaphore.h>
+#include <base/cpu.h>
+
+namespace mara
+{
+	/// Returns number of hardware threads available to process.
+	///
+	U32 getNumHardwareThreads();
+
+	struct Job
+	{
+		JobFn m_fn;
+		JobRangeFn m_rangeFn;
+		void* m_userData;
+		JobCounter* m_counter;
+		U32 m_begin;
+		U32 m_end;
+		volatile I32 m_busy; //!< Slot can't be reused until job is executed.
+	};
+
+	/// Fixed size Chase-Lev work-stealing deque. Owner thread pushes and pops at
+	/// the bottom, other threads steal from the top.
+	///
+	struct JobDeque
+	{
+		JobDeque();
+
+		void push(Job* _job);
+		Job* pop();
+		Job* steal();
+
+		volatile I32 m_top;
+		U8 m_padding0[BASE_CACHE_LINE_SIZE - sizeof(I32)];
+		volatile I32 m_bottom;
+		U8 m_padding1[BASE_CACHE_LINE_SIZE - sizeof(I32)];
+		Job* m_jobs[MARA_CONFIG_MAX_JOBS_PER_WORKER];
+	};
+
+	struct JobSystem;
+
+	struct JobWorker
+	{
+		JobDeque m_deque;
+		Job m_jobs[MARA_CONFIG_MAX_JOBS_PER_WORKER]; //!< Ring buffer jobs are allocated from by owner.
+		U32 m_numAllocated;
+		U32 m_random;
+		JobSystem* m_jobSystem;
+		U32 m_idx;
+		base::Thread m_thread;
+	};
+
+	/// Work-stealing job system. Thread calling `init` is worker 0, other
+	/// workers run on their own threads. Jobs can only be submitted from worker
+	/// threads, and from up to `_numExternal` threads that called `attach`.
+	///
+	struct JobSystem
+	{
+		JobSystem();
+
+		void init(base::AllocatorI* _allocator, U32 _numWorkers, U32 _numExternal = 0);
+		void shutdown();
+
+		/// Register calling thread, not owned by job system, so it can submit
+		/// and wait on jobs. Its jobs are executed by workers. While waiting it
+		/// only helps with its own jobs, so it never runs foreign jobs like
+		/// systems. Returns false if all external slots are taken.
+		bool attach();
+
+		void run(JobFn _fn, void* _userData, JobCounter* _counter);
+		void parallelFor(U32 _begin, U32 _end, U32 _grainSize, JobRangeFn _fn, void* _userData, JobCounter* _counter);
+		void wait(JobCounter* _counter);
+
+		U32 getNumWorkers() const
+		{
+			return m_numWorkers;
+		}
+
+		/// Returns index of calling worker thread, UINT32_MAX if not a worker.
+		static U32 getWorkerIndex();
+
+		/// Returns true if calling thread is worker or attached thread.
+		bool canSubmit() const
+		{
+			return getWorkerIndex() < m_numQueues;
+		}
+
+		static I32 workerThreadFunc(base::Thread* _thread, void* _userData);
+
+		/// Returns NULL if next ring buffer slot still holds job in flight.
+		Job* allocJob(JobWorker& _worker);
+		void submit(JobWorker& _worker, Job* _job);
+		Job* getJob(U32 _workerIdx);
+		void execute(Job* _job);
+
+		base::AllocatorI* m_allocator;
+		JobWorker* m_workers;
+		U32 m_numWorkers;
+		U32 m_numQueues;            //!< Workers plus external threads.
+		volatile I32 m_numAttached;
+
+		base::Semaphore m_sem;
+		volatile I32 m_numSleeping;
+		volatile bool m_exit;
+	};
+
+} // namespace mara
+
+#endif // MARA_JOB_H_HEADER_GUARD
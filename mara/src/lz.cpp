@@ -0,0 +1,239 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#include "mara_p.h"
+
+namespace mara
+{
+	static constexpr U32 kLzMinMatch  = 4;
+	static constexpr U32 kLzMaxOffset = UINT16_MAX;
+	static constexpr U32 kLzHashBits  = 12;
+
+	static inline U32 lzRead32(const U8* _ptr)
+	{
+		U32 value;
+		base::memCopy(&value, _ptr, sizeof(value) );
+		return value;
+	}
+
+	static inline U32 lzHash(U32 _value)
+	{
+		return (_value * 2654435761u) >> (32 - kLzHashBits);
+	}
+
+	static inline U8* lzWriteLength(U8* _dst, U32 _length)
+	{
+		for (; _length >= 255; _length -= 255)
+		{
+			*_dst++ = 255;
+		}
+
+		*_dst++ = U8(_length);
+		return _dst;
+	}
+
+	static inline bool lzReadLength(const U8*& _src, const U8* _srcEnd, U32& _length)
+	{
+		U8 byte;
+		do
+		{
+			if (_src >= _srcEnd)
+			{
+				return false;
+			}
+
+			byte = *_src++;
+			_length += byte;
+		}
+		while (255 == byte);
+
+		return true;
+	}
+
+	/// Append token with `_numLiterals` literals from `_literals`, followed by
+	/// match unless `_matchLength` is zero. Returns NULL if output is too small.
+	static U8* lzWriteSequence(U8* _dst, const U8* _dstEnd, const U8* _literals, U32 _numLiterals, U32 _offset, U32 _matchLength)
+	{
+		const U32 worstCase = 1 + _numLiterals/255 + 1 + _numLiterals + 2 + _matchLength/255 + 1;
+		if (worstCase > U32(_dstEnd - _dst) )
+		{
+			return NULL;
+		}
+
+		U8* token = _dst++;
+		*token = 0;
+
+		if (_numLiterals >= 15)
+		{
+			*token = 15 << 4;
+			_dst = lzWriteLength(_dst, _numLiterals - 15);
+		}
+		else
+		{
+			*token = U8(_numLiterals << 4);
+		}
+
+		base::memCopy(_dst, _literals, _numLiterals);
+		_dst += _numLiterals;
+
+		if (0 != _matchLength)
+		{
+			*_dst++ = U8(_offset);
+			*_dst++ = U8(_offset >> 8);
+
+			const U32 length = _matchLength - kLzMinMatch;
+			if (length >= 15)
+			{
+				*token |= 15;
+				_dst = lzWriteLength(_dst, length - 15);
+			}
+			else
+			{
+				*token |= U8(length);
+			}
+		}
+
+		return _dst;
+	}
+
+	U32 lzCompressBound(U32 _size)
+	{
+		return _size + _size/255 + 16;
+	}
+
+	U32 lzCompress(void* _dst, U32 _dstCapacity, const void* _src, U32 _srcSize)
+	{
+		const U8* src    = (const U8*)_src;
+		const U8* srcEnd = src + _srcSize;
+		U8* dst          = (U8*)_dst;
+		const U8* dstEnd = dst + _dstCapacity;
+
+		U32 table[1<<kLzHashBits];
+		base::memSet(table, 0, sizeof(table) );
+
+		const U8* anchor = src;
+		const U8* ip     = src;
+
+		while (ip + kLzMinMatch <= srcEnd)
+		{
+			const U32 value = lzRead32(ip);
+			const U32 hash  = lzHash(value);
+			const U8* ref   = src + table[hash];
+			table[hash]     = U32(ip - src);
+
+			if (ref >= ip
+			||  U32(ip - ref) > kLzMaxOffset
+			||  lzRead32(ref) != value)
+			{
+				// Skip faster through data that doesn't compress.
+				ip += 1 + (U32(ip - anchor) >> 6);
+				continue;
+			}
+
+			const U8* matchEnd = ip + kLzMinMatch;
+			for (const U8* rr = ref + kLzMinMatch; matchEnd < srcEnd && *rr == *matchEnd; ++rr, ++matchEnd)
+			{
+			}
+
+			dst = lzWriteSequence(dst, dstEnd, anchor, U32(ip - anchor), U32(ip - ref), U32(matchEnd - ip) );
+			if (NULL == dst)
+			{
+				return 0;
+			}
+
+			ip     = matchEnd;
+			anchor = matchEnd;
+		}
+
+		dst = lzWriteSequence(dst, dstEnd, anchor, U32(srcEnd - anchor), 0, 0);
+		if (NULL == dst)
+		{
+			return 0;
+		}
+
+		return U32(dst - (U8*)_dst);
+	}
+
+	bool lzDecompress(void* _dst, U32 _dstSize, const void* _src, U32 _srcSize)
+	{
+		const U8* src    = (const U8*)_src;
+		const U8* srcEnd = src + _srcSize;
+		U8* dst          = (U8*)_dst;
+		U8* dstEnd       = dst + _dstSize;
+
+		for (;;)
+		{
+			if (src >= srcEnd)
+			{
+				return false;
+			}
+
+			const U8 token = *src++;
+
+			U32 numLiterals = token >> 4;
+			if (15 == numLiterals
+			&&  !lzReadLength(src, srcEnd, numLiterals) )
+			{
+				return false;
+			}
+
+			if (numLiterals > U32(srcEnd - src)
+			||  numLiterals > U32(dstEnd - dst) )
+			{
+				return false;
+			}
+
+			base::memCopy(dst, src, numLiterals);
+			src += numLiterals;
+			dst += numLiterals;
+
+			// Last token has no match.
+			if (src == srcEnd)
+			{
+				return dst == dstEnd;
+			}
+
+			if (2 > srcEnd - src)
+			{
+				return false;
+			}
+
+			const U32 offset = U32(src[0]) | (U32(src[1]) << 8);
+			src += 2;
+
+			U32 matchLength = token & 15;
+			if (15 == matchLength
+			&&  !lzReadLength(src, srcEnd, matchLength) )
+			{
+				return false;
+			}
+
+			matchLength += kLzMinMatch;
+
+			if (0 == offset
+			||  offset > U32(dst - (U8*)_dst)
+			||  matchLength > U32(dstEnd - dst) )
+			{
+				return false;
+			}
+
+			const U8* ref = dst - offset;
+			if (offset >= matchLength)
+			{
+				base::memCopy(dst, ref, matchLength);
+				dst += matchLength;
+			}
+			else
+			{
+				// Overlapping match repeats last `offset` bytes.
+				for (U8* end = dst + matchLength; dst != end; ++dst, ++ref)
+				{
+					*dst = *ref;
+				}
+			}
+		}
+	}
+
+} // namespace mara
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#ifndef MARA_LZ_H_HEADER_GUARD
+#define MARA_LZ_H_HEADER_GUARD
+
+#include <mara/mara.h>
+
+namespace mara
+{
+	/// Fast byte oriented LZ77 codec used for pak entry blocks. Stream is
+	/// sequence of tokens, each with literal run followed by back reference:
+	///
+	///   token (U8)            // high nibble literal length, low nibble match length - 4
+	///   [literal length ext]  // 255 bytes while length continues, only if nibble is 15
+	///   literals
+	///   offset (U16)          // little endian distance back, absent in last token
+	///   [match length ext]
+	///
+	/// Last token carries only literals.
+	///
+
+	/// Returns worst case compressed size of `_size` bytes.
+	///
+	U32 lzCompressBound(U32 _size);
+
+	/// Compress `_srcSize` bytes of `_src` into `_dst`.
+	///
+	/// @returns Compressed size, or 0 if compressed data doesn't fit into
+	///   `_dstCapacity` bytes.
+	///
+	U32 lzCompress(void* _dst, U32 _dstCapacity, const void* _src, U32 _srcSize);
+
+	/// Decompress `_srcSize` bytes of `_src` into `_dst`.
+	///
+	/// @returns False if stream is corrupted or doesn't decompress into exactly
+	///   `_dstSize` bytes.
+	///
+	bool lzDecompress(void* _dst, U32 _dstSize, const void* _src, U32 _srcSize);
+
+} // namespace mara
+
+#endif // MARA_LZ_H_HEADER_GUARD
@@ -77,8 +77,162 @@ namespace mara {
 		// I will do this later
 	}
 
+	FrameAllocator::FrameAllocator()
+		: m_allocator(NULL)
+		, m_block(NULL)
+		, m_blockSize(0)
+		, m_total(0)
+	{
+	}
+
+	FrameAllocator::~FrameAllocator()
+	{
+		shutdown();
+	}
+
+	void FrameAllocator::init(base::AllocatorI* _allocator, U32 _blockSize)
+	{
+		// First block is allocated on first use, workers that never allocate don't reserve memory.
+		m_allocator = _allocator;
+		m_blockSize = _blockSize;
+		m_block = NULL;
+	}
+
+	void FrameAllocator::shutdown()
+	{
+		while (NULL != m_block)
+		{
+			Block* next = m_block->m_next;
+			base::free(m_allocator, m_block, Context::kAlignment);
+			m_block = next;
+		}
+	}
+
+	FrameAllocator::Block* FrameAllocator::allocBlock(U32 _size)
+	{
+		Block* block = (Block*)base::alloc(m_allocator, sizeof(Block) + _size, Context::kAlignment);
+		block->m_next = NULL;
+		block->m_size = _size;
+		block->m_used = 0;
+		return block;
+	}
+
+	void FrameAllocator::reset()
+	{
+		if (NULL != m_block
+		&&  NULL != m_block->m_next)
+		{
+			shutdown();
+
+			m_blockSize = base::max(m_blockSize, m_total);
+			m_block = allocBlock(m_blockSize);
+		}
+		else if (NULL != m_block)
+		{
+			m_block->m_used = 0;
+		}
+
+		m_total = 0;
+	}
+
+	static U8* alignPtr(U8* _ptr, U32 _align)
+	{
+		return (U8*)( (uintptr_t(_ptr) + _align - 1) & ~uintptr_t(_align - 1) );
+	}
+
+	void* FrameAllocator::realloc(void* _ptr, size_t _size, size_t _align, const char* _filePath, U32 _line)
+	{
+		BASE_UNUSED(_filePath, _line);
+
+		if (0 == _size)
+		{
+			// Frame memory is released all at once in reset.
+			return NULL;
+		}
+
+		const U32 align = U32(base::max<size_t>(_align, 8));
+		const U32 size = U32(_size);
+
+		// Allocation size is stored in front of the allocation, so realloc can copy old contents.
+		U8* data = NULL != m_block
+			? alignPtr((U8*)&m_block[1] + m_block->m_used + sizeof(U32), align)
+			: NULL
+			;
+
+		if (NULL == m_block
+		||  data + size > (U8*)&m_block[1] + m_block->m_size)
+		{
+			Block* block = allocBlock(base::max<U32>(m_blockSize, U32(size + sizeof(U32) + align) ) );
+			block->m_next = m_block;
+			m_block = block;
+
+			data = alignPtr((U8*)&m_block[1] + sizeof(U32), align);
+		}
+
+		((U32*)data)[-1] = size;
+		m_block->m_used = U32(data + size - (U8*)&m_block[1]);
+		m_total += size + align;
+
+		if (NULL != _ptr)
+		{
+			base::memCopy(data, _ptr, base::min(size, ((const U32*)_ptr)[-1]) );
+		}
+
+		return data;
+	}
+
 	bool Context::init(const Init& _init)
 	{
+		for (U32 ii = 0; ii < MARA_CONFIG_MAX_WORKERS; ++ii)
+		{
+			m_frameAllocators[ii].init(entry::getAllocator(), MARA_CONFIG_FRAME_MEMORY_SIZE);
+		}
+
+		m_jobSystem.init(entry::getAllocator(), U16(UINT16_MAX) == _init.numWorkers
+			? getNumHardwareThreads()
+			: _init.numWorkers + 1
+			, MARA_CONFIG_NUM_LOADER_THREADS
+			);
+		m_scheduler.init(&m_jobSystem);
+		m_transforms.init(entry::getAllocator(), &m_jobSystem);
+		m_boundsTree.init(entry::getAllocator() );
+		m_observers.init(entry::getAllocator() );
+		m_loader.init(entry::getAllocator(), MARA_CONFIG_NUM_LOADER_THREADS, &m_jobSystem);
+
+		m_pakHashMap.init(entry::getAllocator() );
+		m_resourceHashMap.init(entry::getAllocator() );
+		m_componentHashMap.init(entry::getAllocator() );
+		m_archetypeHashMap.init(entry::getAllocator() );
+		m_geometryHashMap.init(entry::getAllocator() );
+		m_shaderHashMap.init(entry::getAllocator() );
+		m_textureHashMap.init(entry::getAllocator() );
+		m_materialHashMap.init(entry::getAllocator() );
+		m_meshHashMap.init(entry::getAllocator() );
+		m_prefabHashMap.init(entry::getAllocator() );
+
+		m_resources.init(entry::getAllocator() );
+		m_components.init(entry::getAllocator() );
+		m_entities.init(entry::getAllocator() );
+		m_queries.init(entry::getAllocator() );
+		m_archetypes.init(entry::getAllocator() );
+		m_geometries.init(entry::getAllocator() );
+		m_shaders.init(entry::getAllocator() );
+		m_textures.init(entry::getAllocator() );
+		m_materials.init(entry::getAllocator() );
+		m_meshes.init(entry::getAllocator() );
+		m_prefabs.init(entry::getAllocator() );
+
+		for (U16 ii = 0; ii < MARA_CONFIG_MAX_WORKERS; ++ii)
+		{
+			m_commandBuffers[ii].init(entry::getAllocator(), ii);
+		}
+
+		m_headless = _init.headless;
+		if (m_headless)
+		{
+			return true;
+		}
+
 		// @todo We call graphics::renderFrame before graphics::init to signal to bgfx not to create a render thread.
 		// Most graphics APIs must be used on the same thread that created the window.
 		// graphics::renderFrame();
@@ -114,29 +268,100 @@ namespace mara {
 
 	void Context::shutdown()
 	{
-		graphics::shutdown();
+		// Loader threads may be waiting on jobs.
+		m_loader.shutdown();
+		m_scheduler.shutdown();
+		m_jobSystem.shutdown();
+		m_transforms.shutdown();
+		m_boundsTree.shutdown();
+		m_observers.shutdown();
+
+		for (U32 ii = 0; ii < MARA_CONFIG_MAX_WORKERS; ++ii)
+		{
+			m_commandBuffers[ii].shutdown();
+		}
+
+		destroyQueries();
+		destroyPrefabTemplates();
+		destroyArchetypes();
+		destroyComponentPools();
+		destroySingletons();
+
+		for (U16 ii = 0, num = m_pakHandle.getNumHandles(); ii < num; ++ii)
+		{
+			m_paks[m_pakHandle.getHandleAt(ii)].close();
+		}
+
+		m_pakHashMap.shutdown();
+		m_resourceHashMap.shutdown();
+		m_componentHashMap.shutdown();
+		m_archetypeHashMap.shutdown();
+		m_geometryHashMap.shutdown();
+		m_shaderHashMap.shutdown();
+		m_textureHashMap.shutdown();
+		m_materialHashMap.shutdown();
+		m_meshHashMap.shutdown();
+		m_prefabHashMap.shutdown();
+
+		m_resources.shutdown();
+		m_components.shutdown();
+		m_entities.shutdown();
+		m_queries.shutdown();
+		m_archetypes.shutdown();
+		m_geometries.shutdown();
+		m_shaders.shutdown();
+		m_textures.shutdown();
+		m_materials.shutdown();
+		m_meshes.shutdown();
+		m_prefabs.shutdown();
+		for (U32 ii = 0; ii < MARA_CONFIG_MAX_WORKERS; ++ii)
+		{
+			m_frameAllocators[ii].shutdown();
+		}
+
+		if (!m_headless)
+		{
+			graphics::shutdown();
+		}
 	}
 
 	bool Context::update(U32 _debug, U32 _reset)
 	{
 		// Debug mode
-		graphics::setDebug(_debug);
-		if (_debug & GRAPHICS_DEBUG_TEXT)
+		if (!m_headless)
 		{
-			graphics::dbgTextClear();
+			graphics::setDebug(_debug);
+			if (_debug & GRAPHICS_DEBUG_TEXT)
+			{
+				graphics::dbgTextClear();
+			}
 		}
 
 		// Events
 		U32 width, height;
-		if (!entry::processEvents(width, height, _debug, _reset, &m_mouseState))
+		if (m_headless
+		||  !entry::processEvents(width, height, _debug, _reset, &m_mouseState))
 		{
-			graphics::setViewRect(0, 0, 0, U16(width), U16(height));
+			if (!m_headless)
+			{
+				graphics::setViewRect(0, 0, 0, U16(width), U16(height));
+			}
+
+			// Frame memory from previous frame is no longer referenced.
+			for (U32 ii = 0, num = m_jobSystem.getNumWorkers(); ii < num; ++ii)
+			{
+				m_frameAllocators[ii].reset();
+			}
+			++m_frame;
 
 			// Time
 			const I64 frameTime = base::getHPCounter() - m_time;
 			m_time = base::getHPCounter();
 			m_deltaTime = (F32)frameTime / (F32)base::getHPFrequency();
 
+			// Publish resources loaded in background
+			resourceLoadsUpdate();
+
 			// Free resources
 			for (U16 ii = 0, num = m_freeResources.getNumQueued(); ii < num; ++ii)
 			{
@@ -174,6 +399,10 @@ namespace mara {
 			{
 				m_prefabHandle.free(m_freePrefabs.get(ii).idx);
 			}
+			for (U16 ii = 0, num = m_freeQueries.getNumQueued(); ii < num; ++ii)
+			{
+				m_queryHandle.free(m_freeQueries.get(ii).idx);
+			}
 
 			// Reset all free resource queues
 			m_freeResources.reset();
@@ -185,6 +414,19 @@ namespace mara {
 			m_freeMaterials.reset();
 			m_freeMeshes.reset();
 			m_freePrefabs.reset();
+			m_freeQueries.reset();
+
+			// Systems
+			m_scheduler.run();
+
+			// Structural changes recorded by systems and jobs
+			playbackCommandBuffers();
+
+			// World matrices of transforms changed by systems or playback
+			m_transforms.update();
+
+			// Component add and remove events of whole frame
+			m_observers.dispatch();
 
 			return true;
 		}
@@ -196,6 +438,8 @@ namespace mara {
 	Init::Init()
 		: graphicsApi(graphics::RendererType::Count)
 		, vendorId(GRAPHICS_PCI_ID_NONE)
+		, numWorkers(UINT16_MAX)
+		, headless(false)
 	{
 
 	}
@@ -234,6 +478,9 @@ namespace mara {
 		if (NULL != s_ctx)
 		{
 			s_ctx->shutdown();
+
+			BASE_DELETE(entry::getAllocator(), s_ctx);
+			s_ctx = NULL;
 		}
 	}
 
@@ -263,19 +510,209 @@ namespace mara {
 		s_ctx->destroyComponent(_handle);
 	}
 
-	void addComponent(EntityHandle _entity, U32 _type, ComponentHandle _component)
+	void addComponent(EntityHandle _entity, ComponentType _type, ComponentHandle _component)
 	{
 		s_ctx->addComponent(_entity, _type, _component);
 	}
 
-	void* getComponentData(EntityHandle _entity, U32 _type)
+	void registerComponent(ComponentType _type, U32 _size, ComponentStorage::Enum _storage, ComponentDestroyFn _destroyFn)
+	{
+		s_ctx->registerComponent(_type, _size, _storage, _destroyFn);
+	}
+
+	void* addComponent(EntityHandle _entity, ComponentType _type, const void* _data)
+	{
+		return s_ctx->addComponent(_entity, _type, _data);
+	}
+
+	void removeComponent(EntityHandle _entity, ComponentType _type)
+	{
+		s_ctx->removeComponent(_entity, _type);
+	}
+
+	void* getComponentData(EntityHandle _entity, ComponentType _type)
 	{
 		return s_ctx->getComponentData(_entity, _type);
 	}
 
-	EntityQuery* queryEntities(U32 _types)
+	void* getComponentDataMut(EntityHandle _entity, ComponentType _type)
+	{
+		return s_ctx->getComponentDataMut(_entity, _type);
+	}
+
+	U32 getComponentTick(EntityHandle _entity, ComponentType _type)
+	{
+		return s_ctx->getComponentTick(_entity, _type);
+	}
+
+	void* getSingletonData(ComponentType _type)
+	{
+		return s_ctx->getSingletonData(_type);
+	}
+
+	void* getSingletonDataMut(ComponentType _type)
+	{
+		return s_ctx->getSingletonDataMut(_type);
+	}
+
+	U32 getSingletonTick(ComponentType _type)
+	{
+		return s_ctx->getSingletonTick(_type);
+	}
+
+	U32 getFrame()
+	{
+		return s_ctx->m_frame;
+	}
+
+	EntityQuery* queryEntities(const ComponentMask& _types, const QueryFilter& _filter)
+	{
+		return s_ctx->queryEntities(_types, _filter);
+	}
+
+	void setEntityBounds(EntityHandle _entity, const base::Aabb& _aabb)
 	{
-		return s_ctx->queryEntities(_types);
+		s_ctx->setEntityBounds(_entity, _aabb);
+	}
+
+	void removeEntityBounds(EntityHandle _entity)
+	{
+		s_ctx->removeEntityBounds(_entity);
+	}
+
+	const base::Aabb* getEntityBounds(EntityHandle _entity)
+	{
+		return s_ctx->m_boundsTree.get(_entity);
+	}
+
+	EntityQuery* queryBox(const base::Aabb& _aabb)
+	{
+		return s_ctx->queryBox(_aabb);
+	}
+
+	EntityQuery* querySphere(const base::Sphere& _sphere)
+	{
+		return s_ctx->querySphere(_sphere);
+	}
+
+	EntityQuery* queryFrustum(const base::Plane* _planes, U32 _num)
+	{
+		return s_ctx->queryFrustum(_planes, _num);
+	}
+
+	U32 queryChunks(const ComponentMask& _types, EntityChunk* _outChunks, U32 _max)
+	{
+		return s_ctx->queryChunks(_types, _outChunks, _max);
+	}
+
+	void* getChunkData(const EntityChunk& _chunk, ComponentType _type)
+	{
+		return s_ctx->getChunkData(_chunk, _type);
+	}
+
+	const EntityHandle* getChunkEntities(const EntityChunk& _chunk)
+	{
+		return s_ctx->getChunkEntities(_chunk);
+	}
+
+	U32* getChunkTicks(const EntityChunk& _chunk, ComponentType _type)
+	{
+		return s_ctx->getChunkTicks(_chunk, _type);
+	}
+
+	bool addTransform(EntityHandle _entity, EntityHandle _parent)
+	{
+		return s_ctx->addTransform(_entity, _parent);
+	}
+
+	void removeTransform(EntityHandle _entity)
+	{
+		s_ctx->removeTransform(_entity);
+	}
+
+	bool setTransformParent(EntityHandle _entity, EntityHandle _parent)
+	{
+		return s_ctx->setTransformParent(_entity, _parent);
+	}
+
+	EntityHandle getTransformParent(EntityHandle _entity)
+	{
+		return s_ctx->m_transforms.getParent(_entity);
+	}
+
+	void setLocalTransform(EntityHandle _entity, const F32* _mtx)
+	{
+		s_ctx->m_transforms.setLocal(_entity, _mtx);
+	}
+
+	const F32* getLocalTransform(EntityHandle _entity)
+	{
+		return s_ctx->m_transforms.getLocal(_entity);
+	}
+
+	const F32* getWorldTransform(EntityHandle _entity)
+	{
+		return s_ctx->m_transforms.getWorld(_entity);
+	}
+
+	QueryHandle createQuery(const ComponentMask& _include, const ComponentMask& _exclude)
+	{
+		return s_ctx->createQuery(_include, _exclude);
+	}
+
+	void destroy(QueryHandle _handle)
+	{
+		s_ctx->destroyQuery(_handle);
+	}
+
+	U32 getNumEntities(QueryHandle _handle)
+	{
+		return s_ctx->getNumEntities(_handle);
+	}
+
+	const EntityHandle* getEntities(QueryHandle _handle)
+	{
+		return s_ctx->getEntities(_handle);
+	}
+
+	SystemHandle registerSystem(const char* _name, SystemFn _fn, const ComponentMask& _read, const ComponentMask& _write, void* _userData)
+	{
+		return s_ctx->registerSystem(_name, _fn, _read, _write, _userData);
+	}
+
+	void destroy(SystemHandle _handle)
+	{
+		s_ctx->destroySystem(_handle);
+	}
+
+	ObserverHandle registerObserver(ComponentType _type, ObserverFn _fn, void* _userData)
+	{
+		return s_ctx->registerObserver(_type, _fn, _userData);
+	}
+
+	void destroy(ObserverHandle _handle)
+	{
+		s_ctx->destroyObserver(_handle);
+	}
+
+	void runJob(JobFn _fn, void* _userData, JobCounter* _counter)
+	{
+		s_ctx->m_jobSystem.run(_fn, _userData, _counter);
+	}
+
+	void parallelFor(U32 _begin, U32 _end, U32 _grainSize, JobRangeFn _fn, void* _userData, JobCounter* _counter)
+	{
+		s_ctx->m_jobSystem.parallelFor(_begin, _end, _grainSize, _fn, _userData, _counter);
+	}
+
+	void wait(JobCounter* _counter)
+	{
+		s_ctx->m_jobSystem.wait(_counter);
+	}
+
+	U32 getNumWorkers()
+	{
+		return s_ctx->m_jobSystem.getNumWorkers();
 	}
 
 	EntityHandle createEntity()
@@ -288,14 +725,54 @@ namespace mara {
 		s_ctx->destroyEntity(_handle);
 	}
 
-	bool createPak(const base::FilePath& _filePath)
+	U32 createEntities(U32 _num, const ComponentMask& _types, EntityHandle* _outHandles)
+	{
+		return s_ctx->createEntities(_num, _types, _outHandles);
+	}
+
+	void destroyEntities(const EntityHandle* _handles, U32 _num)
+	{
+		s_ctx->destroyEntities(_handles, _num);
+	}
+
+	EntityCommandBuffer* getCommandBuffer()
+	{
+		return s_ctx->getCommandBuffer();
+	}
+
+	void setSortKey(EntityCommandBuffer* _ecb, U32 _sortKey)
+	{
+		s_ctx->setSortKey(_ecb, _sortKey);
+	}
+
+	EntityHandle createEntity(EntityCommandBuffer* _ecb)
 	{
-		return s_ctx->createPak(_filePath);
+		return s_ctx->createEntity(_ecb);
 	}
 
-	bool loadPak(const base::FilePath& _filePath)
+	void destroy(EntityCommandBuffer* _ecb, EntityHandle _handle)
 	{
-		return s_ctx->loadPak(_filePath);
+		s_ctx->destroyEntity(_ecb, _handle);
+	}
+
+	void addComponent(EntityCommandBuffer* _ecb, EntityHandle _entity, ComponentType _type, const void* _data)
+	{
+		s_ctx->addComponent(_ecb, _entity, _type, _data);
+	}
+
+	void removeComponent(EntityCommandBuffer* _ecb, EntityHandle _entity, ComponentType _type)
+	{
+		s_ctx->removeComponent(_ecb, _entity, _type);
+	}
+
+	bool createPak(const base::FilePath& _filePath, bool _compress)
+	{
+		return s_ctx->createPak(_filePath, _compress);
+	}
+
+	bool loadPak(const base::FilePath& _filePath, bool _mapped)
+	{
+		return s_ctx->loadPak(_filePath, _mapped);
 	}
 
 	bool unloadPak(const base::FilePath& _filePath)
@@ -303,11 +780,31 @@ namespace mara {
 		return s_ctx->unloadPak(_filePath);
 	}
 
+	bool saveWorld(const base::FilePath& _filePath)
+	{
+		return s_ctx->saveWorld(_filePath);
+	}
+
+	bool loadWorld(const base::FilePath& _filePath)
+	{
+		return s_ctx->loadWorld(_filePath);
+	}
+
 	U32 getResourceInfo(ResourceInfo* _outInfoList, bool _sort)
 	{
 		return s_ctx->getResourceInfo(_outInfoList, _sort);
 	}
 
+	ResourceStatus::Enum getResourceStatus(ResourceHandle _handle)
+	{
+		return s_ctx->getResourceStatus(_handle);
+	}
+
+	ResourceStatus::Enum waitResource(ResourceHandle _handle)
+	{
+		return s_ctx->waitResource(_handle);
+	}
+
 	GeometryHandle createGeometry(ResourceHandle _resource)
 	{
 		if (isValid(_resource))
@@ -324,6 +821,11 @@ namespace mara {
 		return s_ctx->loadGeometryResource(_filePath);
 	}
 
+	ResourceHandle loadGeometryAsync(const base::FilePath& _filePath)
+	{
+		return s_ctx->loadGeometryAsync(_filePath);
+	}
+
 	ResourceHandle createResource(const GeometryCreate& _data, const base::FilePath& _vfp)
 	{
 		return s_ctx->createGeometryResource(_data, _vfp);
@@ -350,6 +852,11 @@ namespace mara {
 		return s_ctx->loadShaderResource(_filePath);
 	}
 
+	ResourceHandle loadShaderAsync(const base::FilePath& _filePath)
+	{
+		return s_ctx->loadShaderAsync(_filePath);
+	}
+
 	ResourceHandle createResource(const ShaderCreate& _data, const base::FilePath& _vfp)
 	{
 		return s_ctx->createShaderResource(_data, _vfp);
@@ -376,6 +883,11 @@ namespace mara {
 		return s_ctx->loadTextureResource(_filePath);
 	}
 
+	ResourceHandle loadTextureAsync(const base::FilePath& _filePath)
+	{
+		return s_ctx->loadTextureAsync(_filePath);
+	}
+
 	ResourceHandle createResource(const TextureCreate& _data, const base::FilePath& _vfp)
 	{
 		return s_ctx->createTextureResource(_data, _vfp);
@@ -396,6 +908,11 @@ namespace mara {
 		return s_ctx->loadMaterialResource(_filePath);
 	}
 
+	ResourceHandle loadMaterialAsync(const base::FilePath& _filePath)
+	{
+		return s_ctx->loadMaterialAsync(_filePath);
+	}
+
 	ResourceHandle createResource(const MaterialCreate& _data, const base::FilePath& _vfp)
 	{
 		return s_ctx->createMaterialResource(_data, _vfp);
@@ -418,6 +935,11 @@ namespace mara {
 		return s_ctx->loadMeshResource(_filePath);
 	}
 
+	ResourceHandle loadMeshAsync(const base::FilePath& _filePath)
+	{
+		return s_ctx->loadMeshAsync(_filePath);
+	}
+
 	//
 	ResourceHandle createResource(const MeshCreate& _data, const base::FilePath& _vfp)
 	{
@@ -439,11 +961,26 @@ namespace mara {
 		return s_ctx->createPrefab(_resource);
 	}
 
+	PrefabHandle createPrefab(EntityHandle _entity)
+	{
+		return s_ctx->createPrefab(_entity);
+	}
+
+	U32 instantiate(PrefabHandle _handle, U32 _num, const F32* _transforms, EntityHandle* _outEntities)
+	{
+		return s_ctx->instantiate(_handle, _num, _transforms, _outEntities);
+	}
+
 	ResourceHandle loadPrefab(const base::FilePath& _filePath)
 	{
 		return s_ctx->loadPrefabResource(_filePath);
 	}
 
+	ResourceHandle loadPrefabAsync(const base::FilePath& _filePath)
+	{
+		return s_ctx->loadPrefabAsync(_filePath);
+	}
+
 	ResourceHandle createResource(const PrefabCreate& _data, const base::FilePath& _vfp)
 	{
 		return s_ctx->createPrefabResource(_data, _vfp);
@@ -134,13 +134,119 @@ namespace mara
 #include <base/endian.h>
 #include <base/math.h>
 #include <base/string.h>
+#include <base/uint32_t.h>
+#include <base/sort.h>
 
 #include <graphics/platform.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define MARA_SIMD_SSE 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#	include <arm_neon.h>
+#	define MARA_SIMD_NEON 1
+#endif // SSE2
+
+#ifndef MARA_SIMD_SSE
+#	define MARA_SIMD_SSE 0
+#endif // MARA_SIMD_SSE
+
+#ifndef MARA_SIMD_NEON
+#	define MARA_SIMD_NEON 0
+#endif // MARA_SIMD_NEON
+
+#include "scheduler.h"
+#include "command_buffer.h"
+#include "transform.h"
+#include "bounds_tree.h"
+#include "observer.h"
+#include "paged_array.h"
+#include "handle_alloc.h"
+#include "pak.h"
+#include "lz.h"
+#include "resource_loader.h"
+
 namespace mara 
 {
 	extern CallbackI* g_callback;
 
+	BASE_STATIC_ASSERT(0 == MARA_CONFIG_MAX_COMPONENT_TYPES % 128, "MARA_CONFIG_MAX_COMPONENT_TYPES must be multiple of 128.");
+
+	/// Returns true if `_mask` has all of `_types`. Cost is one AND-compare per
+	/// 128 types, independent of how many bits are set.
+	inline bool maskContains(const ComponentMask& _mask, const ComponentMask& _types)
+	{
+#if MARA_SIMD_SSE
+		__m128i missing = _mm_setzero_si128();
+		for (U32 ii = 0; ii < ComponentMask::kNumWords; ii += 2)
+		{
+			const __m128i mask  = _mm_load_si128( (const __m128i*)&_mask.m_bits[ii]);
+			const __m128i types = _mm_load_si128( (const __m128i*)&_types.m_bits[ii]);
+			missing = _mm_or_si128(missing, _mm_andnot_si128(mask, types) );
+		}
+
+		return 0xffff == _mm_movemask_epi8(_mm_cmpeq_epi8(missing, _mm_setzero_si128() ) );
+#elif MARA_SIMD_NEON
+		uint64x2_t missing = vdupq_n_u64(0);
+		for (U32 ii = 0; ii < ComponentMask::kNumWords; ii += 2)
+		{
+			const uint64x2_t mask  = vld1q_u64(&_mask.m_bits[ii]);
+			const uint64x2_t types = vld1q_u64(&_types.m_bits[ii]);
+			missing = vorrq_u64(missing, vbicq_u64(types, mask) );
+		}
+
+		return 0 == (vgetq_lane_u64(missing, 0) | vgetq_lane_u64(missing, 1) );
+#else
+		U64 missing = 0;
+		for (U32 ii = 0; ii < ComponentMask::kNumWords; ++ii)
+		{
+			missing |= _types.m_bits[ii] & ~_mask.m_bits[ii];
+		}
+
+		return 0 == missing;
+#endif // MARA_SIMD_SSE
+	}
+
+	/// Returns true if `_a` and `_b` have any type in common.
+	inline bool maskIntersects(const ComponentMask& _a, const ComponentMask& _b)
+	{
+#if MARA_SIMD_SSE
+		__m128i common = _mm_setzero_si128();
+		for (U32 ii = 0; ii < ComponentMask::kNumWords; ii += 2)
+		{
+			const __m128i aa = _mm_load_si128( (const __m128i*)&_a.m_bits[ii]);
+			const __m128i bb = _mm_load_si128( (const __m128i*)&_b.m_bits[ii]);
+			common = _mm_or_si128(common, _mm_and_si128(aa, bb) );
+		}
+
+		return 0xffff != _mm_movemask_epi8(_mm_cmpeq_epi8(common, _mm_setzero_si128() ) );
+#elif MARA_SIMD_NEON
+		uint64x2_t common = vdupq_n_u64(0);
+		for (U32 ii = 0; ii < ComponentMask::kNumWords; ii += 2)
+		{
+			common = vorrq_u64(common, vandq_u64(vld1q_u64(&_a.m_bits[ii]), vld1q_u64(&_b.m_bits[ii]) ) );
+		}
+
+		return 0 != (vgetq_lane_u64(common, 0) | vgetq_lane_u64(common, 1) );
+#else
+		U64 common = 0;
+		for (U32 ii = 0; ii < ComponentMask::kNumWords; ++ii)
+		{
+			common |= _a.m_bits[ii] & _b.m_bits[ii];
+		}
+
+		return 0 != common;
+#endif // MARA_SIMD_SSE
+	}
+
+	///
+	inline bool maskEqual(const ComponentMask& _a, const ComponentMask& _b)
+	{
+		return maskContains(_a, _b)
+			&& maskContains(_b, _a)
+			;
+	}
+
 	struct ProfilerScope
 	{
 		ProfilerScope(const char* _name, uint32_t _abgr, const char* _filePath, uint16_t _line)
@@ -174,16 +280,25 @@ namespace mara
 		};
 
 		void read(base::ReaderSeekerI* _reader, base::Error* _err) override
+		{
+			readT(_reader, _err);
+		};
+
+		void read(PakReader* _reader, base::Error* _err)
+		{
+			readT(_reader, _err);
+		};
+
+		template<typename ReaderT>
+		void readT(ReaderT* _reader, base::Error* _err)
 		{
 			U32 vertexDataSize;
 			base::read(_reader, &vertexDataSize, sizeof(vertexDataSize), _err);
-			vertexData = graphics::alloc(vertexDataSize);
-			base::read(_reader, vertexData->data, vertexDataSize, _err);
+			vertexData = readMemory(_reader, vertexDataSize, _err);
 
 			U32 indexDataSize;
 			base::read(_reader, &indexDataSize, sizeof(indexDataSize), _err);
-			indexData = graphics::alloc(indexDataSize);
-			base::read(_reader, indexData->data, indexDataSize, _err);
+			indexData = readMemory(_reader, indexDataSize, _err);
 
 			U32 layoutSize;
 			base::read(_reader, &layoutSize, sizeof(layoutSize), _err);
@@ -209,11 +324,21 @@ namespace mara
 		};
 
 		void read(base::ReaderSeekerI* _reader, base::Error* _err) override
+		{
+			readT(_reader, _err);
+		};
+
+		void read(PakReader* _reader, base::Error* _err)
+		{
+			readT(_reader, _err);
+		};
+
+		template<typename ReaderT>
+		void readT(ReaderT* _reader, base::Error* _err)
 		{
 			U32 size;
 			base::read(_reader, &size, sizeof(size), _err);
-			codeData = graphics::alloc(size);//graphics::makeRef(base::alloc(graphics::getAllocator(), size), size);
-			base::read(_reader, codeData->data, size, _err);
+			codeData = readMemory(_reader, size, _err);
 		};
 
 		const graphics::Memory* codeData;
@@ -240,6 +365,17 @@ namespace mara
 		};
 
 		void read(base::ReaderSeekerI* _reader, base::Error* _err) override
+		{
+			readT(_reader, _err);
+		};
+
+		void read(PakReader* _reader, base::Error* _err)
+		{
+			readT(_reader, _err);
+		};
+
+		template<typename ReaderT>
+		void readT(ReaderT* _reader, base::Error* _err)
 		{
 			base::read(_reader, &width, sizeof(width), _err);
 			base::read(_reader, &height, sizeof(height), _err);
@@ -249,8 +385,7 @@ namespace mara
 
 			U32 size;
 			base::read(_reader, &size, sizeof(size), _err);
-			mem = graphics::alloc(size);//graphics::makeRef(base::alloc(graphics::getAllocator(), size), size);
-			base::read(_reader, mem->data, size, _err);
+			mem = readMemory(_reader, size, _err);
 		};
 
 		U16 width;
@@ -453,38 +588,103 @@ namespace mara
 		char meshPaths[MARA_CONFIG_MAX_MESHES_PER_PREFAB][base::kMaxFilePath + 1];
 	};
 
-	struct PakEntryRef
+	struct ResourceType
 	{
-		U32 pakHash;
-		I64 offset;
+		enum Enum
+		{
+			Geometry,
+			Shader,
+			Texture,
+			Material,
+			Mesh,
+			Prefab,
+
+			Count
+		};
 	};
 
+	template<typename Ty>
+	static bool resourceRead(ResourceI* _resource, PakReader* _reader)
+	{
+		base::Error err;
+		( (Ty*)_resource)->read(_reader, &err);
+		return err.isOk();
+	}
+
 	struct ResourceRef
 	{
 		ResourceI* resource;
 		base::FilePath vfp;
 		U16 m_refCount;
+		ResourceStatus::Enum m_status;
+		LoadRequest* m_request; //!< In flight asynchronous load.
+		U16* m_deps;            //!< Resources loaded on behalf of this one, released with it.
+		U16 m_numDeps;
 	};
 
 	struct EntityRef
 	{
 		EntityRef() // @todo I don't like to use constructors like this, the code depends on it. Fix this
-			: m_mask(0)
+			: m_mask()
+			, m_archetype(kInvalidHandle)
+			, m_row(0)
 			, m_refCount(0)
 		{}
 
-		U32 m_mask;
+		ComponentMask m_mask;
+		U16 m_archetype;
+		U32 m_row;
+		U16 m_refCount;
+	};
+
+	struct QueryRef
+	{
+		ComponentMask m_include;
+		ComponentMask m_exclude;
+		U32 m_num;
+		U32 m_capacity;
+		EntityHandle* m_entities; //!< Matching entities, tightly packed.
+		U16* m_indices;           //!< Entity to index into `m_entities`, sized by highest matching entity.
+		U32 m_indicesSize;
 		U16 m_refCount;
 	};
 
+	struct ComponentTypeRef
+	{
+		U32 m_size;
+		ComponentStorage::Enum m_storage;
+		ComponentDestroyFn m_destroyFn;
+		U8* m_singleton; //!< Singleton data, NULL for other storages.
+		U32 m_tick;      //!< Frame of last singleton write.
+		bool m_registered;
+	};
+
+	struct ArchetypeRef
+	{
+		ComponentMask m_mask;
+		U16 m_numTypes;
+		U16 m_types[MARA_CONFIG_MAX_COMPONENT_TYPES];
+		U32 m_offsets[MARA_CONFIG_MAX_COMPONENT_TYPES];     //!< Column offset inside chunk, indexed by type index.
+		U32 m_tickOffsets[MARA_CONFIG_MAX_COMPONENT_TYPES]; //!< Change tick column offset inside chunk, indexed by type index.
+
+		U32 m_chunkSize;
+		U32 m_rowsPerChunk;
+		U32 m_numRows;
+		U32 m_numChunks;
+		U32 m_maxChunks;
+		U8** m_chunks;
+	};
+
 	struct ComponentRef
 	{
 		ComponentRef() // @todo I don't like to use constructors like this, the code depends on it. Fix this
 			: m_data(NULL)
+			, m_tick(0)
 			, m_refCount(0)
 		{}
 
 		ComponentI* m_data;
+		U32 m_tick;
 		U16 m_refCount;
 	};
 
@@ -535,15 +735,86 @@ namespace mara
 		U16 m_refCount;
 	};
 
+	/// Component payloads captured from entity by `mara::createPrefab`.
+	struct PrefabTemplate
+	{
+		ComponentMask m_mask;                           //!< Registered component types of template entity.
+		U32 m_offsets[MARA_CONFIG_MAX_COMPONENT_TYPES]; //!< Payload offset in `m_data`, UINT32_MAX if type is absent.
+		U8* m_data;
+		F32 m_transform[16];                            //!< Local transform, if template entity had one.
+		bool m_hasTransform;
+	};
+
+	/// World snapshot header, see `Context::saveWorld` for layout.
+	struct WorldHeader
+	{
+		U32 m_magic;
+		U32 m_version;
+		U32 m_numTypes;
+		U32 m_numEntities;
+		U32 m_numArchetypes;
+		U32 m_numPools;
+	};
+
+	struct WorldType
+	{
+		U16 m_type;
+		U16 m_storage;
+		U32 m_size;
+	};
+
+	struct WorldBlock
+	{
+		ComponentMask m_mask; //!< Archetype types, or single pool type.
+		U32 m_num;            //!< Number of rows.
+	};
+
+	static const U32 kWorldMagic   = BASE_MAKEFOURCC('M', 'W', 'L', 'D');
+	static const U32 kWorldVersion = 1;
+
 	struct PrefabRef
 	{
 		U16 m_numMeshes;
 		MeshHandle m_meshes[MARA_CONFIG_MAX_MESHES_PER_PREFAB];
+		PrefabTemplate* m_template; //!< NULL for prefabs created from resource.
 
 		U32 m_hash;
 		U16 m_refCount;
 	};
 
+	/// Linear allocator used for memory that lives for a single frame. Memory
+	/// is never freed individually, everything is released by `reset`. Not
+	/// thread safe, each worker thread allocates from its own.
+	///
+	struct FrameAllocator : public base::AllocatorI
+	{
+		FrameAllocator();
+		virtual ~FrameAllocator();
+
+		void init(base::AllocatorI* _allocator, U32 _blockSize);
+		void shutdown();
+
+		/// Release all frame memory. If frame overflowed first block, blocks are
+		/// merged into one big enough to hold whole frame.
+		void reset();
+
+		virtual void* realloc(void* _ptr, size_t _size, size_t _align, const char* _filePath, U32 _line) override;
+
+		struct Block
+		{
+			Block* m_next;
+			U32 m_size;
+			U32 m_used;
+		};
+
+		Block* allocBlock(U32 _size);
+
+		base::AllocatorI* m_allocator;
+		Block* m_block;
+		U32 m_blockSize;
+		U32 m_total;
+	};
+
 #if MARA_CONFIG_DEBUG
 #	define MARA_API_FUNC(_func) BASE_NO_INLINE _func
 #else
@@ -558,34 +829,46 @@ namespace mara
 			: m_stats(mara::Stats())
 			, m_time(0)
 			, m_deltaTime(0.0f)
+			, m_frame(1)
+			, m_headless(false)
 		{
+			base::memSet(m_componentTypes, 0, sizeof(m_componentTypes));
 		}
 
 		~Context()
 		{
 		}
 
+		/// Allocate handle and commit its slot in paged table.
+		template<typename HandleAllocT, typename ArrayT>
+		static U16 allocHandle(HandleAllocT& _handleAlloc, ArrayT& _array)
+		{
+			const U16 idx = _handleAlloc.alloc();
+			if (kInvalidHandle != idx)
+			{
+				_array.commit(idx);
+			}
+
+			return idx;
+		}
+
 		bool init(const Init& _init);
 		void shutdown();
 		bool update(U32 _debug, U32 _reset);
 
-		MARA_API_FUNC(bool createPak(const base::FilePath& _filePath))
-		{
-			// LAYOUT:                  // Example:
-			// 
-			// numEntries (U32);        // 3
-			// 
-			// hash (U32);              // 2039230
-			// entry (PakEntryRef);     // PakEntryRef()
-			// 
-			// hash (U32);              // 2039230
-			// entry (PakEntryRef);     // PakEntryRef()
-			// 
-			// hash (U32);              // 2039230
-			// entry (PakEntryRef);		// PakEntryRef()
-			// 
-			// data (we dont know, but we dont care, should always be inherited from ResourceI anyway);
-			// 
+		MARA_API_FUNC(bool createPak(const base::FilePath& _filePath, bool _compress) )
+		{
+			// LAYOUT:
+			//
+			// header (PakHeader);
+			// entries (PakEntryRef[numEntries]);  // Sorted by hash.
+			// data (U8[]);                         // Raw, or compressed (see PakEntryRef) when `_compress`
+			//                                      // is set and compression makes entry smaller.
+			//
+
+			// Resources still being loaded have no data to write yet.
+			m_loader.waitIdle();
+			resourceLoadsUpdate();
 
 			// Clear directory
 			base::removeAll(_filePath);
@@ -601,421 +884,2716 @@ namespace mara
 				return false;
 			}
 
-			// Write Entries
-			U32 numEntries = m_resourceHashMap.getNumElements();
-			base::write(&writer, &numEntries, sizeof(U32), base::ErrorAssert{});
-			//			  numEntries             hashes                      entries
-			U32 offset = sizeof(U32) + (numEntries * sizeof(U32)) + (numEntries * sizeof(PakEntryRef));
+			const U32 numEntries = m_resourceHashMap.getNumElements();
+
+			// Table is sorted by hash, so it can be searched in place when loaded.
+			U32* keys = (U32*)base::alloc(entry::getAllocator(), base::max<U32>(numEntries, 1) * 2 * sizeof(U32) );
+			U32* indices = (U32*)base::alloc(entry::getAllocator(), base::max<U32>(numEntries, 1) * 2 * sizeof(U32) );
 			for (U32 i = 0; i < numEntries; i++)
 			{
-				// Write entry hash
-				ResourceRef& resource = m_resources[i];
-				U32 entryHash = base::hash<base::HashMurmur2A>(resource.vfp.getCPtr());
-				base::write(&writer, &entryHash, sizeof(U32), base::ErrorAssert{});
+				keys[i] = base::hash<base::HashMurmur2A>(m_resources[i].vfp.getCPtr());
+				indices[i] = i;
+			}
 
-				// Create entry 
-				PakEntryRef pak;
-				U32 pakHash = base::hash<base::HashMurmur2A>(_filePath.getCPtr());
-				pak.pakHash = pakHash;
-				pak.offset = offset;
-				offset += resource.resource->getSize();
+			base::radixSort(keys, &keys[numEntries], indices, &indices[numEntries], numEntries);
 
-				// Write entry 
-				base::write(&writer, &pak, sizeof(PakEntryRef), base::ErrorAssert{});
-			}
+			PakEntryRef* entries = (PakEntryRef*)base::alloc(entry::getAllocator(), base::max<U32>(numEntries, 1) * sizeof(PakEntryRef) );
+			base::memSet(entries, 0, numEntries * sizeof(PakEntryRef) );
+
+			// Entry sizes are known only after compression, table is written
+			// again once data is written.
+			PakHeader header;
+			header.magic = kPakMagic;
+			header.version = kPakVersion;
+			header.numEntries = numEntries;
+			header.reserved = 0;
+			base::write(&writer, &header, sizeof(PakHeader), base::ErrorAssert{});
+			base::write(&writer, entries, numEntries * sizeof(PakEntryRef), base::ErrorAssert{});
 
 			// Write Data
+			I64 offset = sizeof(PakHeader) + numEntries * sizeof(PakEntryRef);
+			U8* data = NULL;
+			U32 dataSize = 0;
 			for (U32 i = 0; i < numEntries; i++)
 			{
-				// Write resource data
-				ResourceRef& resource = m_resources[i];
-				resource.resource->write(&writer, base::ErrorAssert{});
+				ResourceRef& resource = m_resources[indices[i] ];
+
+				PakEntryRef& pak = entries[i];
+				pak.hash = keys[i];
+				pak.flags = 0;
+				pak.offset = offset;
+				pak.size = resource.resource->getSize();
+				pak.compressedSize = pak.size;
+
+				if (_compress)
+				{
+					if (pak.size > dataSize)
+					{
+						dataSize = pak.size;
+						data = (U8*)base::realloc(entry::getAllocator(), data, dataSize);
+					}
+
+					base::StaticMemoryBlockWriter memWriter(data, pak.size);
+					resource.resource->write(&memWriter, base::ErrorAssert{});
+
+					const U32 compressedSize = pakWriteCompressed(&writer, data, pak.size, MARA_CONFIG_PAK_BLOCK_SIZE, base::ErrorAssert{});
+					if (0 == compressedSize)
+					{
+						base::write(&writer, data, pak.size, base::ErrorAssert{});
+					}
+					else
+					{
+						pak.flags |= MARA_PAK_ENTRY_COMPRESSED;
+						pak.compressedSize = compressedSize;
+					}
+				}
+				else
+				{
+					resource.resource->write(&writer, base::ErrorAssert{});
+				}
+
+				offset += pak.compressedSize;
 			}
 
+			// Write Entries
+			base::seek(&writer, sizeof(PakHeader), base::Whence::Begin);
+			base::write(&writer, entries, numEntries * sizeof(PakEntryRef), base::ErrorAssert{});
+
+			base::close(&writer);
+
+			base::free(entry::getAllocator(), data);
+			base::free(entry::getAllocator(), entries);
+			base::free(entry::getAllocator(), indices);
+			base::free(entry::getAllocator(), keys);
+
 			return true;
 		}
 
-		MARA_API_FUNC(bool loadPak(const base::FilePath& _filePath))
+		static U32 worldWrite(base::WriterI* _writer, const void* _data, U32 _size, U32 _offset)
 		{
-			// Get File Reader.
-			U32 hash = base::hash<base::HashMurmur2A>(_filePath.getCPtr());
-			U16 fileReaderHandle = m_pakHashMap.find(hash);
-			if (fileReaderHandle != kInvalidHandle)
+			base::write(_writer, _data, I32(_size), base::ErrorAssert{});
+			return _offset + _size;
+		}
+
+		static U32 worldAlign(base::WriterI* _writer, U32 _offset)
+		{
+			static const U8 s_zero[16] = {};
+			const U32 pad = ( (_offset + 15) & ~15u) - _offset;
+			return worldWrite(_writer, s_zero, pad, _offset);
+		}
+
+		MARA_API_FUNC(bool saveWorld(const base::FilePath& _filePath))
+		{
+			// LAYOUT:
+			//
+			// header (WorldHeader);
+			// types (WorldType[numTypes]);              // Schema, verified against registered types on load.
+			// entities (U16[numEntities]);              // Handle indices are preserved.
+			// masks (ComponentMask[numEntities]);       // 16 byte aligned.
+			//
+			// numArchetypes times:
+			//   block (WorldBlock);                     // 16 byte aligned.
+			//   entities (EntityHandle[num]);           // 16 byte aligned.
+			//   data (U8[num * size]);                  // One 16 byte aligned block per type, ascending type order.
+			//
+			// numPools times:
+			//   block (WorldBlock);                     // 16 byte aligned.
+			//   entities (EntityHandle[num]);           // 16 byte aligned.
+			//   data (U8[num * size]);                  // 16 byte aligned.
+			//
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			base::FileWriter writer;
+			if (!base::open(&writer, _filePath, base::ErrorAssert{}))
 			{
-				BASE_TRACE("Already loaded this pack.")
+				BASE_TRACE("Failed to write world at path %s.", _filePath.getCPtr());
 				return false;
 			}
-			fileReaderHandle = m_pakHandle.alloc();
-			m_pakHashMap.insert(hash, fileReaderHandle);
-			
-			base::FileReader* pr = &m_paks[fileReaderHandle];
 
-			// Open file (This file will stay open until unloadPack() is called).
-			if (!base::open(pr, _filePath, base::ErrorAssert{}))
+			ComponentMask registered;
+			U32 numPools = 0;
+			for (U16 ii = 0; ii < MARA_CONFIG_MAX_COMPONENT_TYPES; ++ii)
 			{
-				BASE_TRACE("Failed to open pack at path %s.", _filePath.getCPtr());
-				return false;
+				const ComponentTypeRef& ct = m_componentTypes[ii];
+				if (ct.m_registered)
+				{
+					registered.set({ ii });
+					numPools += ComponentStorage::Sparse == ct.m_storage && 0 != m_componentPools[ii].getNum();
+				}
 			}
 
-			// Read Entries
-			U32 numEntries;
-			base::read(pr, &numEntries, sizeof(U32), base::ErrorAssert{});
-			for (U32 i = 0; i < numEntries; i++)
+			const U16 numHandles = m_entityHandle.getNumHandles();
+
+			WorldHeader header;
+			header.m_magic = kWorldMagic;
+			header.m_version = kWorldVersion;
+			header.m_numTypes = 0;
+			header.m_numEntities = 0;
+			header.m_numArchetypes = 0;
+			header.m_numPools = numPools;
+
+			for (U16 ii = 0; ii < MARA_CONFIG_MAX_COMPONENT_TYPES; ++ii)
 			{
-				// Read entry hash
-				U32 hash;
-				base::read(pr, &hash, sizeof(U32), base::ErrorAssert{});
+				header.m_numTypes += registered.test({ ii });
+			}
 
-				// Read and create entry handle
-				U16 entryHandle = m_pakEntryHandle.alloc();
-				bool ok = m_pakEntryHashMap.insert(hash, entryHandle);
-				BASE_ASSERT(ok, " pack already loaded.")
-				base::read(pr, &m_pakEntries[entryHandle], sizeof(PakEntryRef), base::ErrorAssert{});
+			for (U16 ii = 0; ii < numHandles; ++ii)
+			{
+				const EntityRef& er = m_entities[m_entityHandle.getHandleAt(ii)];
+				if (0 != er.m_refCount)
+				{
+					BASE_WARN(maskContains(registered, er.m_mask), "Components of unregistered types are not saved.");
+					++header.m_numEntities;
+				}
 			}
-			
-			return true;
-		}
 
-		MARA_API_FUNC(bool unloadPak(const base::FilePath& _filePath))
-		{
-			// Get File Reader.
-			U32 hash = base::hash<base::HashMurmur2A>(_filePath.getCPtr());
-			U16 fileReaderHandle = m_pakHashMap.find(hash);
-			base::FileReader& pr = m_paks[fileReaderHandle];
+			for (U16 ii = 0, num = m_archetypeHandle.getNumHandles(); ii < num; ++ii)
+			{
+				header.m_numArchetypes += 0 != m_archetypes[m_archetypeHandle.getHandleAt(ii)].m_numRows;
+			}
 
-			// Make sure we read from beginning since resources could've already been loaded 
-			// and we would be in a different position.
-			base::seek(&pr, 0, base::Whence::Begin);
+			U32 offset = worldWrite(&writer, &header, sizeof(header), 0);
 
-			// Read Entries
-			U32 numEntries;
-			base::read(&pr, &numEntries, sizeof(U32), base::ErrorAssert{});
-			for (U32 i = 0; i < numEntries; i++)
+			for (U16 ii = 0; ii < MARA_CONFIG_MAX_COMPONENT_TYPES; ++ii)
 			{
-				// Read entry hash
-				U32 hash;
-				base::read(&pr, &hash, sizeof(U32), base::ErrorAssert{});
-
-				// Find resource at hash if we have it loaded 
-				U16 handle = m_resourceHashMap.find(hash);
-				if (kInvalidHandle != handle)
+				if (registered.test({ ii }) )
 				{
-					destroyResource({ handle });
+					WorldType wt;
+					wt.m_type = ii;
+					wt.m_storage = U16(m_componentTypes[ii].m_storage);
+					wt.m_size = m_componentTypes[ii].m_size;
+					offset = worldWrite(&writer, &wt, sizeof(wt), offset);
 				}
+			}
 
-				// Find already created entry handle using hash
-				U16 entryHandle = m_pakEntryHashMap.find(hash);
+			for (U16 ii = 0; ii < numHandles; ++ii)
+			{
+				const U16 idx = m_entityHandle.getHandleAt(ii);
+				if (0 != m_entities[idx].m_refCount)
+				{
+					offset = worldWrite(&writer, &idx, sizeof(idx), offset);
+				}
+			}
 
-				// Remove entry from map
-				m_pakEntryHashMap.removeByHandle(entryHandle);
-				m_pakEntryHandle.free(entryHandle);
+			offset = worldAlign(&writer, offset);
+			for (U16 ii = 0; ii < numHandles; ++ii)
+			{
+				const EntityRef& er = m_entities[m_entityHandle.getHandleAt(ii)];
+				if (0 != er.m_refCount)
+				{
+					ComponentMask mask = er.m_mask;
+					for (U32 jj = 0; jj < ComponentMask::kNumWords; ++jj)
+					{
+						mask.m_bits[jj] &= registered.m_bits[jj];
+					}
 
-				// Jump over the entry data as we dont need that when unloading.
-				base::seek(&pr, sizeof(PakEntryRef), base::Whence::Current);
+					offset = worldWrite(&writer, &mask, sizeof(mask), offset);
+				}
 			}
 
-			// Finally close the  pack file since its no longer in use.
-			base::close(&pr);
+			// Archetype columns are written chunk by chunk, so each column is contiguous in file.
+			for (U16 ii = 0, num = m_archetypeHandle.getNumHandles(); ii < num; ++ii)
+			{
+				const ArchetypeRef& ar = m_archetypes[m_archetypeHandle.getHandleAt(ii)];
+				if (0 == ar.m_numRows)
+				{
+					continue;
+				}
 
-			// Remove reader from map
-			m_pakHashMap.removeByHandle(fileReaderHandle);
-			m_pakHandle.free(fileReaderHandle);
+				WorldBlock block;
+				block.m_mask = ar.m_mask;
+				block.m_num = ar.m_numRows;
+				offset = worldAlign(&writer, offset);
+				offset = worldWrite(&writer, &block, sizeof(block), offset);
 
-			return true;
-		}
+				offset = worldAlign(&writer, offset);
+				for (U32 row = 0; row < ar.m_numRows; row += ar.m_rowsPerChunk)
+				{
+					const U32 count = base::min<U32>(ar.m_rowsPerChunk, ar.m_numRows - row);
+					offset = worldWrite(&writer, archetypeGetData(ar, row, 0, sizeof(EntityHandle) ), count * sizeof(EntityHandle), offset);
+				}
 
-		void resourceIncRef(ResourceHandle _handle)
-		{
-			ResourceRef& sr = m_resources[_handle.idx];
-			++sr.m_refCount;
-		}
+				for (U16 jj = 0; jj < MARA_CONFIG_MAX_COMPONENT_TYPES; ++jj)
+				{
+					if (!ar.m_mask.test({ jj }) )
+					{
+						continue;
+					}
 
-		void resourceDecRef(ResourceHandle _handle)
-		{
-			ResourceRef& sr = m_resources[_handle.idx];
-			U16 refs = --sr.m_refCount;
+					const U32 size = m_componentTypes[jj].m_size;
+					offset = worldAlign(&writer, offset);
+					for (U32 row = 0; row < ar.m_numRows; row += ar.m_rowsPerChunk)
+					{
+						const U32 count = base::min<U32>(ar.m_rowsPerChunk, ar.m_numRows - row);
+						offset = worldWrite(&writer, archetypeGetData(ar, row, ar.m_offsets[jj], size), count * size, offset);
+					}
+				}
+			}
 
-			if (0 == refs)
+			for (U16 ii = 0; ii < MARA_CONFIG_MAX_COMPONENT_TYPES; ++ii)
 			{
-				bool ok = m_freeResources.queue(_handle); BASE_UNUSED(ok);
-				BASE_ASSERT(ok, "Resource handle %d is already destroyed!", _handle.idx);
+				const ComponentPoolBase& pool = m_componentPools[ii];
+				if (!registered.test({ ii })
+				||  ComponentStorage::Sparse != m_componentTypes[ii].m_storage
+				||  0 == pool.getNum() )
+				{
+					continue;
+				}
 
-				delete sr.resource;
+				WorldBlock block;
+				block.m_mask = ComponentMask();
+				block.m_mask.set({ ii });
+				block.m_num = pool.getNum();
+				offset = worldAlign(&writer, offset);
+				offset = worldWrite(&writer, &block, sizeof(block), offset);
 
-				m_resourceHashMap.removeByHandle(_handle.idx);
+				offset = worldAlign(&writer, offset);
+				offset = worldWrite(&writer, pool.getEntities(), block.m_num * sizeof(EntityHandle), offset);
+
+				offset = worldAlign(&writer, offset);
+				offset = worldWrite(&writer, pool.getData(), block.m_num * pool.m_size, offset);
 			}
+
+			base::close(&writer);
+			return true;
 		}
 
-		bool resourceFindOrCreate(U32 _hash, ResourceHandle& _handle)
+		template<typename Ty>
+		static bool worldTake(const U8*& _ptr, const U8* _end, U64 _num, const Ty*& _out)
 		{
-			U16 idx = m_resourceHashMap.find(_hash);
-			if (kInvalidHandle != idx)
-			{
-				ResourceHandle handle = { idx };
-				resourceIncRef(handle);
-				_handle = handle;
-				return true;
-			}
-			else
+			if (_ptr > _end
+			||  U64(_end - _ptr) / sizeof(Ty) < _num)
 			{
-				_handle = { m_resourceHandle.alloc() };
+				BASE_TRACE("World snapshot is truncated.");
 				return false;
 			}
+
+			_out = (const Ty*)_ptr;
+			_ptr += _num * sizeof(Ty);
+			return true;
 		}
 
-		MARA_API_FUNC(ResourceHandle createResource(const base::FilePath& _vfp))
+		static const U8* worldAlign(const U8* _data, const U8* _end, const U8* _ptr)
 		{
-			U32 hash = base::hash<base::HashMurmur2A>(_vfp.getCPtr());
-
-			ResourceHandle handle;
-			if (resourceFindOrCreate(hash, handle))
-			{
-				return handle;
-			}
-
-			bool ok = m_resourceHashMap.insert(hash, handle.idx);
-			BASE_ASSERT(ok, "Resource already exists!"); BASE_UNUSED(ok);
-
-			ResourceRef& rr = m_resources[handle.idx];
-			rr.m_refCount = 1;
-			rr.vfp = _vfp;
-			return handle;
+			const U64 offset = (U64(_ptr - _data) + 15) & ~U64(15);
+			return _data + base::min<U64>(offset, U64(_end - _data) );
 		}
 
-		MARA_API_FUNC(void destroyResource(ResourceHandle _handle))
+		/// Walks snapshot in memory. Blocks are used in place, pointers into `_data` are
+		/// only computed. When `_apply` is false snapshot is only validated.
+		bool worldParse(const U8* _data, U32 _size, bool _apply)
 		{
-			MARA_MUTEX_SCOPE(m_resourceApiLock);
+			const U8* ptr = _data;
+			const U8* end = _data + _size;
 
-			if (!isValid(_handle) && !m_resourceHandle.isValid(_handle.idx))
+			const WorldHeader* header;
+			if (!worldTake(ptr, end, 1, header) )
 			{
-				BASE_WARN(false, "Passing invalid resource handle to mara::destroyResource.");
-				return;
+				return false;
 			}
 
-			resourceDecRef(_handle);
-		}
+			if (kWorldMagic != header->m_magic
+			||  kWorldVersion != header->m_version)
+			{
+				BASE_TRACE("Not a world snapshot or unsupported version.");
+				return false;
+			}
 
-		// @todo Make heap allocated array
+			const WorldType* types;
+			if (!worldTake(ptr, end, header->m_numTypes, types) )
+			{
+				return false;
+			}
+
+			ComponentMask tableTypes;
+			ComponentMask sparseTypes;
+			for (U32 ii = 0; ii < header->m_numTypes; ++ii)
+			{
+				const WorldType& wt = types[ii];
+				if (wt.m_type >= MARA_CONFIG_MAX_COMPONENT_TYPES
+				||  !m_componentTypes[wt.m_type].m_registered
+				||  m_componentTypes[wt.m_type].m_size != wt.m_size
+				||  U16(m_componentTypes[wt.m_type].m_storage) != wt.m_storage)
+				{
+					BASE_TRACE("Component type %d doesn't match registered type.", wt.m_type);
+					return false;
+				}
+
+				if (ComponentStorage::Table == m_componentTypes[wt.m_type].m_storage)
+				{
+					tableTypes.set({ wt.m_type });
+				}
+				else
+				{
+					sparseTypes.set({ wt.m_type });
+				}
+			}
+
+			const U16* entities;
+			if (!worldTake(ptr, end, header->m_numEntities, entities) )
+			{
+				return false;
+			}
+
+			ptr = worldAlign(_data, end, ptr);
+			const ComponentMask* masks;
+			if (!worldTake(ptr, end, header->m_numEntities, masks) )
+			{
+				return false;
+			}
+
+			// Validation pass maps saved entities to their index in entity list, so rows of
+			// archetype and pool blocks can be checked before apply pass uses them as handles.
+			U32* slots    = NULL;
+			U8*  placed   = NULL;
+			U32* pooled   = NULL;
+			U32* lastPool = NULL;
+			ComponentMask poolTypes;
+
+			// Archetypes snapshot would create must fit into free archetype handles, apply
+			// pass can't fail halfway.
+			const ComponentMask** newMasks = NULL;
+			U32 numNewMasks = 0;
+			const U32 numFreeArchetypes = MARA_CONFIG_MAX_ARCHETYPES - m_archetypeHandle.getNumHandles();
+
+			if (!_apply)
+			{
+				slots = (U32*)base::alloc(getFrameAllocator(), MARA_CONFIG_MAX_ENTITIES * sizeof(U32) );
+				base::memSet(slots, 0xff, MARA_CONFIG_MAX_ENTITIES * sizeof(U32) );
+
+				const U32 numEntities = base::max<U32>(header->m_numEntities, 1);
+				placed   = (U8* )base::alloc(getFrameAllocator(), numEntities);
+				pooled   = (U32*)base::alloc(getFrameAllocator(), numEntities * sizeof(U32) );
+				lastPool = (U32*)base::alloc(getFrameAllocator(), numEntities * sizeof(U32) );
+				base::memSet(placed,   0, numEntities);
+
+				newMasks = (const ComponentMask**)base::alloc(getFrameAllocator(), base::max<U32>(numFreeArchetypes, 1) * sizeof(ComponentMask*) );
+				base::memSet(pooled,   0, numEntities * sizeof(U32) );
+				base::memSet(lastPool, 0, numEntities * sizeof(U32) );
+
+				const ComponentMask snapshotTypes = tableTypes | sparseTypes;
+				for (U32 ii = 0; ii < header->m_numEntities; ++ii)
+				{
+					if (entities[ii] >= MARA_CONFIG_MAX_ENTITIES
+					||  UINT32_MAX != slots[entities[ii] ])
+					{
+						BASE_TRACE("World snapshot entity %d is out of range or duplicated.", entities[ii]);
+						return false;
+					}
+
+					if (!maskContains(snapshotTypes, masks[ii]) )
+					{
+						BASE_TRACE("World snapshot entity %d has component types not in snapshot.", entities[ii]);
+						return false;
+					}
+
+					slots[entities[ii] ] = ii;
+				}
+			}
+			else
+			{
+				// Allocate handles until all saved indices are taken, then release the rest.
+				U32 numTaken = 0;
+				for (U32 ii = 0; ii < header->m_numEntities; ++ii)
+				{
+					m_entities.commit(entities[ii]).m_refCount = UINT16_MAX;
+				}
+
+				U16* unused = (U16*)base::alloc(getFrameAllocator(), MARA_CONFIG_MAX_ENTITIES * sizeof(U16) );
+				U32 numUnused = 0;
+				while (numTaken < header->m_numEntities)
+				{
+					const U16 idx = allocHandle(m_entityHandle, m_entities);
+					BASE_ASSERT(kInvalidHandle != idx, "Entity handles exhausted while loading world.");
+
+					if (UINT16_MAX == m_entities[idx].m_refCount)
+					{
+						++numTaken;
+					}
+					else
+					{
+						unused[numUnused++] = idx;
+					}
+				}
+
+				for (U32 ii = 0; ii < numUnused; ++ii)
+				{
+					m_entityHandle.free(unused[ii]);
+				}
+
+				for (U32 ii = 0; ii < header->m_numEntities; ++ii)
+				{
+					EntityRef& er = m_entities[entities[ii] ];
+					er.m_refCount = 1;
+					er.m_mask = masks[ii];
+					er.m_archetype = kInvalidHandle;
+				}
+			}
+
+			for (U32 ii = 0; ii < header->m_numArchetypes; ++ii)
+			{
+				ptr = worldAlign(_data, end, ptr);
+				const WorldBlock* block;
+				if (!worldTake(ptr, end, 1, block) )
+				{
+					return false;
+				}
+
+				ptr = worldAlign(_data, end, ptr);
+				const EntityHandle* rows;
+				if (!worldTake(ptr, end, block->m_num, rows) )
+				{
+					return false;
+				}
+
+				if (block->m_mask.isEmpty() )
+				{
+					BASE_TRACE("World snapshot archetype has no component types.");
+					return false;
+				}
+
+				if (!_apply
+				&&  kInvalidHandle == archetypeFind(block->m_mask, base::hash<base::HashMurmur2A>(&block->m_mask, sizeof(ComponentMask) ) ) )
+				{
+					U32 jj = 0;
+					while (jj < numNewMasks && !maskEqual(*newMasks[jj], block->m_mask) )
+					{
+						++jj;
+					}
+
+					if (jj == numNewMasks)
+					{
+						if (numNewMasks == numFreeArchetypes)
+						{
+							BASE_TRACE("World snapshot needs more archetypes than are free, increase MARA_CONFIG_MAX_ARCHETYPES.");
+							return false;
+						}
+
+						newMasks[numNewMasks++] = &block->m_mask;
+					}
+				}
+
+				if (!_apply)
+				{
+					for (U32 jj = 0; jj < block->m_num; ++jj)
+					{
+						const U32 slot = rows[jj].idx < MARA_CONFIG_MAX_ENTITIES ? slots[rows[jj].idx] : UINT32_MAX;
+						if (UINT32_MAX == slot
+						||  0 != placed[slot])
+						{
+							BASE_TRACE("World snapshot archetype row %d is not saved entity or is duplicated.", rows[jj].idx);
+							return false;
+						}
+
+						ComponentMask tableMask = masks[slot];
+						for (U32 ww = 0; ww < ComponentMask::kNumWords; ++ww)
+						{
+							tableMask.m_bits[ww] &= tableTypes.m_bits[ww];
+						}
+
+						if (!maskEqual(tableMask, block->m_mask) )
+						{
+							BASE_TRACE("World snapshot archetype row %d doesn't match entity mask.", rows[jj].idx);
+							return false;
+						}
+
+						placed[slot] = 1;
+					}
+				}
+
+				U16 archetype = kInvalidHandle;
+				U32 first = 0;
+				if (_apply)
+				{
+					archetype = archetypeFindOrCreate(block->m_mask);
+					first = m_archetypes[archetype].m_numRows;
+					archetypeAllocRows(archetype, rows, block->m_num);
+				}
+
+				for (U16 jj = 0; jj < MARA_CONFIG_MAX_COMPONENT_TYPES; ++jj)
+				{
+					if (!block->m_mask.test({ jj }) )
+					{
+						continue;
+					}
+
+					if (!m_componentTypes[jj].m_registered
+					||  ComponentStorage::Table != m_componentTypes[jj].m_storage)
+					{
+						BASE_TRACE("Component type %d is not registered as table component.", jj);
+						return false;
+					}
+
+					const U32 size = m_componentTypes[jj].m_size;
+					ptr = worldAlign(_data, end, ptr);
+					const U8* column;
+					if (!worldTake(ptr, end, U64(block->m_num) * size, column) )
+					{
+						return false;
+					}
+
+					if (_apply)
+					{
+						ArchetypeRef& ar = m_archetypes[archetype];
+						for (U32 done = 0; done < block->m_num;)
+						{
+							const U32 row = first + done;
+							const U32 count = base::min<U32>(block->m_num - done, ar.m_rowsPerChunk - row % ar.m_rowsPerChunk);
+							base::memCopy(archetypeGetData(ar, row, ar.m_offsets[jj], size), &column[done * size], count * size);
+							done += count;
+						}
+					}
+				}
+			}
+
+			for (U32 ii = 0; ii < header->m_numPools; ++ii)
+			{
+				ptr = worldAlign(_data, end, ptr);
+				const WorldBlock* block;
+				if (!worldTake(ptr, end, 1, block) )
+				{
+					return false;
+				}
+
+				ptr = worldAlign(_data, end, ptr);
+				const EntityHandle* rows;
+				if (!worldTake(ptr, end, block->m_num, rows) )
+				{
+					return false;
+				}
+
+				U16 type = 0;
+				while (type < MARA_CONFIG_MAX_COMPONENT_TYPES && !block->m_mask.test({ type }) )
+				{
+					++type;
+				}
+
+				if (MARA_CONFIG_MAX_COMPONENT_TYPES == type
+				||  !m_componentTypes[type].m_registered
+				||  ComponentStorage::Sparse != m_componentTypes[type].m_storage)
+				{
+					BASE_TRACE("World snapshot pool type is not registered as sparse component.");
+					return false;
+				}
+
+				if (!_apply)
+				{
+					if (poolTypes.test({ type }) )
+					{
+						BASE_TRACE("World snapshot has more than one pool of type %d.", type);
+						return false;
+					}
+
+					poolTypes.set({ type });
+
+					for (U32 jj = 0; jj < block->m_num; ++jj)
+					{
+						const U32 slot = rows[jj].idx < MARA_CONFIG_MAX_ENTITIES ? slots[rows[jj].idx] : UINT32_MAX;
+						if (UINT32_MAX == slot
+						||  ii + 1 == lastPool[slot]
+						||  !masks[slot].test({ type }) )
+						{
+							BASE_TRACE("World snapshot pool row %d is not saved entity with type %d.", rows[jj].idx, type);
+							return false;
+						}
+
+						lastPool[slot] = ii + 1;
+						++pooled[slot];
+					}
+				}
+
+				const U32 size = m_componentTypes[type].m_size;
+				ptr = worldAlign(_data, end, ptr);
+				const U8* data;
+				if (!worldTake(ptr, end, U64(block->m_num) * size, data) )
+				{
+					return false;
+				}
+
+				if (_apply)
+				{
+					ComponentPoolBase& pool = m_componentPools[type];
+					for (U32 jj = 0; jj < block->m_num; ++jj)
+					{
+						base::memCopy(pool.insert(rows[jj]), &data[jj * size], size);
+						pool.setTick(rows[jj], m_frame);
+					}
+				}
+			}
+
+			if (_apply)
+			{
+				for (U32 ii = 0; ii < header->m_numEntities; ++ii)
+				{
+					const EntityHandle handle = { entities[ii] };
+					queryUpdateEntity(handle, ComponentMask(), masks[ii]);
+				}
+			}
+			else
+			{
+				// Every saved component must have storage, otherwise entity mask would
+				// point at rows that don't exist after load.
+				for (U32 ii = 0; ii < header->m_numEntities; ++ii)
+				{
+					bool hasTable = false;
+					U32 numSparse = 0;
+					for (U32 ww = 0; ww < ComponentMask::kNumWords; ++ww)
+					{
+						hasTable  |= 0 != (masks[ii].m_bits[ww] & tableTypes.m_bits[ww]);
+						numSparse += U32(base::uint64_cntbits(masks[ii].m_bits[ww] & sparseTypes.m_bits[ww]) );
+					}
+
+					if (hasTable != (0 != placed[ii])
+					||  numSparse != pooled[ii])
+					{
+						BASE_TRACE("World snapshot entity %d is missing component data.", entities[ii]);
+						return false;
+					}
+				}
+			}
+
+			return true;
+		}
+
+		MARA_API_FUNC(bool loadWorld(const base::FilePath& _filePath))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			if (0 != m_entityHandle.getNumHandles() )
+			{
+				BASE_TRACE("World must be empty before loading snapshot %s.", _filePath.getCPtr());
+				return false;
+			}
+
+			base::FileReader reader;
+			if (!base::open(&reader, _filePath, base::ErrorAssert{}))
+			{
+				BASE_TRACE("Failed to open world at path %s.", _filePath.getCPtr());
+				return false;
+			}
+
+			// Whole snapshot is read with single call, blocks are copied straight into storage.
+			const U32 size = U32(base::getSize(&reader) );
+			U8* data = (U8*)base::alloc(entry::getAllocator(), size, 16);
+			const bool read = I32(size) == base::read(&reader, data, I32(size), base::ErrorAssert{});
+			base::close(&reader);
+
+			const bool ok = read
+				&& worldParse(data, size, false)
+				&& worldParse(data, size, true)
+				;
+
+			base::free(entry::getAllocator(), data, 16);
+			return ok;
+		}
+
+		MARA_API_FUNC(bool loadPak(const base::FilePath& _filePath, bool _mapped))
+		{
+			// Get File Reader.
+			U32 hash = base::hash<base::HashMurmur2A>(_filePath.getCPtr());
+			U16 fileReaderHandle = m_pakHashMap.find(hash);
+			if (fileReaderHandle != kInvalidHandle)
+			{
+				BASE_TRACE("Already loaded this pack.")
+				return false;
+			}
+			fileReaderHandle = m_pakHandle.alloc();
+
+			PakFile* pf = &m_paks[fileReaderHandle];
+
+			// Open file (This file will stay open, or mapped, until unloadPack() is called).
+			if (!pf->open(_filePath, _mapped) )
+			{
+				BASE_TRACE("Failed to open pack at path %s.", _filePath.getCPtr());
+				m_pakHandle.free(fileReaderHandle);
+				return false;
+			}
+
+			// Entries are looked up in pak table of contents, nothing to insert.
+			m_pakHashMap.insert(hash, fileReaderHandle);
+
+			return true;
+		}
+
+		MARA_API_FUNC(bool unloadPak(const base::FilePath& _filePath))
+		{
+			// Get File Reader.
+			U32 hash = base::hash<base::HashMurmur2A>(_filePath.getCPtr());
+			U16 fileReaderHandle = m_pakHashMap.find(hash);
+			if (kInvalidHandle == fileReaderHandle)
+			{
+				BASE_TRACE("Pack at path %s is not loaded.", _filePath.getCPtr());
+				return false;
+			}
+
+			// Loader threads may still be reading from this pak.
+			m_loader.waitIdle();
+			resourceLoadsUpdate();
+
+			PakFile& pf = m_paks[fileReaderHandle];
+			for (U32 i = 0; i < pf.m_numEntries; i++)
+			{
+				// Find resource at hash if we have it loaded 
+				U16 handle = m_resourceHashMap.find(pf.m_toc[i].hash);
+				if (kInvalidHandle != handle)
+				{
+					destroyResource({ handle });
+				}
+			}
+
+			// Finally close the  pack file since its no longer in use. Mapping
+			// stays alive until graphics releases payloads referencing it.
+			pf.close();
+
+			// Remove reader from map
+			m_pakHashMap.removeByHandle(fileReaderHandle);
+			m_pakHandle.free(fileReaderHandle);
+
+			return true;
+		}
+
+		/// Returns entry of resource with path `_hash` from any loaded pak, and
+		/// pak containing it in `_pak`.
+		const PakEntryRef* pakFind(U32 _hash, PakFile** _pak)
+		{
+			for (U16 ii = 0, num = m_pakHandle.getNumHandles(); ii < num; ++ii)
+			{
+				PakFile* pak = &m_paks[m_pakHandle.getHandleAt(ii)];
+
+				const PakEntryRef* entry = pak->find(_hash);
+				if (NULL != entry)
+				{
+					*_pak = pak;
+					return entry;
+				}
+			}
+
+			*_pak = NULL;
+			return NULL;
+		}
+
+		void resourceIncRef(ResourceHandle _handle)
+		{
+			ResourceRef& sr = m_resources[_handle.idx];
+			++sr.m_refCount;
+		}
+
+		void resourceDecRef(ResourceHandle _handle)
+		{
+			ResourceRef& sr = m_resources[_handle.idx];
+			U16 refs = --sr.m_refCount;
+
+			if (0 == refs)
+			{
+				bool ok = m_freeResources.queue(_handle); BASE_UNUSED(ok);
+				BASE_ASSERT(ok, "Resource handle %d is already destroyed!", _handle.idx);
+
+				delete sr.resource;
+				sr.resource = NULL;
+				sr.m_status = ResourceStatus::Failed;
+
+				if (NULL != sr.m_request)
+				{
+					m_loader.cancel(sr.m_request);
+					sr.m_request = NULL;
+				}
+
+				for (U16 ii = 0; ii < sr.m_numDeps; ++ii)
+				{
+					resourceDecRef({ sr.m_deps[ii] });
+				}
+
+				base::free(entry::getAllocator(), sr.m_deps);
+				sr.m_deps = NULL;
+				sr.m_numDeps = 0;
+
+				m_resourceHashMap.removeByHandle(_handle.idx);
+			}
+		}
+
+		bool resourceFindOrCreate(U32 _hash, ResourceHandle& _handle)
+		{
+			U16 idx = m_resourceHashMap.find(_hash);
+			if (kInvalidHandle != idx)
+			{
+				ResourceHandle handle = { idx };
+				resourceIncRef(handle);
+				_handle = handle;
+				return true;
+			}
+			else
+			{
+				_handle = { allocHandle(m_resourceHandle, m_resources) };
+
+				ResourceRef& rr = m_resources[_handle.idx];
+				rr.resource = NULL;
+				rr.m_status = ResourceStatus::Ready;
+				rr.m_request = NULL;
+				rr.m_deps = NULL;
+				rr.m_numDeps = 0;
+				return false;
+			}
+		}
+
+		MARA_API_FUNC(ResourceHandle createResource(const base::FilePath& _vfp))
+		{
+			U32 hash = base::hash<base::HashMurmur2A>(_vfp.getCPtr());
+
+			ResourceHandle handle;
+			if (resourceFindOrCreate(hash, handle))
+			{
+				return handle;
+			}
+
+			bool ok = m_resourceHashMap.insert(hash, handle.idx);
+			BASE_ASSERT(ok, "Resource already exists!"); BASE_UNUSED(ok);
+
+			ResourceRef& rr = m_resources[handle.idx];
+			rr.m_refCount = 1;
+			rr.vfp = _vfp;
+			return handle;
+		}
+
+		MARA_API_FUNC(void destroyResource(ResourceHandle _handle))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			if (!isValid(_handle) && !m_resourceHandle.isValid(_handle.idx))
+			{
+				BASE_WARN(false, "Passing invalid resource handle to mara::destroyResource.");
+				return;
+			}
+
+			resourceDecRef(_handle);
+		}
+
+		// @todo Make heap allocated array
 		MARA_API_FUNC(U32 getResourceInfo(ResourceInfo* _outInfoList, bool _sort))
 		{
-			U32 count = 0;
+			U32 count = 0;
+
+			// Give information about each loaded resource
+			for (U32 i = 0, num = m_resources.getSize(); i < num; i++)
+			{
+				if (m_resources[i].vfp.isEmpty())
+				{
+					break;
+				}
+
+				_outInfoList[i].vfp = m_resources[i].vfp;
+				_outInfoList[i].refCount = m_resources[i].m_refCount;
+				count++;
+			}
+
+			// Simple bouble sort
+			if (_sort && count > 1)
+			{
+				for (U32 i = 0; i < count - 1; i++)
+				{
+					for (U32 j = 0; j < count - i - 1; j++)
+					{
+						if (base::strCmp(_outInfoList[j].vfp.getCPtr(), _outInfoList[j + 1].vfp.getCPtr()) > 0)
+						{
+							ResourceInfo temp = _outInfoList[j];
+							_outInfoList[j] = _outInfoList[j + 1];
+							_outInfoList[j + 1] = temp;
+						}
+					}
+				}
+			}
+
+			return count;
+		}
+
+		template<typename Ty>
+		ResourceHandle resourceLoadAsync(const base::FilePath& _filePath, ResourceType::Enum _type)
+		{
+			U32 hash = base::hash<base::HashMurmur2A>(_filePath.getCPtr());
+
+			PakFile* pak;
+			const PakEntryRef* per = pakFind(hash, &pak);
+			if (NULL == per
+			&&  kInvalidHandle == m_resourceHashMap.find(hash) )
+			{
+				BASE_TRACE("Resource %s is not in any loaded pak.", _filePath.getCPtr() );
+				return MARA_INVALID_HANDLE;
+			}
+
+			ResourceHandle handle;
+			if (resourceFindOrCreate(hash, handle))
+			{
+				return handle;
+			}
+
+			bool ok = m_resourceHashMap.insert(hash, handle.idx);
+			BASE_ASSERT(ok, "Resource already exists!"); BASE_UNUSED(ok);
+
+			// Resource is published by resourceLoadsUpdate once loader is done with it.
+			ResourceRef& rr = m_resources[handle.idx];
+			rr.m_refCount = 1;
+			rr.vfp = _filePath;
+			rr.m_status = ResourceStatus::Loading;
+			rr.m_request = m_loader.load(handle.idx, U8(_type), new Ty(), resourceRead<Ty>, pak, *per);
+
+			return handle;
+		}
+
+		MARA_API_FUNC(ResourceHandle loadGeometryAsync(const base::FilePath& _filePath))
+		{
+			return resourceLoadAsync<GeometryResource>(_filePath, ResourceType::Geometry);
+		}
+
+		MARA_API_FUNC(ResourceHandle loadShaderAsync(const base::FilePath& _filePath))
+		{
+			return resourceLoadAsync<ShaderResource>(_filePath, ResourceType::Shader);
+		}
+
+		MARA_API_FUNC(ResourceHandle loadTextureAsync(const base::FilePath& _filePath))
+		{
+			return resourceLoadAsync<TextureResource>(_filePath, ResourceType::Texture);
+		}
+
+		MARA_API_FUNC(ResourceHandle loadMaterialAsync(const base::FilePath& _filePath))
+		{
+			return resourceLoadAsync<MaterialResource>(_filePath, ResourceType::Material);
+		}
+
+		MARA_API_FUNC(ResourceHandle loadMeshAsync(const base::FilePath& _filePath))
+		{
+			return resourceLoadAsync<MeshResource>(_filePath, ResourceType::Mesh);
+		}
+
+		MARA_API_FUNC(ResourceHandle loadPrefabAsync(const base::FilePath& _filePath))
+		{
+			return resourceLoadAsync<PrefabResource>(_filePath, ResourceType::Prefab);
+		}
+
+		/// Start loading resources that `create*` of loaded resource would load
+		/// synchronously, so they are ready by the time it's called.
+		void resourceLoadDeps(ResourceHandle _handle, ResourceType::Enum _type)
+		{
+			ResourceRef& rr = m_resources[_handle.idx];
+
+			ResourceHandle deps[MARA_CONFIG_MAX_MESHES_PER_PREFAB + 2];
+			U16 num = 0;
+
+			switch (_type)
+			{
+			case ResourceType::Material:
+				{
+					MaterialResource* resource = (MaterialResource*)rr.resource;
+					deps[num++] = loadShaderAsync(resource->vertPath);
+					deps[num++] = loadShaderAsync(resource->fragPath);
+
+					for (U32 ii = 0, numParams = resource->parameters.parameterHashMap.getNumElements(); ii < numParams; ++ii)
+					{
+						const MaterialParameters::UniformData& data = resource->parameters.parameters[ii];
+						if (data.type == graphics::UniformType::Sampler
+						&&  num < BASE_COUNTOF(deps) )
+						{
+							deps[num++] = loadTextureAsync( (const char*)data.data->data);
+						}
+					}
+				}
+				break;
+
+			case ResourceType::Mesh:
+				{
+					MeshResource* resource = (MeshResource*)rr.resource;
+					deps[num++] = loadMaterialAsync(resource->materialPath);
+					deps[num++] = loadGeometryAsync(resource->geometryPath);
+				}
+				break;
+
+			case ResourceType::Prefab:
+				{
+					PrefabResource* resource = (PrefabResource*)rr.resource;
+					for (U16 ii = 0; ii < resource->m_numMeshes; ++ii)
+					{
+						deps[num++] = loadMeshAsync(resource->meshPaths[ii]);
+					}
+				}
+				break;
+
+			default:
+				break;
+			}
+
+			if (0 == num)
+			{
+				return;
+			}
+
+			rr.m_deps = (U16*)base::alloc(entry::getAllocator(), num * sizeof(U16) );
+			for (U16 ii = 0; ii < num; ++ii)
+			{
+				if (isValid(deps[ii]) )
+				{
+					rr.m_deps[rr.m_numDeps++] = deps[ii].idx;
+				}
+				else
+				{
+					rr.m_status = ResourceStatus::Failed;
+				}
+			}
+		}
+
+		/// Publish resources finished by loader threads. Main thread only.
+		void resourceLoadsUpdate()
+		{
+			for (LoadRequest* request = m_loader.collect(); NULL != request; request = m_loader.collect() )
+			{
+				if (request->m_cancelled)
+				{
+					delete request->m_resource;
+				}
+				else
+				{
+					ResourceHandle handle = { request->m_handle };
+					ResourceRef& rr = m_resources[handle.idx];
+					rr.m_request = NULL;
+
+					if (request->m_ok)
+					{
+						rr.resource = request->m_resource;
+						rr.m_status = ResourceStatus::Ready;
+						resourceLoadDeps(handle, ResourceType::Enum(request->m_type) );
+					}
+					else
+					{
+						BASE_TRACE("Failed to load resource %s.", rr.vfp.getCPtr() );
+						delete request->m_resource;
+						rr.m_status = ResourceStatus::Failed;
+					}
+				}
+
+				m_loader.release(request);
+			}
+		}
+
+		MARA_API_FUNC(ResourceStatus::Enum getResourceStatus(ResourceHandle _handle))
+		{
+			if (!isValid(_handle)
+			||  !m_resourceHandle.isValid(_handle.idx) )
+			{
+				return ResourceStatus::Failed;
+			}
+
+			const ResourceRef& rr = m_resources[_handle.idx];
+			ResourceStatus::Enum status = rr.m_status;
+
+			for (U16 ii = 0; ii < rr.m_numDeps && ResourceStatus::Failed != status; ++ii)
+			{
+				const ResourceStatus::Enum depStatus = getResourceStatus({ rr.m_deps[ii] });
+				if (ResourceStatus::Ready != depStatus)
+				{
+					status = depStatus;
+				}
+			}
+
+			return status;
+		}
+
+		MARA_API_FUNC(ResourceStatus::Enum waitResource(ResourceHandle _handle))
+		{
+			resourceLoadsUpdate();
+
+			ResourceStatus::Enum status = getResourceStatus(_handle);
+			while (ResourceStatus::Loading == status)
+			{
+				m_loader.waitCompleted();
+				resourceLoadsUpdate();
+				status = getResourceStatus(_handle);
+			}
+
+			return status;
+		}
+
+		void componentIncRef(ComponentHandle _handle)
+		{
+			ComponentRef& sr = m_components[_handle.idx];
+			++sr.m_refCount;
+		}
+
+		void componentDecRef(ComponentHandle _handle)
+		{
+			ComponentRef& sr = m_components[_handle.idx];
+			U16 refs = --sr.m_refCount;
+
+			if (0 == refs)
+			{
+				bool ok = m_freeComponents.queue(_handle); BASE_UNUSED(ok);
+				BASE_ASSERT(ok, "Component handle %d is already destroyed!", _handle.idx);
+
+				// @todo We are using delete because we are using virtual destructors. Can we do this manually?
+				delete sr.m_data; 
+				sr.m_data = NULL;
+			}
+		}
+
+		MARA_API_FUNC(ComponentHandle createComponent(ComponentI* _data))
+		{
+			ComponentHandle handle = { allocHandle(m_componentHandle, m_components) };
+
+			if (isValid(handle))
+			{
+				ComponentRef& sr = m_components[handle.idx];
+				sr.m_refCount = 1;
+
+				sr.m_data = _data;
+				
+				return handle;
+			}
+
+			BASE_TRACE("Failed to create component handle.");
+			return MARA_INVALID_HANDLE;
+		}
+
+		MARA_API_FUNC(void destroyComponent(ComponentHandle _handle))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			if (!isValid(_handle) && !m_componentHandle.isValid(_handle.idx))
+			{
+				BASE_WARN(false, "Passing invalid component handle to mara::destroyComponent.");
+				return;
+			}
+
+			componentDecRef(_handle);
+		}
+
+		static U32 componentKey(EntityHandle _entity, ComponentType _type)
+		{
+			return U32(_type.idx) << 16 | _entity.idx;
+		}
+
+		MARA_API_FUNC(void addComponent(EntityHandle _entity, ComponentType _type, ComponentHandle _component))
+		{
+			bool ok = m_componentHashMap.insert(componentKey(_entity, _type), _component.idx);
+			BASE_ASSERT(ok, "Entities cannot have duplicated components!", _entity.idx);
+			m_components[_component.idx].m_tick = m_frame;
+
+			EntityRef& sr = m_entities[_entity.idx];
+			const ComponentMask mask = sr.m_mask;
+			sr.m_mask.set(_type);
+
+			queryUpdateEntity(_entity, mask, sr.m_mask);
+		}
+
+		bool hasComponent(EntityHandle _handle, ComponentType _type)
+		{
+			return m_entities[_handle.idx].m_mask.test(_type);
+		}
+
+		U32 archetypeLayout(ArchetypeRef& _ar, U32 _rows)
+		{
+			// Entity handles come first, then one 16 byte aligned array per component type
+			// followed by its change ticks.
+			U32 offset = _rows * sizeof(EntityHandle);
+			for (U16 ii = 0; ii < _ar.m_numTypes; ++ii)
+			{
+				const U16 idx = _ar.m_types[ii];
+				offset = (offset + 15) & ~15u;
+				_ar.m_offsets[idx] = offset;
+				offset += _rows * m_componentTypes[idx].m_size;
+
+				offset = (offset + 3) & ~3u;
+				_ar.m_tickOffsets[idx] = offset;
+				offset += _rows * sizeof(U32);
+			}
+
+			return offset;
+		}
+
+		U16 archetypeFind(const ComponentMask& _mask, U32 _hash)
+		{
+			const U16 idx = m_archetypeHashMap.find(_hash);
+			if (kInvalidHandle == idx
+			||  maskEqual(m_archetypes[idx].m_mask, _mask) )
+			{
+				return idx;
+			}
+
+			// Hash collision, only first archetype with hash is in hash map.
+			for (U16 ii = 0, num = m_archetypeHandle.getNumHandles(); ii < num; ++ii)
+			{
+				const U16 handle = m_archetypeHandle.getHandleAt(ii);
+				if (maskEqual(m_archetypes[handle].m_mask, _mask) )
+				{
+					return handle;
+				}
+			}
+
+			return kInvalidHandle;
+		}
+
+		U16 archetypeFindOrCreate(const ComponentMask& _mask)
+		{
+			const U32 hash = base::hash<base::HashMurmur2A>(&_mask, sizeof(ComponentMask) );
+
+			U16 idx = archetypeFind(_mask, hash);
+			if (kInvalidHandle != idx)
+			{
+				return idx;
+			}
+
+			idx = allocHandle(m_archetypeHandle, m_archetypes);
+			if (kInvalidHandle == idx)
+			{
+				BASE_TRACE("Failed to create archetype, increase MARA_CONFIG_MAX_ARCHETYPES.");
+				return kInvalidHandle;
+			}
+
+			m_archetypeHashMap.insert(hash, idx);
+
+			ArchetypeRef& ar = m_archetypes[idx];
+			ar.m_mask = _mask;
+			ar.m_numTypes = 0;
+			ar.m_numRows = 0;
+			ar.m_numChunks = 0;
+			ar.m_maxChunks = 0;
+			ar.m_chunks = NULL;
+
+			U32 stride = sizeof(EntityHandle);
+			for (U32 ii = 0; ii < MARA_CONFIG_MAX_COMPONENT_TYPES; ++ii)
+			{
+				ar.m_offsets[ii] = UINT32_MAX;
+				ar.m_tickOffsets[ii] = UINT32_MAX;
+
+				if (_mask.test({ U16(ii) }) )
+				{
+					ar.m_types[ar.m_numTypes++] = U16(ii);
+					stride += m_componentTypes[ii].m_size + sizeof(U32);
+				}
+			}
+
+			// Fit as many rows as possible into a chunk, components bigger than a chunk get one row per chunk.
+			U32 rows = base::max<U32>(MARA_CONFIG_ARCHETYPE_CHUNK_SIZE / stride, 1);
+			while (rows > 1 && archetypeLayout(ar, rows) > MARA_CONFIG_ARCHETYPE_CHUNK_SIZE)
+			{
+				--rows;
+			}
+
+			ar.m_rowsPerChunk = rows;
+			ar.m_chunkSize = base::max<U32>(archetypeLayout(ar, rows), MARA_CONFIG_ARCHETYPE_CHUNK_SIZE);
+
+			return idx;
+		}
+
+		U8* archetypeGetData(const ArchetypeRef& _ar, U32 _row, U32 _offset, U32 _size)
+		{
+			U8* chunk = _ar.m_chunks[_row / _ar.m_rowsPerChunk];
+			return chunk + _offset + (_row % _ar.m_rowsPerChunk) * _size;
+		}
+
+		U32* archetypeGetTick(const ArchetypeRef& _ar, U32 _row, U16 _type)
+		{
+			return (U32*)archetypeGetData(_ar, _row, _ar.m_tickOffsets[_type], sizeof(U32) );
+		}
+
+		void archetypeReserveRows(ArchetypeRef& _ar, U32 _num)
+		{
+			const U32 numChunks = (_ar.m_numRows + _num + _ar.m_rowsPerChunk - 1) / _ar.m_rowsPerChunk;
+			if (numChunks > _ar.m_maxChunks)
+			{
+				_ar.m_maxChunks = base::max<U32>(base::max<U32>(_ar.m_maxChunks * 2, 4), numChunks);
+				_ar.m_chunks = (U8**)base::realloc(entry::getAllocator(), _ar.m_chunks, _ar.m_maxChunks * sizeof(U8*));
+			}
+
+			while (_ar.m_numChunks < numChunks)
+			{
+				_ar.m_chunks[_ar.m_numChunks++] = (U8*)base::alloc(entry::getAllocator(), _ar.m_chunkSize, kAlignment);
+			}
+		}
+
+		U32 archetypeAllocRow(ArchetypeRef& _ar, EntityHandle _entity)
+		{
+			archetypeReserveRows(_ar, 1);
+
+			const U32 row = _ar.m_numRows++;
+			*(EntityHandle*)archetypeGetData(_ar, row, 0, sizeof(EntityHandle)) = _entity;
+
+			return row;
+		}
+
+		/// Append zero initialized rows for entities, filling chunks one contiguous run at a time.
+		void archetypeAllocRows(U16 _archetype, const EntityHandle* _entities, U32 _num, const PrefabTemplate* _template = NULL)
+		{
+			ArchetypeRef& ar = m_archetypes[_archetype];
+			archetypeReserveRows(ar, _num);
+
+			for (U32 done = 0; done < _num;)
+			{
+				const U32 row = ar.m_numRows;
+				const U32 num = base::min<U32>(_num - done, ar.m_rowsPerChunk - row % ar.m_rowsPerChunk);
+
+				base::memCopy(archetypeGetData(ar, row, 0, sizeof(EntityHandle) ), &_entities[done], num * sizeof(EntityHandle) );
+
+				for (U16 ii = 0; ii < ar.m_numTypes; ++ii)
+				{
+					const U16 idx = ar.m_types[ii];
+					const U32 size = m_componentTypes[idx].m_size;
+					U8* data = archetypeGetData(ar, row, ar.m_offsets[idx], size);
+					if (NULL != _template
+					&&  UINT32_MAX != _template->m_offsets[idx])
+					{
+						// Stamp first copy from template, then double copied range until run is filled.
+						base::memCopy(data, &_template->m_data[_template->m_offsets[idx] ], size);
+						for (U32 filled = 1; filled < num;)
+						{
+							const U32 count = base::min<U32>(filled, num - filled);
+							base::memCopy(data + filled * size, data, count * size);
+							filled += count;
+						}
+					}
+					else
+					{
+						base::memSet(data, 0, num * size);
+					}
+
+					U32* ticks = archetypeGetTick(ar, row, idx);
+					for (U32 jj = 0; jj < num; ++jj)
+					{
+						ticks[jj] = m_frame;
+					}
+				}
+
+				for (U32 jj = 0; jj < num; ++jj)
+				{
+					EntityRef& er = m_entities[_entities[done + jj].idx];
+					er.m_archetype = _archetype;
+					er.m_row = row + jj;
+				}
+
+				ar.m_numRows += num;
+				done += num;
+			}
+		}
+
+		void archetypeRemoveRow(ArchetypeRef& _ar, U32 _row)
+		{
+			// Swap remove, last row is moved into the hole to keep chunks tightly packed.
+			const U32 last = --_ar.m_numRows;
+			if (_row != last)
+			{
+				EntityHandle moved = *(EntityHandle*)archetypeGetData(_ar, last, 0, sizeof(EntityHandle));
+				*(EntityHandle*)archetypeGetData(_ar, _row, 0, sizeof(EntityHandle)) = moved;
+
+				for (U16 ii = 0; ii < _ar.m_numTypes; ++ii)
+				{
+					const U16 idx = _ar.m_types[ii];
+					const U32 size = m_componentTypes[idx].m_size;
+					base::memCopy(
+						  archetypeGetData(_ar, _row, _ar.m_offsets[idx], size)
+						, archetypeGetData(_ar, last, _ar.m_offsets[idx], size)
+						, size
+						);
+					*archetypeGetTick(_ar, _row, idx) = *archetypeGetTick(_ar, last, idx);
+				}
+
+				m_entities[moved.idx].m_row = _row;
+			}
+
+			// Keep one empty chunk around to avoid thrashing when entities move back and forth.
+			while (_ar.m_numChunks > 1
+			&& (_ar.m_numChunks - 1) * _ar.m_rowsPerChunk >= _ar.m_numRows + _ar.m_rowsPerChunk)
+			{
+				base::free(entry::getAllocator(), _ar.m_chunks[--_ar.m_numChunks], kAlignment);
+			}
+		}
+
+		void entitySetArchetype(EntityHandle _handle, U16 _archetype)
+		{
+			EntityRef& er = m_entities[_handle.idx];
+			const U16 src = er.m_archetype;
+
+			U32 row = 0;
+			if (kInvalidHandle != _archetype)
+			{
+				ArchetypeRef& dar = m_archetypes[_archetype];
+				row = archetypeAllocRow(dar, _handle);
+
+				for (U16 ii = 0; ii < dar.m_numTypes; ++ii)
+				{
+					const U16 idx = dar.m_types[ii];
+					const U32 size = m_componentTypes[idx].m_size;
+					U8* dst = archetypeGetData(dar, row, dar.m_offsets[idx], size);
+
+					if (kInvalidHandle != src
+					&&  UINT32_MAX != m_archetypes[src].m_offsets[idx])
+					{
+						const ArchetypeRef& sar = m_archetypes[src];
+						base::memCopy(dst, archetypeGetData(sar, er.m_row, sar.m_offsets[idx], size), size);
+						*archetypeGetTick(dar, row, idx) = *archetypeGetTick(sar, er.m_row, idx);
+					}
+					else
+					{
+						base::memSet(dst, 0, size);
+						*archetypeGetTick(dar, row, idx) = m_frame;
+					}
+				}
+			}
+
+			if (kInvalidHandle != src)
+			{
+				archetypeRemoveRow(m_archetypes[src], er.m_row);
+			}
+
+			er.m_archetype = _archetype;
+			er.m_row = row;
+		}
+
+		void archetypeDestroyRow(const ArchetypeRef& _ar, U32 _row)
+		{
+			for (U16 ii = 0; ii < _ar.m_numTypes; ++ii)
+			{
+				const ComponentTypeRef& ct = m_componentTypes[_ar.m_types[ii] ];
+				if (NULL != ct.m_destroyFn)
+				{
+					ct.m_destroyFn(archetypeGetData(_ar, _row, _ar.m_offsets[_ar.m_types[ii] ], ct.m_size) );
+				}
+			}
+		}
+
+		void destroyArchetypes()
+		{
+			for (U16 ii = 0, num = m_archetypeHandle.getNumHandles(); ii < num; ++ii)
+			{
+				ArchetypeRef& ar = m_archetypes[m_archetypeHandle.getHandleAt(ii)];
+				for (U32 row = 0; row < ar.m_numRows; ++row)
+				{
+					archetypeDestroyRow(ar, row);
+				}
+
+				for (U32 jj = 0; jj < ar.m_numChunks; ++jj)
+				{
+					base::free(entry::getAllocator(), ar.m_chunks[jj], kAlignment);
+				}
+
+				base::free(entry::getAllocator(), ar.m_chunks);
+			}
+
+			m_archetypeHashMap.reset();
+			m_archetypeHandle.reset();
+		}
+
+		void destroyComponentPools()
+		{
+			for (U32 ii = 0; ii < MARA_CONFIG_MAX_COMPONENT_TYPES; ++ii)
+			{
+				m_componentPools[ii].shutdown();
+			}
+		}
+
+		MARA_API_FUNC(void registerComponent(ComponentType _type, U32 _size, ComponentStorage::Enum _storage, ComponentDestroyFn _destroyFn))
+		{
+			BASE_ASSERT(0 != _size, "Component size cannot be zero.");
+			BASE_ASSERT(_type.idx < MARA_CONFIG_MAX_COMPONENT_TYPES, "Component type out of range, increase MARA_CONFIG_MAX_COMPONENT_TYPES.");
+
+			const U32 idx = _type.idx;
+			ComponentTypeRef& ct = m_componentTypes[idx];
+			BASE_ASSERT(!ct.m_registered, "Component type is already registered.");
+			ct.m_size = _size;
+			ct.m_storage = _storage;
+			ct.m_destroyFn = _destroyFn;
+			ct.m_registered = true;
+
+			if (ComponentStorage::Sparse == _storage)
+			{
+				m_componentPools[idx].init(_size, 16, _destroyFn, entry::getAllocator() );
+			}
+			else if (ComponentStorage::Singleton == _storage)
+			{
+				ct.m_singleton = (U8*)base::alloc(entry::getAllocator(), _size, 16);
+				ct.m_tick = m_frame;
+				base::memSet(ct.m_singleton, 0, _size);
+			}
+		}
+
+		void destroySingletons()
+		{
+			for (U32 ii = 0; ii < MARA_CONFIG_MAX_COMPONENT_TYPES; ++ii)
+			{
+				ComponentTypeRef& ct = m_componentTypes[ii];
+				if (NULL != ct.m_singleton)
+				{
+					if (NULL != ct.m_destroyFn)
+					{
+						ct.m_destroyFn(ct.m_singleton);
+					}
+
+					base::free(entry::getAllocator(), ct.m_singleton, 16);
+					ct.m_singleton = NULL;
+				}
+			}
+		}
+
+		MARA_API_FUNC(void* getSingletonData(ComponentType _type))
+		{
+			const ComponentTypeRef& ct = m_componentTypes[_type.idx];
+			BASE_ASSERT(NULL != ct.m_singleton, "Component type %d is not registered as singleton.", _type.idx);
+			return ct.m_singleton;
+		}
+
+		MARA_API_FUNC(void* getSingletonDataMut(ComponentType _type))
+		{
+			ComponentTypeRef& ct = m_componentTypes[_type.idx];
+			BASE_ASSERT(NULL != ct.m_singleton, "Component type %d is not registered as singleton.", _type.idx);
+			ct.m_tick = m_frame;
+			return ct.m_singleton;
+		}
+
+		MARA_API_FUNC(U32 getSingletonTick(ComponentType _type))
+		{
+			const ComponentTypeRef& ct = m_componentTypes[_type.idx];
+			return NULL != ct.m_singleton ? ct.m_tick : 0;
+		}
+
+		MARA_API_FUNC(void* addComponent(EntityHandle _entity, ComponentType _type, const void* _data))
+		{
+			const U32 idx = _type.idx;
+			const ComponentTypeRef& ct = m_componentTypes[idx];
+			BASE_ASSERT(ct.m_registered, "Component type must be registered before adding it by value.");
+			BASE_ASSERT(ComponentStorage::Singleton != ct.m_storage, "Singleton components can't be added to entities.");
+
+			EntityRef& er = m_entities[_entity.idx];
+			BASE_ASSERT(!er.m_mask.test(_type), "Entities cannot have duplicated components!");
+
+			if (ComponentStorage::Sparse == ct.m_storage)
+			{
+				void* data = m_componentPools[idx].insert(_entity);
+				m_componentPools[idx].setTick(_entity, m_frame);
+				if (NULL != _data)
+				{
+					base::memCopy(data, _data, ct.m_size);
+				}
+				else
+				{
+					base::memSet(data, 0, ct.m_size);
+				}
+
+				const ComponentMask mask = er.m_mask;
+				er.m_mask.set(_type);
+
+				queryUpdateEntity(_entity, mask, er.m_mask);
+
+				return data;
+			}
+
+			const ComponentMask tableMask = (kInvalidHandle != er.m_archetype ? m_archetypes[er.m_archetype].m_mask : ComponentMask() ) | _type;
+			const U16 archetype = archetypeFindOrCreate(tableMask);
+			if (kInvalidHandle == archetype)
+			{
+				return NULL;
+			}
+
+			entitySetArchetype(_entity, archetype);
+			const ComponentMask mask = er.m_mask;
+			er.m_mask.set(_type);
+
+			queryUpdateEntity(_entity, mask, er.m_mask);
+
+			const ArchetypeRef& ar = m_archetypes[archetype];
+			U8* data = archetypeGetData(ar, er.m_row, ar.m_offsets[idx], ct.m_size);
+			if (NULL != _data)
+			{
+				base::memCopy(data, _data, ct.m_size);
+			}
+
+			return data;
+		}
+
+		MARA_API_FUNC(void removeComponent(EntityHandle _entity, ComponentType _type))
+		{
+			EntityRef& er = m_entities[_entity.idx];
+			if (!er.m_mask.test(_type) )
+			{
+				return;
+			}
+
+			const U32 typeIdx = _type.idx;
+			const ComponentTypeRef& ct = m_componentTypes[typeIdx];
+			if (!ct.m_registered)
+			{
+				const U32 key = componentKey(_entity, _type);
+				const U16 idx = m_componentHashMap.find(key);
+				if (kInvalidHandle != idx)
+				{
+					destroyComponent({ idx });
+					m_componentHashMap.removeByKey(key);
+				}
+			}
+			else if (ComponentStorage::Sparse == ct.m_storage)
+			{
+				m_componentPools[typeIdx].remove(_entity);
+			}
+			else
+			{
+				const ArchetypeRef& ar = m_archetypes[er.m_archetype];
+
+				// Resolve destination first, entity keeps its row if archetypes are exhausted.
+				ComponentMask tableMask = ar.m_mask;
+				tableMask.unset(_type);
+				const U16 archetype = !tableMask.isEmpty() ? archetypeFindOrCreate(tableMask) : kInvalidHandle;
+				if (!tableMask.isEmpty()
+				&&  kInvalidHandle == archetype)
+				{
+					BASE_TRACE("Failed to remove component %d, out of archetypes.", typeIdx);
+					return;
+				}
+
+				if (NULL != ct.m_destroyFn)
+				{
+					ct.m_destroyFn(archetypeGetData(ar, er.m_row, ar.m_offsets[typeIdx], ct.m_size) );
+				}
+
+				entitySetArchetype(_entity, archetype);
+			}
+
+			const ComponentMask mask = er.m_mask;
+			er.m_mask.unset(_type);
+
+			queryUpdateEntity(_entity, mask, er.m_mask);
+		}
+
+		MARA_API_FUNC(U32 queryChunks(const ComponentMask& _types, EntityChunk* _outChunks, U32 _max))
+		{
+			U32 num = 0;
+
+			for (U16 ii = 0, numArchetypes = m_archetypeHandle.getNumHandles(); ii < numArchetypes; ++ii)
+			{
+				const U16 idx = m_archetypeHandle.getHandleAt(ii);
+				const ArchetypeRef& ar = m_archetypes[idx];
+				if (!maskContains(ar.m_mask, _types) )
+				{
+					continue;
+				}
+
+				for (U32 row = 0, chunk = 0; row < ar.m_numRows; row += ar.m_rowsPerChunk, ++chunk)
+				{
+					if (NULL != _outChunks)
+					{
+						if (num == _max)
+						{
+							return num;
+						}
+
+						EntityChunk& ec = _outChunks[num];
+						ec.m_archetype = idx;
+						ec.m_chunk = U16(chunk);
+						ec.m_count = base::min<U32>(ar.m_rowsPerChunk, ar.m_numRows - row);
+					}
+
+					++num;
+				}
+			}
+
+			return num;
+		}
+
+		MARA_API_FUNC(void* getChunkData(const EntityChunk& _chunk, ComponentType _type))
+		{
+			const ArchetypeRef& ar = m_archetypes[_chunk.m_archetype];
+			const U32 offset = ar.m_offsets[_type.idx];
+			if (UINT32_MAX == offset)
+			{
+				return NULL;
+			}
+
+			return ar.m_chunks[_chunk.m_chunk] + offset;
+		}
+
+		MARA_API_FUNC(const EntityHandle* getChunkEntities(const EntityChunk& _chunk))
+		{
+			const ArchetypeRef& ar = m_archetypes[_chunk.m_archetype];
+			return (const EntityHandle*)ar.m_chunks[_chunk.m_chunk];
+		}
+
+		MARA_API_FUNC(U32* getChunkTicks(const EntityChunk& _chunk, ComponentType _type))
+		{
+			const ArchetypeRef& ar = m_archetypes[_chunk.m_archetype];
+			const U32 offset = ar.m_tickOffsets[_type.idx];
+			if (UINT32_MAX == offset)
+			{
+				return NULL;
+			}
+
+			return (U32*)(ar.m_chunks[_chunk.m_chunk] + offset);
+		}
+
+		MARA_API_FUNC(bool addTransform(EntityHandle _entity, EntityHandle _parent))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			if (!isValid(_entity) )
+			{
+				BASE_WARN(false, "Passing invalid entity handle to mara::addTransform.");
+				return false;
+			}
+
+			return m_transforms.add(_entity, _parent);
+		}
+
+		MARA_API_FUNC(void removeTransform(EntityHandle _entity))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			m_transforms.remove(_entity);
+		}
+
+		MARA_API_FUNC(bool setTransformParent(EntityHandle _entity, EntityHandle _parent))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			return m_transforms.setParent(_entity, _parent);
+		}
+
+		U32* componentTick(EntityHandle _handle, ComponentType _type)
+		{
+			const EntityRef& er = m_entities[_handle.idx];
+			if (!er.m_mask.test(_type) )
+			{
+				return NULL;
+			}
+
+			const ComponentTypeRef& ct = m_componentTypes[_type.idx];
+			if (!ct.m_registered)
+			{
+				const U16 idx = m_componentHashMap.find(componentKey(_handle, _type) );
+				return kInvalidHandle != idx ? &m_components[idx].m_tick : NULL;
+			}
+
+			if (ComponentStorage::Sparse == ct.m_storage)
+			{
+				ComponentPoolBase& pool = m_componentPools[_type.idx];
+				return &pool.m_ticks[pool.m_sparse[_handle.idx] ];
+			}
+
+			return archetypeGetTick(m_archetypes[er.m_archetype], er.m_row, _type.idx);
+		}
+
+		MARA_API_FUNC(U32 getComponentTick(EntityHandle _handle, ComponentType _type))
+		{
+			const U32* tick = componentTick(_handle, _type);
+			return NULL != tick ? *tick : 0;
+		}
+
+		MARA_API_FUNC(void* getComponentDataMut(EntityHandle _handle, ComponentType _type))
+		{
+			U32* tick = componentTick(_handle, _type);
+			if (NULL == tick)
+			{
+				return NULL;
+			}
+
+			*tick = m_frame;
+			return getComponentData(_handle, _type);
+		}
+
+		MARA_API_FUNC(void* getComponentData(EntityHandle _handle, ComponentType _type))
+		{
+			const U32 typeIdx = _type.idx;
+			const ComponentTypeRef& ct = m_componentTypes[typeIdx];
+			if (ct.m_registered
+			&&  ComponentStorage::Sparse == ct.m_storage)
+			{
+				return m_componentPools[typeIdx].get(_handle);
+			}
+
+			if (ct.m_registered)
+			{
+				const EntityRef& er = m_entities[_handle.idx];
+				if (kInvalidHandle == er.m_archetype)
+				{
+					return NULL;
+				}
+
+				const ArchetypeRef& ar = m_archetypes[er.m_archetype];
+				const U32 offset = ar.m_offsets[typeIdx];
+				if (UINT32_MAX == offset)
+				{
+					return NULL;
+				}
+
+				return archetypeGetData(ar, er.m_row, offset, ct.m_size);
+			}
+
+			const U16 idx = m_componentHashMap.find(componentKey(_handle, _type) );
+			if (idx != kInvalidHandle)
+			{
+				void* data = m_components[idx].m_data;
+				if (NULL != data)
+				{
+					return data;
+				}
+
+				BASE_ASSERT(true, "Component data is NULL but entity contains component type")
+				return NULL;
+			}
+
+			BASE_ASSERT(true, "Component handle is invalid")
+			return NULL;
+		}
+
+		bool queryFilterMatch(EntityHandle _handle, const ComponentMask& _changed, U32 _changedSince)
+		{
+			if (0 == _changedSince)
+			{
+				return true;
+			}
+
+			// Visit only set bits of change mask.
+			for (U32 ww = 0; ww < ComponentMask::kNumWords; ++ww)
+			{
+				for (U64 bits = _changed.m_bits[ww]; 0 != bits; bits &= bits - 1)
+				{
+					const ComponentType type = { U16(ww * 64 + base::uint64_cnttz(bits) ) };
+					const U32* tick = componentTick(_handle, type);
+					if (NULL != tick
+					&&  *tick >= _changedSince)
+					{
+						return true;
+					}
+				}
+			}
+
+			return false;
+		}
+
+		bool queryEntityMatch(EntityHandle _handle, const ComponentMask& _types, const QueryFilter& _filter, const ComponentMask& _changed)
+		{
+			// Signature tests first, change ticks are only read for entities passing them.
+			const EntityRef& er = m_entities[_handle.idx];
+			return 0 != er.m_refCount
+				&&  maskContains(er.m_mask, _types)
+				&& !maskIntersects(er.m_mask, _filter.m_exclude)
+				&& (_filter.m_any.isEmpty() || maskIntersects(er.m_mask, _filter.m_any) )
+				&&  queryFilterMatch(_handle, _changed, _filter.m_changedSince)
+				;
+		}
+
+		MARA_API_FUNC(EntityQuery* queryEntities(const ComponentMask& _types, const QueryFilter& _filter))
+		{
+			const U16 numHandles = m_entityHandle.getNumHandles();
+			const ComponentMask& changed = _filter.m_changed.isEmpty() ? _types : _filter.m_changed;
+
+			U32 count = 0;
+			for (U16 ii = 0; ii < numHandles; ++ii)
+			{
+				const EntityHandle handle = { m_entityHandle.getHandleAt(ii) };
+				count += queryEntityMatch(handle, _types, _filter, changed);
+			}
+
+			U32 numOptional = 0;
+			for (U32 ww = 0; ww < ComponentMask::kNumWords; ++ww)
+			{
+				numOptional += base::uint64_cntbits(_filter.m_optional.m_bits[ww]);
+			}
+
+			// Result is sized to match count, and lives in frame memory until next update.
+			EntityQuery* query = (EntityQuery*)base::alloc(getFrameAllocator()
+				, sizeof(EntityQuery)
+				+ numOptional * count * sizeof(void*)
+				+ count * sizeof(EntityHandle)
+				);
+			query->m_count = 0;
+			query->m_numOptional = numOptional;
+			query->m_optional = (void**)&query[1];
+			query->m_entities = (EntityHandle*)&query->m_optional[numOptional * count];
+
+			for (U16 ii = 0; ii < numHandles && query->m_count < count; ++ii)
+			{
+				const EntityHandle handle = { m_entityHandle.getHandleAt(ii) };
+				if (!queryEntityMatch(handle, _types, _filter, changed) )
+				{
+					continue;
+				}
+
+				// Optional data is resolved only for types present in entity signature.
+				const ComponentMask& mask = m_entities[handle.idx].m_mask;
+				U32 optional = 0;
+				for (U32 ww = 0; ww < ComponentMask::kNumWords; ++ww)
+				{
+					for (U64 bits = _filter.m_optional.m_bits[ww]; 0 != bits; bits &= bits - 1, ++optional)
+					{
+						const ComponentType type = { U16(ww * 64 + base::uint64_cnttz(bits) ) };
+						query->m_optional[optional * count + query->m_count] = mask.test(type)
+							? getComponentData(handle, type)
+							: NULL
+							;
+					}
+				}
+
+				query->m_entities[query->m_count] = handle;
+				query->m_count++;
+			}
+
+			return query;
+		}
+
+		struct BoxTest
+		{
+			bool operator()(const base::Aabb& _aabb) const
+			{
+				return boundsOverlap(_aabb, m_box);
+			}
 
-			// Give information about each loaded resource
-			for (U32 i = 0; i < MARA_CONFIG_MAX_RESOURCES; i++)
+			base::Aabb m_box;
+		};
+
+		struct SphereTest
+		{
+			bool operator()(const base::Aabb& _aabb) const
+			{
+				return boundsOverlap(_aabb, m_sphere);
+			}
+
+			base::Sphere m_sphere;
+		};
+
+		struct FrustumTest
+		{
+			bool operator()(const base::Aabb& _aabb) const
+			{
+				return boundsOverlap(_aabb, m_planes, m_num);
+			}
+
+			const base::Plane* m_planes;
+			U32 m_num;
+		};
+
+		template<typename TestT>
+		EntityQuery* queryBounds(const TestT& _test)
+		{
+			// Tree is walked twice so result is sized to match count, like `queryEntities`.
+			const U32 count = m_boundsTree.query(_test, NULL, 0);
+
+			EntityQuery* query = (EntityQuery*)base::alloc(getFrameAllocator(), sizeof(EntityQuery) + count * sizeof(EntityHandle));
+			query->m_entities = (EntityHandle*)&query[1];
+			query->m_count = m_boundsTree.query(_test, query->m_entities, count);
+			query->m_numOptional = 0;
+			query->m_optional = NULL;
+
+			return query;
+		}
+
+		MARA_API_FUNC(void setEntityBounds(EntityHandle _entity, const base::Aabb& _aabb))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			if (!isValid(_entity) )
+			{
+				BASE_WARN(false, "Passing invalid entity handle to mara::setEntityBounds.");
+				return;
+			}
+
+			m_boundsTree.set(_entity, _aabb);
+		}
+
+		MARA_API_FUNC(void removeEntityBounds(EntityHandle _entity))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			m_boundsTree.remove(_entity);
+		}
+
+		MARA_API_FUNC(EntityQuery* queryBox(const base::Aabb& _aabb))
+		{
+			BoxTest test;
+			test.m_box = _aabb;
+			return queryBounds(test);
+		}
+
+		MARA_API_FUNC(EntityQuery* querySphere(const base::Sphere& _sphere))
+		{
+			SphereTest test;
+			test.m_sphere = _sphere;
+			return queryBounds(test);
+		}
+
+		MARA_API_FUNC(EntityQuery* queryFrustum(const base::Plane* _planes, U32 _num))
+		{
+			FrustumTest test;
+			test.m_planes = _planes;
+			test.m_num = _num;
+			return queryBounds(test);
+		}
+
+		static bool queryMatch(const QueryRef& _qr, const ComponentMask& _mask)
+		{
+			return  maskContains(_mask, _qr.m_include)
+				&& !maskIntersects(_mask, _qr.m_exclude)
+				;
+		}
+
+		void queryInsert(QueryRef& _qr, EntityHandle _entity)
+		{
+			if (_qr.m_num == _qr.m_capacity)
+			{
+				_qr.m_capacity = base::max<U32>(_qr.m_capacity * 2, 64);
+				_qr.m_entities = (EntityHandle*)base::realloc(entry::getAllocator(), _qr.m_entities, _qr.m_capacity * sizeof(EntityHandle) );
+			}
+
+			if (_entity.idx >= _qr.m_indicesSize)
+			{
+				_qr.m_indicesSize = base::max<U32>(base::max<U32>(_qr.m_indicesSize * 2, 64), _entity.idx + 1);
+				_qr.m_indices = (U16*)base::realloc(entry::getAllocator(), _qr.m_indices, _qr.m_indicesSize * sizeof(U16) );
+			}
+
+			_qr.m_indices[_entity.idx] = U16(_qr.m_num);
+			_qr.m_entities[_qr.m_num++] = _entity;
+		}
+
+		void queryRemove(QueryRef& _qr, EntityHandle _entity)
+		{
+			const U16 index = _qr.m_indices[_entity.idx];
+			const EntityHandle last = _qr.m_entities[--_qr.m_num];
+			_qr.m_entities[index] = last;
+			_qr.m_indices[last.idx] = index;
+		}
+
+		void queryUpdateEntity(EntityHandle _entity, const ComponentMask& _oldMask, const ComponentMask& _newMask)
+		{
+			// Observers see same signature changes as queries.
+			m_observers.record(_entity, _oldMask, _newMask);
+
+			for (U16 ii = 0, num = m_queryHandle.getNumHandles(); ii < num; ++ii)
+			{
+				QueryRef& qr = m_queries[m_queryHandle.getHandleAt(ii)];
+				if (0 == qr.m_refCount)
+				{
+					continue;
+				}
+
+				const bool was = queryMatch(qr, _oldMask);
+				const bool is  = queryMatch(qr, _newMask);
+				if (was != is)
+				{
+					if (is)
+					{
+						queryInsert(qr, _entity);
+					}
+					else
+					{
+						queryRemove(qr, _entity);
+					}
+				}
+			}
+		}
+
+		void queryIncRef(QueryHandle _handle)
+		{
+			QueryRef& qr = m_queries[_handle.idx];
+			++qr.m_refCount;
+		}
+
+		void queryDecRef(QueryHandle _handle)
+		{
+			QueryRef& qr = m_queries[_handle.idx];
+			U16 refs = --qr.m_refCount;
+
+			if (0 == refs)
+			{
+				bool ok = m_freeQueries.queue(_handle); BASE_UNUSED(ok);
+				BASE_ASSERT(ok, "Query handle %d is already destroyed!", _handle.idx);
+
+				queryRelease(qr);
+			}
+		}
+
+		void queryRelease(QueryRef& _qr)
+		{
+			base::free(entry::getAllocator(), _qr.m_entities);
+			base::free(entry::getAllocator(), _qr.m_indices);
+
+			_qr.m_entities = NULL;
+			_qr.m_indices = NULL;
+			_qr.m_num = 0;
+			_qr.m_capacity = 0;
+			_qr.m_indicesSize = 0;
+		}
+
+		void destroyQueries()
+		{
+			for (U16 ii = 0, num = m_queryHandle.getNumHandles(); ii < num; ++ii)
+			{
+				queryRelease(m_queries[m_queryHandle.getHandleAt(ii)]);
+			}
+
+			m_queryHandle.reset();
+		}
+
+		MARA_API_FUNC(QueryHandle createQuery(const ComponentMask& _include, const ComponentMask& _exclude))
+		{
+			BASE_ASSERT(!_include.isEmpty(), "Query must include at least one component type.");
+
+			QueryHandle handle = { allocHandle(m_queryHandle, m_queries) };
+
+			if (isValid(handle))
+			{
+				QueryRef& qr = m_queries[handle.idx];
+				qr.m_include = _include;
+				qr.m_exclude = _exclude;
+				qr.m_num = 0;
+				qr.m_refCount = 1;
+
+				// Only scan once, after this the query is kept up to date by structural changes.
+				for (U16 ii = 0, num = m_entityHandle.getNumHandles(); ii < num; ++ii)
+				{
+					EntityHandle entity = { m_entityHandle.getHandleAt(ii) };
+
+					const EntityRef& er = m_entities[entity.idx];
+					if (0 != er.m_refCount
+					&&  queryMatch(qr, er.m_mask))
+					{
+						queryInsert(qr, entity);
+					}
+				}
+
+				return handle;
+			}
+
+			BASE_TRACE("Failed to create query handle.");
+			return MARA_INVALID_HANDLE;
+		}
+
+		MARA_API_FUNC(void destroyQuery(QueryHandle _handle))
+		{
+			if (!isValid(_handle)
+			||  !m_queryHandle.isValid(_handle.idx)
+			||  0 == m_queries[_handle.idx].m_refCount)
+			{
+				BASE_WARN(false, "Passing invalid query handle to mara::destroyQuery.");
+				return;
+			}
+
+			queryDecRef(_handle);
+		}
+
+		MARA_API_FUNC(U32 getNumEntities(QueryHandle _handle))
+		{
+			const QueryRef& qr = m_queries[_handle.idx];
+			return qr.m_num;
+		}
+
+		MARA_API_FUNC(const EntityHandle* getEntities(QueryHandle _handle))
+		{
+			const QueryRef& qr = m_queries[_handle.idx];
+			return qr.m_entities;
+		}
+
+		void entityIncRef(EntityHandle _handle)
+		{
+			EntityRef& sr = m_entities[_handle.idx];
+			++sr.m_refCount;
+		}
+
+		/// Returns true if `_handle` refers to entity that wasn't destroyed. Handles
+		/// of destroyed entities are only freed in next update, until then their
+		/// reference count is zero.
+		bool entityIsAlive(EntityHandle _handle) const
+		{
+			return isValid(_handle)
+				&& _handle.idx < MARA_CONFIG_MAX_ENTITIES
+				&& m_entities.isCommitted(_handle.idx)
+				&& 0 != m_entities[_handle.idx].m_refCount
+				;
+		}
+
+		void entityDecRef(EntityHandle _handle)
+		{
+			EntityRef& sr = m_entities[_handle.idx];
+			U16 refs = --sr.m_refCount;
+
+			if (0 == refs)
+			{
+				bool ok = m_freeEntities.queue(_handle); BASE_UNUSED(ok);
+				BASE_ASSERT(ok, "Entity handle %d is already destroyed!", _handle.idx);
+
+				sr.m_mask.clear();
+			}
+		}
+
+		MARA_API_FUNC(SystemHandle registerSystem(const char* _name, SystemFn _fn, const ComponentMask& _read, const ComponentMask& _write, void* _userData))
+		{
+			return m_scheduler.registerSystem(_name, _fn, _read, _write, _userData);
+		}
+
+		MARA_API_FUNC(ObserverHandle registerObserver(ComponentType _type, ObserverFn _fn, void* _userData))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			return m_observers.registerObserver(_type, _fn, _userData);
+		}
+
+		MARA_API_FUNC(void destroyObserver(ObserverHandle _handle))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			if (!isValid(_handle) || !m_observers.m_observerHandle.isValid(_handle.idx))
+			{
+				BASE_WARN(false, "Passing invalid observer handle to mara::destroyObserver.");
+				return;
+			}
+
+			m_observers.destroyObserver(_handle);
+		}
+
+		MARA_API_FUNC(void destroySystem(SystemHandle _handle))
+		{
+			if (!isValid(_handle) || !m_scheduler.m_systemHandle.isValid(_handle.idx))
+			{
+				BASE_WARN(false, "Passing invalid system handle to mara::destroySystem.");
+				return;
+			}
+
+			m_scheduler.destroySystem(_handle);
+		}
+
+		MARA_API_FUNC(EntityHandle createEntity())
+		{
+			EntityHandle handle = { allocHandle(m_entityHandle, m_entities) };
+
+			if (isValid(handle))
+			{
+				EntityRef& sr = m_entities[handle.idx];
+				sr.m_refCount = 1;
+
+				return handle;
+			}
+
+			BASE_TRACE("Failed to create entity handle.");
+			return MARA_INVALID_HANDLE;
+		}
+
+		MARA_API_FUNC(U32 createEntities(U32 _num, const ComponentMask& _types, EntityHandle* _outHandles))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			return entitiesCreate(_num, _types, _outHandles, NULL);
+		}
+
+		U32 entitiesCreate(U32 _num, const ComponentMask& _types, EntityHandle* _outHandles, const PrefabTemplate* _template)
+		{
+			// Archetype is resolved before any handle is taken, running out of archetypes
+			// leaves nothing to undo.
+			ComponentMask tableMask;
+			for (U16 ii = 0; ii < MARA_CONFIG_MAX_COMPONENT_TYPES; ++ii)
+			{
+				const ComponentType type = { ii };
+				if (_types.test(type)
+				&&  ComponentStorage::Sparse != m_componentTypes[ii].m_storage)
+				{
+					tableMask.set(type);
+				}
+			}
+
+			U16 archetype = kInvalidHandle;
+			if (!tableMask.isEmpty() )
+			{
+				archetype = archetypeFindOrCreate(tableMask);
+				if (kInvalidHandle == archetype)
+				{
+					BASE_TRACE("Failed to create entities, out of archetypes.");
+					return 0;
+				}
+			}
+
+			U32 num = 0;
+			for (; num < _num; ++num)
+			{
+				EntityHandle handle = { allocHandle(m_entityHandle, m_entities) };
+				if (!isValid(handle))
+				{
+					BASE_TRACE("Failed to create entity handle, created %d of %d entities.", num, _num);
+					break;
+				}
+
+				EntityRef& er = m_entities[handle.idx];
+				er.m_refCount = 1;
+				er.m_mask = _types;
+				_outHandles[num] = handle;
+			}
+
+			if (0 == num
+			||  _types.isEmpty() )
+			{
+				return num;
+			}
+
+			// All entities share signature, each component type and query is visited once per batch.
+			for (U16 ii = 0; ii < MARA_CONFIG_MAX_COMPONENT_TYPES; ++ii)
+			{
+				const ComponentType type = { ii };
+				if (!_types.test(type) )
+				{
+					continue;
+				}
+
+				const ComponentTypeRef& ct = m_componentTypes[ii];
+				BASE_ASSERT(ct.m_registered, "Component type must be registered before creating entities with it.");
+				BASE_ASSERT(ComponentStorage::Singleton != ct.m_storage, "Singleton components can't be added to entities.");
+
+				if (ComponentStorage::Sparse == ct.m_storage)
+				{
+					ComponentPoolBase& pool = m_componentPools[ii];
+					const U32 offset = NULL != _template ? _template->m_offsets[ii] : UINT32_MAX;
+					for (U32 jj = 0; jj < num; ++jj)
+					{
+						void* data = pool.insert(_outHandles[jj]);
+						if (UINT32_MAX != offset)
+						{
+							base::memCopy(data, &_template->m_data[offset], ct.m_size);
+						}
+						else
+						{
+							base::memSet(data, 0, ct.m_size);
+						}
+
+						pool.setTick(_outHandles[jj], m_frame);
+					}
+				}
+			}
+
+			if (kInvalidHandle != archetype)
+			{
+				archetypeAllocRows(archetype, _outHandles, num, _template);
+			}
+
+			m_observers.recordCreated(_outHandles, num, _types);
+
+			for (U16 ii = 0, numQueries = m_queryHandle.getNumHandles(); ii < numQueries; ++ii)
+			{
+				QueryRef& qr = m_queries[m_queryHandle.getHandleAt(ii)];
+				if (0 != qr.m_refCount
+				&&  queryMatch(qr, _types) )
+				{
+					for (U32 jj = 0; jj < num; ++jj)
+					{
+						queryInsert(qr, _outHandles[jj]);
+					}
+				}
+			}
+
+			return num;
+		}
+
+		MARA_API_FUNC(void destroyEntities(const EntityHandle* _handles, U32 _num))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			// Batch can list same entity more than once, or entity destroyed before. Each live
+			// entity is destroyed once, rest of batch works only on filtered handles.
+			const U32 numWords = (MARA_CONFIG_MAX_ENTITIES + 31) / 32;
+			U32* seen = (U32*)base::alloc(getFrameAllocator(), numWords * sizeof(U32) );
+			base::memSet(seen, 0, numWords * sizeof(U32) );
+
+			EntityHandle* handles = (EntityHandle*)base::alloc(getFrameAllocator(), base::max<U32>(_num, 1) * sizeof(EntityHandle) );
+			U32 num = 0;
+
+			ComponentMask types;
+			for (U32 ii = 0; ii < _num; ++ii)
 			{
-				if (m_resources[i].vfp.isEmpty())
+				const EntityHandle handle = _handles[ii];
+				if (!entityIsAlive(handle)
+				||  0 != (seen[handle.idx / 32] & (1u << (handle.idx % 32) ) ) )
 				{
-					break;
+					BASE_WARN(false, "Passing invalid or already destroyed entity handle to mara::destroyEntities.");
+					continue;
 				}
 
-				_outInfoList[i].vfp = m_resources[i].vfp;
-				_outInfoList[i].refCount = m_resources[i].m_refCount;
-				count++;
+				seen[handle.idx / 32] |= 1u << (handle.idx % 32);
+				handles[num++] = handle;
+
+				EntityRef& er = m_entities[handle.idx];
+				types |= er.m_mask;
+
+				queryUpdateEntity(handle, er.m_mask, ComponentMask() );
+				m_transforms.remove(handle);
+				m_boundsTree.remove(handle);
+
+				if (kInvalidHandle != er.m_archetype)
+				{
+					archetypeDestroyRow(m_archetypes[er.m_archetype], er.m_row);
+					archetypeRemoveRow(m_archetypes[er.m_archetype], er.m_row);
+					er.m_archetype = kInvalidHandle;
+				}
 			}
 
-			// Simple bouble sort
-			if (_sort && count > 1)
+			// Visit each non table component type once for whole batch.
+			for (U16 ii = 0; ii < MARA_CONFIG_MAX_COMPONENT_TYPES; ++ii)
 			{
-				for (U32 i = 0; i < count - 1; i++)
+				const ComponentType type = { ii };
+				if (!types.test(type) )
 				{
-					for (U32 j = 0; j < count - i - 1; j++)
+					continue;
+				}
+
+				const ComponentTypeRef& ct = m_componentTypes[ii];
+				if (ct.m_registered
+				&&  ComponentStorage::Table == ct.m_storage)
+				{
+					continue;
+				}
+
+				for (U32 jj = 0; jj < num; ++jj)
+				{
+					const EntityHandle handle = handles[jj];
+					if (!m_entities[handle.idx].m_mask.test(type) )
 					{
-						if (base::strCmp(_outInfoList[j].vfp.getCPtr(), _outInfoList[j + 1].vfp.getCPtr()) > 0)
-						{
-							ResourceInfo temp = _outInfoList[j];
-							_outInfoList[j] = _outInfoList[j + 1];
-							_outInfoList[j + 1] = temp;
-						}
+						continue;
+					}
+
+					if (ct.m_registered)
+					{
+						m_componentPools[ii].remove(handle);
+						continue;
+					}
+
+					const U32 key = componentKey(handle, type);
+					const U16 idx = m_componentHashMap.find(key);
+					if (kInvalidHandle != idx)
+					{
+						destroyComponent({ idx });
+						m_componentHashMap.removeByKey(key);
 					}
 				}
 			}
 
-			return count;
+			for (U32 ii = 0; ii < num; ++ii)
+			{
+				m_entities[handles[ii].idx].m_mask.clear();
+				entityDecRef(handles[ii]);
+			}
 		}
 
-		void componentIncRef(ComponentHandle _handle)
+		/// Returns frame allocator of calling worker thread.
+		FrameAllocator* getFrameAllocator()
 		{
-			ComponentRef& sr = m_components[_handle.idx];
-			++sr.m_refCount;
+			const U32 worker = JobSystem::getWorkerIndex();
+			BASE_ASSERT(worker < m_jobSystem.getNumWorkers(), "Frame memory can only be allocated from worker threads.");
+
+			return &m_frameAllocators[worker];
 		}
 
-		void componentDecRef(ComponentHandle _handle)
+		MARA_API_FUNC(EntityCommandBuffer* getCommandBuffer())
 		{
-			ComponentRef& sr = m_components[_handle.idx];
-			U16 refs = --sr.m_refCount;
-
-			if (0 == refs)
-			{
-				bool ok = m_freeComponents.queue(_handle); BASE_UNUSED(ok);
-				BASE_ASSERT(ok, "Component handle %d is already destroyed!", _handle.idx);
+			const U32 worker = JobSystem::getWorkerIndex();
+			BASE_ASSERT(worker < m_jobSystem.getNumWorkers(), "Command buffers can only be used from worker threads.");
 
-				// @todo We are using delete because we are using virtual destructors. Can we do this manually?
-				delete sr.m_data; 
-				sr.m_data = NULL;
-			}
+			return &m_commandBuffers[worker];
 		}
 
-		MARA_API_FUNC(ComponentHandle createComponent(ComponentI* _data))
+		MARA_API_FUNC(void setSortKey(EntityCommandBuffer* _ecb, U32 _sortKey))
 		{
-			ComponentHandle handle = { m_componentHandle.alloc() };
-
-			if (isValid(handle))
-			{
-				ComponentRef& sr = m_components[handle.idx];
-				sr.m_refCount = 1;
+			_ecb->m_sortKey = _sortKey;
+		}
 
-				sr.m_data = _data;
-				
-				return handle;
-			}
+		MARA_API_FUNC(EntityHandle createEntity(EntityCommandBuffer* _ecb))
+		{
+			return _ecb->createEntity();
+		}
 
-			BASE_TRACE("Failed to create component handle.");
-			return MARA_INVALID_HANDLE;
+		MARA_API_FUNC(void destroyEntity(EntityCommandBuffer* _ecb, EntityHandle _handle))
+		{
+			_ecb->record(EntityCommandBuffer::Command::DestroyEntity, _handle, { 0 }, 0);
 		}
 
-		MARA_API_FUNC(void destroyComponent(ComponentHandle _handle))
+		MARA_API_FUNC(void addComponent(EntityCommandBuffer* _ecb, EntityHandle _entity, ComponentType _type, const void* _data))
 		{
-			MARA_MUTEX_SCOPE(m_resourceApiLock);
+			const ComponentTypeRef& ct = m_componentTypes[_type.idx];
+			BASE_ASSERT(ct.m_registered, "Component type must be registered before adding it by value.");
+			BASE_ASSERT(ComponentStorage::Singleton != ct.m_storage, "Singleton components can't be added to entities.");
 
-			if (!isValid(_handle) && !m_componentHandle.isValid(_handle.idx))
+			void* data = _ecb->record(EntityCommandBuffer::Command::AddComponent, _entity, _type, ct.m_size);
+			if (NULL != _data)
 			{
-				BASE_WARN(false, "Passing invalid component handle to mara::destroyComponent.");
-				return;
+				base::memCopy(data, _data, ct.m_size);
+			}
+			else
+			{
+				base::memSet(data, 0, ct.m_size);
 			}
-
-			componentDecRef(_handle);
 		}
 
-		MARA_API_FUNC(void addComponent(EntityHandle _entity, U32 _type, ComponentHandle _component))
+		MARA_API_FUNC(void removeComponent(EntityCommandBuffer* _ecb, EntityHandle _entity, ComponentType _type))
 		{
-			bool ok = m_componentHashMap[_type].insert(_entity.idx, _component.idx);
-			BASE_ASSERT(ok, "Entities cannot have duplicated components!", _entity.idx);
-
-			m_entityHashMap[_type].insert(m_entityHashMap[_type].getNumElements(), _entity.idx);
-
-			EntityRef& sr = m_entities[_entity.idx];
-			sr.m_mask |= _type;
+			_ecb->record(EntityCommandBuffer::Command::RemoveComponent, _entity, _type, 0);
 		}
 
-		bool hasComponent(EntityHandle _handle, U32 _type)
+		void playbackCommandBuffers()
 		{
-			const U16 idx = m_componentHashMap[_type].find(_handle.idx);
-			return idx != kInvalidHandle;
-		}
+			typedef EntityCommandBuffer::Header Header;
 
-		MARA_API_FUNC(void* getComponentData(EntityHandle _handle, U32 _type))
-		{
-			const U16 idx = m_componentHashMap[_type].find(_handle.idx);
-			if (idx != kInvalidHandle)
+			const U32 numBuffers = m_jobSystem.getNumWorkers();
+
+			U32 num = 0;
+			for (U32 ii = 0; ii < numBuffers; ++ii)
 			{
-				void* data = m_components[idx].m_data;
-				if (NULL != data)
-				{
-					return data;
-				}
+				num += m_commandBuffers[ii].m_numCommands;
+			}
 
-				BASE_ASSERT(true, "Component data is NULL but entity contains component type")
-				return NULL;
+			if (0 == num)
+			{
+				return;
 			}
 
-			BASE_ASSERT(true, "Component handle is invalid")
-			return NULL;
-		}
+			// Commands are merged with stable sort on sort key. Commands with same key keep order of
+			// worker buffers, which depends on scheduling, see mara::setSortKey.
+			U32* keys = (U32*)base::alloc(getFrameAllocator(), num * sizeof(U32) * 2);
+			const Header** values = (const Header**)base::alloc(getFrameAllocator(), num * sizeof(Header*) * 2);
 
-		MARA_API_FUNC(EntityQuery* queryEntities(U32 _types))
-		{
-			// @todo What if- instead of allocating an entity query here, we have a global entity query we change instead. 
-			// Then we can allocate and deallocate that ourself without leaving that respnsibility to the user.
-			EntityQuery* query = (EntityQuery*)base::alloc(entry::getAllocator(), sizeof(EntityQuery));
-			query->m_count = 0;
+			EntityHandle* created[MARA_CONFIG_MAX_WORKERS];
 
-			for (U32 i = 0; i < 32; ++i)
+			U32 count = 0;
+			for (U32 ii = 0; ii < numBuffers; ++ii)
 			{
-				for (U16 j = 0; j < m_componentHashMap[i].getNumElements(); j++) // @todo We are looping over the same entity multiple times
+				const EntityCommandBuffer& ecb = m_commandBuffers[ii];
+				created[ii] = (EntityHandle*)base::alloc(getFrameAllocator(), (ecb.m_numCreated + 1) * sizeof(EntityHandle) );
+
+				for (U32 offset = 0; offset < ecb.m_size;)
 				{
-					EntityHandle handle = { m_entityHashMap[i].find(j) };
-					if (!isValid(handle))
-					{
-						continue;
-					}
+					const Header* header = (const Header*)&ecb.m_data[offset];
+					keys[count] = header->m_sortKey;
+					values[count] = header;
+					++count;
 
-					EntityRef& sr = m_entities[handle.idx];
-					if ((sr.m_mask & _types) == _types)
-					{
-						query->m_entities[query->m_count] = handle;
-						query->m_count++;
-					}
+					offset += sizeof(Header) + ( (header->m_size + 15) & ~15u);
 				}
 			}
 
-			return query;
-		}
+			base::radixSort(keys, &keys[num], values, &values[num], num);
 
-		void entityIncRef(EntityHandle _handle)
-		{
-			EntityRef& sr = m_entities[_handle.idx];
-			++sr.m_refCount;
-		}
+			// Entities are created first, commands can reference placeholders regardless of sort key.
+			for (U32 ii = 0; ii < num; ++ii)
+			{
+				const Header& header = *values[ii];
+				if (EntityCommandBuffer::Command::CreateEntity == header.m_command)
+				{
+					created[header.m_buffer][header.m_entity.idx & ~kPlaceholderEntityBit] = createEntity();
+				}
+			}
 
-		void entityDecRef(EntityHandle _handle)
-		{
-			EntityRef& sr = m_entities[_handle.idx];
-			U16 refs = --sr.m_refCount;
+			U32* destroyed = NULL;
 
-			if (0 == refs)
+			for (U32 ii = 0; ii < num; ++ii)
 			{
-				bool ok = m_freeEntities.queue(_handle); BASE_UNUSED(ok);
-				BASE_ASSERT(ok, "Entity handle %d is already destroyed!", _handle.idx);
+				const Header& header = *values[ii];
 
-				sr.m_mask = 0;
-			}
-		}
+				EntityHandle entity = header.m_entity;
+				if (isValid(entity)
+				&&  0 != (entity.idx & kPlaceholderEntityBit) )
+				{
+					entity = created[header.m_buffer][entity.idx & ~kPlaceholderEntityBit];
+				}
 
-		MARA_API_FUNC(EntityHandle createEntity())
-		{
-			EntityHandle handle = { m_entityHandle.alloc() };
+				// Commands of several workers can target same entity, skip ones recorded for entity
+				// destroyed before, or earlier in this playback.
+				if (!entityIsAlive(entity)
+				||  (NULL != destroyed && 0 != (destroyed[entity.idx / 32] & (1u << (entity.idx % 32) ) ) ) )
+				{
+					continue;
+				}
 
-			if (isValid(handle))
-			{
-				EntityRef& sr = m_entities[handle.idx];
-				sr.m_refCount = 1;
+				const ComponentType type = { header.m_type };
+				switch (header.m_command)
+				{
+				case EntityCommandBuffer::Command::DestroyEntity:
+					if (NULL == destroyed)
+					{
+						destroyed = (U32*)base::alloc(getFrameAllocator(), (MARA_CONFIG_MAX_ENTITIES + 31) / 32 * sizeof(U32) );
+						base::memSet(destroyed, 0, (MARA_CONFIG_MAX_ENTITIES + 31) / 32 * sizeof(U32) );
+					}
 
-				return handle;
+					destroyed[entity.idx / 32] |= 1u << (entity.idx % 32);
+					destroyEntity(entity);
+					break;
+
+				case EntityCommandBuffer::Command::AddComponent:
+					// Entity can already have component, from earlier command or before playback,
+					// then payload overwrites it and last command in sort order wins.
+					if (m_entities[entity.idx].m_mask.test(type) )
+					{
+						base::memCopy(getComponentDataMut(entity, type), &values[ii][1], m_componentTypes[type.idx].m_size);
+					}
+					else
+					{
+						addComponent(entity, type, &values[ii][1]);
+					}
+					break;
+
+				case EntityCommandBuffer::Command::RemoveComponent:
+					removeComponent(entity, type);
+					break;
+
+				default:
+					break;
+				}
 			}
 
-			BASE_TRACE("Failed to create entity handle.");
-			return MARA_INVALID_HANDLE;
+			for (U32 ii = 0; ii < numBuffers; ++ii)
+			{
+				m_commandBuffers[ii].reset();
+			}
 		}
 
 		MARA_API_FUNC(void destroyEntity(EntityHandle _handle))
 		{
 			MARA_MUTEX_SCOPE(m_resourceApiLock);
 
-			if (!isValid(_handle))
+			if (!entityIsAlive(_handle) )
 			{
 				BASE_WARN(false, "Passing invalid entity handle to mara::destroyEntity.");
 				return;
 			}
 
 			EntityRef& sr = m_entities[_handle.idx]; // @todo make destroying components optional maybe
+
+			queryUpdateEntity(_handle, sr.m_mask, ComponentMask() );
+			m_transforms.remove(_handle);
+			m_boundsTree.remove(_handle);
+
+			// Table components are released together with the entity archetype row.
+			if (kInvalidHandle != sr.m_archetype)
+			{
+				archetypeDestroyRow(m_archetypes[sr.m_archetype], sr.m_row);
+				archetypeRemoveRow(m_archetypes[sr.m_archetype], sr.m_row);
+				sr.m_archetype = kInvalidHandle;
+			}
 			
 			// Loop over all bit mask components
-			for (U32 i = 0; i < 32; i++)
+			for (U16 i = 0; i < MARA_CONFIG_MAX_COMPONENT_TYPES; i++)
 			{
-				// If entity got that component find it in the component hash map and get the component reference id
-				if (sr.m_mask & (1 << i))
+				const ComponentType type = { i };
+				if (!sr.m_mask.test(type) )
 				{
-					const U16 idx = m_componentHashMap[1 << i].find(_handle.idx);
-					if (kInvalidHandle != idx)
+					continue;
+				}
+
+				if (m_componentTypes[i].m_registered)
+				{
+					if (ComponentStorage::Sparse == m_componentTypes[i].m_storage)
 					{
-						// Destroy component
-						destroyComponent({ idx });
-						m_componentHashMap[1 << i].removeByKey(_handle.idx);
-						m_entityHashMap[1 << i].removeByHandle(i);
+						m_componentPools[i].remove(_handle);
 					}
+
+					continue;
+				}
+
+				// If entity got that component find it in the component hash map and get the component reference id
+				const U32 key = componentKey(_handle, type);
+				const U16 idx = m_componentHashMap.find(key);
+				if (kInvalidHandle != idx)
+				{
+					// Destroy component
+					destroyComponent({ idx });
+					m_componentHashMap.removeByKey(key);
 				}
 			}
 
+			// Entity has no components anymore, even if references keep it alive.
+			sr.m_mask.clear();
+
 			entityDecRef(_handle);
 		}
 
@@ -1054,7 +3632,7 @@ namespace mara
 			}
 			else
 			{
-				_handle = { m_geometryHandle.alloc() };
+				_handle = { allocHandle(m_geometryHandle, m_geometries) };
 				return false;
 			}
 		}
@@ -1116,30 +3694,32 @@ namespace mara
 			ResourceHandle handle;
 			if (resourceFindOrCreate(hash, handle))
 			{
+				// Finish pending asynchronous load of same resource.
+				waitResource(handle);
 				return handle;
 			}
 
 			// Check if resource is inside a loaded  pack
-			U16 entryHandle = m_pakEntryHashMap.find(base::hash<base::HashMurmur2A>(_filePath.getCPtr()));
-			if (kInvalidHandle != entryHandle)
+			PakFile* pak;
+			const PakEntryRef* per = pakFind(hash, &pak);
+			if (NULL != per)
 			{
 				// Create resource
 				bool ok = m_resourceHashMap.insert(hash, handle.idx);
 				BASE_ASSERT(ok, "Resource already exists!"); BASE_UNUSED(ok);
 
-				// Get pak file reader
-				PakEntryRef& per = m_pakEntries[entryHandle];
-				base::FileReader* reader = &m_paks[m_pakHashMap.find(per.pakHash)];
-
-				// Seek to the offset of the entry using the entry file pointer.
-				base::seek(reader, per.offset, base::Whence::Begin);
+				// Get pak reader positioned at the offset of the entry.
+				PakReader reader(pak, 0);
+				bool opened = reader.open(*per, &m_jobSystem);
+				BASE_ASSERT(opened, "Failed to read pak entry of %s.", _filePath.getCPtr()); BASE_UNUSED(opened);
 
 				// Read resource data at offset position.
 				ResourceRef& rr = m_resources[handle.idx];
 				rr.m_refCount = 1;
 				rr.vfp = _filePath;
-				rr.resource = new GeometryResource();
-				rr.resource->read(reader, base::ErrorAssert{});
+				GeometryResource* resource = new GeometryResource();
+				resource->read(&reader, base::ErrorAssert{});
+				rr.resource = resource;
 
 				// Return now loaded resource.
 				return handle;
@@ -1200,7 +3780,7 @@ namespace mara
 			}
 			else
 			{
-				_handle = { m_shaderHandle.alloc() };
+				_handle = { allocHandle(m_shaderHandle, m_shaders) };
 				return false;
 			}
 		}
@@ -1259,30 +3839,32 @@ namespace mara
 			ResourceHandle handle;
 			if (resourceFindOrCreate(hash, handle))
 			{
+				// Finish pending asynchronous load of same resource.
+				waitResource(handle);
 				return handle;
 			}
 
 			// Check if resource is inside a loaded  pack
-			U16 entryHandle = m_pakEntryHashMap.find(base::hash<base::HashMurmur2A>(_filePath.getCPtr()));
-			if (kInvalidHandle != entryHandle)
+			PakFile* pak;
+			const PakEntryRef* per = pakFind(hash, &pak);
+			if (NULL != per)
 			{
 				// Create resource
 				bool ok = m_resourceHashMap.insert(hash, handle.idx);
 				BASE_ASSERT(ok, "Resource already exists!"); BASE_UNUSED(ok);
 
-				// Get pak file reader
-				PakEntryRef& per = m_pakEntries[entryHandle];
-				base::FileReader* reader = &m_paks[m_pakHashMap.find(per.pakHash)];
-
-				// Seek to the offset of the entry using the entry file pointer.
-				base::seek(reader, per.offset, base::Whence::Begin);
+				// Get pak reader positioned at the offset of the entry.
+				PakReader reader(pak, 0);
+				bool opened = reader.open(*per, &m_jobSystem);
+				BASE_ASSERT(opened, "Failed to read pak entry of %s.", _filePath.getCPtr()); BASE_UNUSED(opened);
 
 				// Read resource data at offset position.
 				ResourceRef& rr = m_resources[handle.idx];
 				rr.m_refCount = 1;
 				rr.vfp = _filePath;
-				rr.resource = new ShaderResource();
-				rr.resource->read(reader, base::ErrorAssert{});
+				ShaderResource* resource = new ShaderResource();
+				resource->read(&reader, base::ErrorAssert{});
+				rr.resource = resource;
 
 				// Return now loaded resource.
 				return handle;
@@ -1343,7 +3925,7 @@ namespace mara
 			}
 			else
 			{
-				_handle = { m_textureHandle.alloc() };
+				_handle = { allocHandle(m_textureHandle, m_textures) };
 				return false;
 			}
 		}
@@ -1415,30 +3997,32 @@ namespace mara
 			ResourceHandle handle;
 			if (resourceFindOrCreate(hash, handle))
 			{
+				// Finish pending asynchronous load of same resource.
+				waitResource(handle);
 				return handle;
 			}
 
 			// Check if resource is inside a loaded  pack
-			U16 entryHandle = m_pakEntryHashMap.find(base::hash<base::HashMurmur2A>(_filePath.getCPtr()));
-			if (kInvalidHandle != entryHandle)
+			PakFile* pak;
+			const PakEntryRef* per = pakFind(hash, &pak);
+			if (NULL != per)
 			{
 				// Create resource
 				bool ok = m_resourceHashMap.insert(hash, handle.idx);
 				BASE_ASSERT(ok, "Resource already exists!"); BASE_UNUSED(ok);
 
-				// Get pak file reader
-				PakEntryRef& per = m_pakEntries[entryHandle];
-				base::FileReader* reader = &m_paks[m_pakHashMap.find(per.pakHash)];
-				
-				// Seek to the offset of the entry using the entry file pointer.
-				base::seek(reader, per.offset, base::Whence::Begin);
+				// Get pak reader positioned at the offset of the entry.
+				PakReader reader(pak, 0);
+				bool opened = reader.open(*per, &m_jobSystem);
+				BASE_ASSERT(opened, "Failed to read pak entry of %s.", _filePath.getCPtr()); BASE_UNUSED(opened);
 
 				// Read resource data at offset position.
 				ResourceRef& rr = m_resources[handle.idx];
 				rr.m_refCount = 1;
 				rr.vfp = _filePath;
-				rr.resource = new TextureResource();
-				rr.resource->read(reader, base::ErrorAssert{});
+				TextureResource* resource = new TextureResource();
+				resource->read(&reader, base::ErrorAssert{});
+				rr.resource = resource;
 
 				// Return now loaded resource.
 				return handle;
@@ -1513,7 +4097,7 @@ namespace mara
 			}
 			else
 			{
-				_handle = { m_materialHandle.alloc() };
+				_handle = { allocHandle(m_materialHandle, m_materials) };
 				return false;
 			}
 		}
@@ -1584,30 +4168,31 @@ namespace mara
 			ResourceHandle handle;
 			if (resourceFindOrCreate(hash, handle))
 			{
+				// Finish pending asynchronous load of same resource.
+				waitResource(handle);
 				return handle;
 			}
 
 			// Check if resource is inside a loaded  pack
-			U16 entryHandle = m_pakEntryHashMap.find(base::hash<base::HashMurmur2A>(_filePath.getCPtr()));
-			if (kInvalidHandle != entryHandle)
+			PakFile* pak;
+			const PakEntryRef* per = pakFind(hash, &pak);
+			if (NULL != per)
 			{
 				// Create resource
 				bool ok = m_resourceHashMap.insert(hash, handle.idx);
 				BASE_ASSERT(ok, "Resource already exists!"); BASE_UNUSED(ok);
 
-				// Get pak file reader
-				PakEntryRef& per = m_pakEntries[entryHandle];
-				base::FileReader* reader = &m_paks[m_pakHashMap.find(per.pakHash)];
-
-				// Seek to the offset of the entry using the entry file pointer.
-				base::seek(reader, per.offset, base::Whence::Begin);
+				// Get pak reader positioned at the offset of the entry.
+				PakReader reader(pak, 0);
+				bool opened = reader.open(*per, &m_jobSystem);
+				BASE_ASSERT(opened, "Failed to read pak entry of %s.", _filePath.getCPtr()); BASE_UNUSED(opened);
 
 				// Read resource data at offset position.
 				ResourceRef& rr = m_resources[handle.idx];
 				rr.m_refCount = 1;
 				rr.vfp = _filePath;
 				rr.resource = new MaterialResource();
-				rr.resource->read(reader, base::ErrorAssert{});
+				rr.resource->read(&reader, base::ErrorAssert{});
 
 				// Return now loaded resource.
 				return handle;
@@ -1676,7 +4261,7 @@ namespace mara
 			}
 			else
 			{
-				_handle = { m_meshHandle.alloc() };
+				_handle = { allocHandle(m_meshHandle, m_meshes) };
 				return false;
 			}
 		}
@@ -1759,30 +4344,31 @@ namespace mara
 			ResourceHandle handle;
 			if (resourceFindOrCreate(hash, handle))
 			{
+				// Finish pending asynchronous load of same resource.
+				waitResource(handle);
 				return handle;
 			}
 
 			// Check if resource is inside a loaded  pack
-			U16 entryHandle = m_pakEntryHashMap.find(base::hash<base::HashMurmur2A>(_filePath.getCPtr()));
-			if (kInvalidHandle != entryHandle)
+			PakFile* pak;
+			const PakEntryRef* per = pakFind(hash, &pak);
+			if (NULL != per)
 			{
 				// Create resource
 				bool ok = m_resourceHashMap.insert(hash, handle.idx);
 				BASE_ASSERT(ok, "Resource already exists!"); BASE_UNUSED(ok);
 
-				// Get pak file reader
-				PakEntryRef& per = m_pakEntries[entryHandle];
-				base::FileReader* reader = &m_paks[m_pakHashMap.find(per.pakHash)];
-
-				// Seek to the offset of the entry using the entry file pointer.
-				base::seek(reader, per.offset, base::Whence::Begin);
+				// Get pak reader positioned at the offset of the entry.
+				PakReader reader(pak, 0);
+				bool opened = reader.open(*per, &m_jobSystem);
+				BASE_ASSERT(opened, "Failed to read pak entry of %s.", _filePath.getCPtr()); BASE_UNUSED(opened);
 
 				// Read resource data at offset position.
 				ResourceRef& rr = m_resources[handle.idx];
 				rr.m_refCount = 1;
 				rr.vfp = _filePath;
 				rr.resource = new MeshResource();
-				rr.resource->read(reader, base::ErrorAssert{});
+				rr.resource->read(&reader, base::ErrorAssert{});
 
 				// Return now loaded resource.
 				return handle;
@@ -1852,6 +4438,12 @@ namespace mara
 					destroyMesh(pr.m_meshes[i]);
 				}
 
+				if (NULL != pr.m_template)
+				{
+					base::free(entry::getAllocator(), pr.m_template);
+					pr.m_template = NULL;
+				}
+
 				m_prefabHashMap.removeByHandle(_handle.idx);
 			}
 		}
@@ -1868,7 +4460,7 @@ namespace mara
 			}
 			else
 			{
-				_handle = { m_prefabHandle.alloc() };
+				_handle = { allocHandle(m_prefabHandle, m_prefabs) };
 				return false;
 			}
 		}
@@ -1897,6 +4489,7 @@ namespace mara
 			PrefabRef& sr = m_prefabs[handle.idx];
 			sr.m_refCount = 1;
 			sr.m_hash = hash;
+			sr.m_template = NULL;
 
 			sr.m_numMeshes = prefabResource->m_numMeshes;
 			for (U16 i = 0; i < sr.m_numMeshes; i++)
@@ -1935,30 +4528,31 @@ namespace mara
 			ResourceHandle handle;
 			if (resourceFindOrCreate(hash, handle))
 			{
+				// Finish pending asynchronous load of same resource.
+				waitResource(handle);
 				return handle;
 			}
 
 			// Check if resource is inside a loaded  pack
-			U16 entryHandle = m_pakEntryHashMap.find(base::hash<base::HashMurmur2A>(_filePath.getCPtr()));
-			if (kInvalidHandle != entryHandle)
+			PakFile* pak;
+			const PakEntryRef* per = pakFind(hash, &pak);
+			if (NULL != per)
 			{
 				// Create resource
 				bool ok = m_resourceHashMap.insert(hash, handle.idx);
 				BASE_ASSERT(ok, "Resource already exists!"); BASE_UNUSED(ok);
 
-				// Get pak file reader
-				PakEntryRef& per = m_pakEntries[entryHandle];
-				base::FileReader* reader = &m_paks[m_pakHashMap.find(per.pakHash)];
-
-				// Seek to the offset of the entry using the entry file pointer.
-				base::seek(reader, per.offset, base::Whence::Begin);
+				// Get pak reader positioned at the offset of the entry.
+				PakReader reader(pak, 0);
+				bool opened = reader.open(*per, &m_jobSystem);
+				BASE_ASSERT(opened, "Failed to read pak entry of %s.", _filePath.getCPtr()); BASE_UNUSED(opened);
 
 				// Read resource data at offset position.
 				ResourceRef& rr = m_resources[handle.idx];
 				rr.m_refCount = 1;
 				rr.vfp = _filePath;
 				rr.resource = new PrefabResource();
-				rr.resource->read(reader, base::ErrorAssert{});
+				rr.resource->read(&reader, base::ErrorAssert{});
 
 				// Return now loaded resource.
 				return handle;
@@ -1978,12 +4572,141 @@ namespace mara
 				return;
 			}
 
+			// Prefabs created from entity have no resource.
+			const bool fromResource = NULL == m_prefabs[_handle.idx].m_template;
+
 			prefabDecRef(_handle);
 
 			// Resources
-			PrefabRef& mr = m_prefabs[_handle.idx];
-			U16 resourceHandle = m_resourceHashMap.find(mr.m_hash);
-			destroyResource({ resourceHandle });
+			if (fromResource)
+			{
+				PrefabRef& mr = m_prefabs[_handle.idx];
+				U16 resourceHandle = m_resourceHashMap.find(mr.m_hash);
+				destroyResource({ resourceHandle });
+			}
+		}
+
+		MARA_API_FUNC(PrefabHandle createPrefab(EntityHandle _entity))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			if (!isValid(_entity) )
+			{
+				BASE_WARN(false, "Passing invalid entity handle to mara::createPrefab.");
+				return MARA_INVALID_HANDLE;
+			}
+
+			const EntityRef& er = m_entities[_entity.idx];
+
+			// Payloads are packed one after another, each 16 byte aligned.
+			ComponentMask mask;
+			U32 size = 0;
+			for (U16 ii = 0; ii < MARA_CONFIG_MAX_COMPONENT_TYPES; ++ii)
+			{
+				const ComponentType type = { ii };
+				if (!er.m_mask.test(type) )
+				{
+					continue;
+				}
+
+				if (!m_componentTypes[ii].m_registered)
+				{
+					BASE_WARN(false, "Component type %d is not registered and won't be part of prefab.", ii);
+					continue;
+				}
+
+				mask.set(type);
+				size = (size + 15) & ~15u;
+				size += m_componentTypes[ii].m_size;
+			}
+
+			PrefabHandle handle = { allocHandle(m_prefabHandle, m_prefabs) };
+			if (!isValid(handle) )
+			{
+				BASE_TRACE("Failed to create prefab handle.");
+				return handle;
+			}
+
+			PrefabTemplate* pt = (PrefabTemplate*)base::alloc(entry::getAllocator(), sizeof(PrefabTemplate) + 15 + size);
+			pt->m_mask = mask;
+			pt->m_data = (U8*)( (uintptr_t(&pt[1]) + 15) & ~uintptr_t(15) );
+			base::memSet(pt->m_offsets, 0xff, sizeof(pt->m_offsets) );
+
+			U32 offset = 0;
+			for (U16 ii = 0; ii < MARA_CONFIG_MAX_COMPONENT_TYPES; ++ii)
+			{
+				const ComponentType type = { ii };
+				if (!mask.test(type) )
+				{
+					continue;
+				}
+
+				offset = (offset + 15) & ~15u;
+				pt->m_offsets[ii] = offset;
+				base::memCopy(&pt->m_data[offset], getComponentData(_entity, type), m_componentTypes[ii].m_size);
+				offset += m_componentTypes[ii].m_size;
+			}
+
+			pt->m_hasTransform = m_transforms.has(_entity);
+			if (pt->m_hasTransform)
+			{
+				base::memCopy(pt->m_transform, m_transforms.getLocal(_entity), sizeof(pt->m_transform) );
+			}
+
+			PrefabRef& pr = m_prefabs[handle.idx];
+			pr.m_refCount = 1;
+			pr.m_hash = 0;
+			pr.m_numMeshes = 0;
+			pr.m_template = pt;
+
+			return handle;
+		}
+
+		MARA_API_FUNC(U32 instantiate(PrefabHandle _handle, U32 _num, const F32* _transforms, EntityHandle* _outEntities))
+		{
+			MARA_MUTEX_SCOPE(m_resourceApiLock);
+
+			if (!isValid(_handle)
+			||  NULL == m_prefabs[_handle.idx].m_template)
+			{
+				BASE_WARN(false, "Passing invalid or non entity prefab handle to mara::instantiate.");
+				return 0;
+			}
+
+			const PrefabTemplate& pt = *m_prefabs[_handle.idx].m_template;
+
+			EntityHandle* handles = NULL != _outEntities
+				? _outEntities
+				: (EntityHandle*)base::alloc(getFrameAllocator(), _num * sizeof(EntityHandle) )
+				;
+
+			const U32 num = entitiesCreate(_num, pt.m_mask, handles, &pt);
+
+			if (NULL != _transforms
+			||  pt.m_hasTransform)
+			{
+				const EntityHandle root = MARA_INVALID_HANDLE;
+				for (U32 ii = 0; ii < num; ++ii)
+				{
+					m_transforms.add(handles[ii], root);
+					m_transforms.setLocal(handles[ii], NULL != _transforms ? &_transforms[ii * 16] : pt.m_transform);
+				}
+			}
+
+			return num;
+		}
+
+		void destroyPrefabTemplates()
+		{
+			for (U16 ii = 0, num = m_prefabHandle.getNumHandles(); ii < num; ++ii)
+			{
+				PrefabRef& pr = m_prefabs[m_prefabHandle.getHandleAt(ii)];
+				if (NULL != pr.m_template)
+				{
+					base::free(entry::getAllocator(), pr.m_template);
+					pr.m_template = NULL;
+				}
+			}
 		}
 
 		MARA_API_FUNC(U16 getNumMeshes(PrefabHandle _handle))
@@ -2013,10 +4736,16 @@ namespace mara
 			Stats& stats = m_stats;
 
 			stats.numPaks = m_pakHashMap.getNumElements();
-			stats.numPakEntries = m_pakEntryHashMap.getNumElements();
+			stats.numPakEntries = 0;
+			for (U16 ii = 0, num = m_pakHandle.getNumHandles(); ii < num; ++ii)
+			{
+				stats.numPakEntries += m_paks[m_pakHandle.getHandleAt(ii)].m_numEntries;
+			}
 
 			stats.numEntities = m_entityHandle.getNumHandles();
 			stats.numComponents = m_componentHandle.getNumHandles();
+			stats.numArchetypes = m_archetypeHandle.getNumHandles();
+			stats.numSystems = m_scheduler.getNumSystems();
 			stats.numResources = m_resourceHandle.getNumHandles();
 			stats.numGeometries = m_geometryHandle.getNumHandles();
 			stats.numShaders = m_shaderHandle.getNumHandles();
@@ -2067,51 +4796,67 @@ namespace mara
 
 		I64 m_time;
 		F32 m_deltaTime;
+		U32 m_frame;
+		bool m_headless;
 		Stats m_stats;
+
+		FrameAllocator m_frameAllocators[MARA_CONFIG_MAX_WORKERS]; //!< One per worker, systems allocate concurrently.
+		JobSystem m_jobSystem;
+		SystemScheduler m_scheduler;
+		EntityCommandBuffer m_commandBuffers[MARA_CONFIG_MAX_WORKERS];
+		TransformSystem m_transforms;
+		BoundsTree m_boundsTree;
+		ObserverRegistry m_observers;
+		ResourceLoader m_loader;
 		
-		base::HandleAllocT<MARA_CONFIG_MAX_PAKS> m_pakHandle;
-		base::HandleHashMapT<MARA_CONFIG_MAX_PAKS> m_pakHashMap;
-		base::FileReader m_paks[MARA_CONFIG_MAX_PAKS];
+		LazyHandleAllocT<MARA_CONFIG_MAX_PAKS> m_pakHandle;
+		LazyHandleHashMapT<MARA_CONFIG_MAX_PAKS> m_pakHashMap;
+		PakFile m_paks[MARA_CONFIG_MAX_PAKS];
+
+
+		LazyHandleAllocT<MARA_CONFIG_MAX_RESOURCES> m_resourceHandle;
+		LazyHandleHashMapT<MARA_CONFIG_MAX_RESOURCES> m_resourceHashMap;
+		PagedArrayT<ResourceRef, MARA_CONFIG_MAX_RESOURCES> m_resources;
 
-		base::HandleAllocT<MARA_CONFIG_MAX_PAK_ENTRIES> m_pakEntryHandle;
-		base::HandleHashMapT<MARA_CONFIG_MAX_PAK_ENTRIES> m_pakEntryHashMap;
-		PakEntryRef m_pakEntries[MARA_CONFIG_MAX_PAK_ENTRIES];
+		LazyHandleAllocT<MARA_CONFIG_MAX_COMPONENTS> m_componentHandle;
+		LazyHandleHashMapT<MARA_CONFIG_MAX_COMPONENTS> m_componentHashMap; //!< Keyed by component type and entity.
+		PagedArrayT<ComponentRef, MARA_CONFIG_MAX_COMPONENTS> m_components;
 
-		base::HandleAllocT<MARA_CONFIG_MAX_RESOURCES> m_resourceHandle;
-		base::HandleHashMapT<MARA_CONFIG_MAX_RESOURCES> m_resourceHashMap;
-		ResourceRef m_resources[MARA_CONFIG_MAX_RESOURCES];
+		LazyHandleAllocT<MARA_CONFIG_MAX_ENTITIES> m_entityHandle;
+		PagedArrayT<EntityRef, MARA_CONFIG_MAX_ENTITIES> m_entities;
 
-		base::HandleAllocT<MARA_CONFIG_MAX_COMPONENTS> m_componentHandle;
-		base::HandleHashMapT<MARA_CONFIG_MAX_COMPONENTS_PER_TYPE> m_componentHashMap[32];
-		ComponentRef m_components[MARA_CONFIG_MAX_COMPONENTS];
+		LazyHandleAllocT<MARA_CONFIG_MAX_QUERIES> m_queryHandle;
+		PagedArrayT<QueryRef, MARA_CONFIG_MAX_QUERIES> m_queries;
 
-		base::HandleAllocT<MARA_CONFIG_MAX_ENTITIES> m_entityHandle;
-		base::HandleHashMapT<MARA_CONFIG_MAX_COMPONENTS_PER_TYPE> m_entityHashMap[32];
-		EntityRef m_entities[MARA_CONFIG_MAX_ENTITIES];
+		LazyHandleAllocT<MARA_CONFIG_MAX_ARCHETYPES> m_archetypeHandle;
+		LazyHandleHashMapT<MARA_CONFIG_MAX_ARCHETYPES> m_archetypeHashMap;
+		PagedArrayT<ArchetypeRef, MARA_CONFIG_MAX_ARCHETYPES> m_archetypes;
+		ComponentTypeRef m_componentTypes[MARA_CONFIG_MAX_COMPONENT_TYPES];
+		ComponentPoolBase m_componentPools[MARA_CONFIG_MAX_COMPONENT_TYPES];
 
-		base::HandleAllocT<MARA_CONFIG_MAX_GEOMETRIES> m_geometryHandle;
-		base::HandleHashMapT<MARA_CONFIG_MAX_GEOMETRIES> m_geometryHashMap;
-		GeometryRef m_geometries[MARA_CONFIG_MAX_GEOMETRIES];
+		LazyHandleAllocT<MARA_CONFIG_MAX_GEOMETRIES> m_geometryHandle;
+		LazyHandleHashMapT<MARA_CONFIG_MAX_GEOMETRIES> m_geometryHashMap;
+		PagedArrayT<GeometryRef, MARA_CONFIG_MAX_GEOMETRIES> m_geometries;
 
-		base::HandleAllocT<MARA_CONFIG_MAX_SHADERS> m_shaderHandle;
-		base::HandleHashMapT<MARA_CONFIG_MAX_SHADERS> m_shaderHashMap;
-		ShaderRef m_shaders[MARA_CONFIG_MAX_SHADERS];
+		LazyHandleAllocT<MARA_CONFIG_MAX_SHADERS> m_shaderHandle;
+		LazyHandleHashMapT<MARA_CONFIG_MAX_SHADERS> m_shaderHashMap;
+		PagedArrayT<ShaderRef, MARA_CONFIG_MAX_SHADERS> m_shaders;
 
-		base::HandleAllocT<MARA_CONFIG_MAX_TEXTURES> m_textureHandle;
-		base::HandleHashMapT<MARA_CONFIG_MAX_TEXTURES> m_textureHashMap;
-		TextureRef m_textures[MARA_CONFIG_MAX_TEXTURES];
+		LazyHandleAllocT<MARA_CONFIG_MAX_TEXTURES> m_textureHandle;
+		LazyHandleHashMapT<MARA_CONFIG_MAX_TEXTURES> m_textureHashMap;
+		PagedArrayT<TextureRef, MARA_CONFIG_MAX_TEXTURES> m_textures;
 
-		base::HandleAllocT<MARA_CONFIG_MAX_MATERIALS> m_materialHandle;
-		base::HandleHashMapT<MARA_CONFIG_MAX_MATERIALS> m_materialHashMap;
-		MaterialRef m_materials[MARA_CONFIG_MAX_MATERIALS];
+		LazyHandleAllocT<MARA_CONFIG_MAX_MATERIALS> m_materialHandle;
+		LazyHandleHashMapT<MARA_CONFIG_MAX_MATERIALS> m_materialHashMap;
+		PagedArrayT<MaterialRef, MARA_CONFIG_MAX_MATERIALS> m_materials;
 
-		base::HandleAllocT<MARA_CONFIG_MAX_MESHES> m_meshHandle;
-		base::HandleHashMapT<MARA_CONFIG_MAX_MESHES> m_meshHashMap;
-		MeshRef m_meshes[MARA_CONFIG_MAX_MESHES];
+		LazyHandleAllocT<MARA_CONFIG_MAX_MESHES> m_meshHandle;
+		LazyHandleHashMapT<MARA_CONFIG_MAX_MESHES> m_meshHashMap;
+		PagedArrayT<MeshRef, MARA_CONFIG_MAX_MESHES> m_meshes;
 
-		base::HandleAllocT<MARA_CONFIG_MAX_PREFABS> m_prefabHandle;
-		base::HandleHashMapT<MARA_CONFIG_MAX_PREFABS> m_prefabHashMap;
-		PrefabRef m_prefabs[MARA_CONFIG_MAX_PREFABS];
+		LazyHandleAllocT<MARA_CONFIG_MAX_PREFABS> m_prefabHandle;
+		LazyHandleHashMapT<MARA_CONFIG_MAX_PREFABS> m_prefabHashMap;
+		PagedArrayT<PrefabRef, MARA_CONFIG_MAX_PREFABS> m_prefabs;
 
 		template<typename Ty, U32 Max>
 		struct FreeHandle
@@ -2178,6 +4923,7 @@ namespace mara
 		FreeHandle<MaterialHandle, MARA_CONFIG_MAX_MATERIALS> m_freeMaterials;
 		FreeHandle<MeshHandle, MARA_CONFIG_MAX_MESHES> m_freeMeshes;
 		FreeHandle<PrefabHandle, MARA_CONFIG_MAX_PREFABS> m_freePrefabs;
+		FreeHandle<QueryHandle, MARA_CONFIG_MAX_QUERIES> m_freeQueries;
 
 		entry::MouseState m_mouseState;
 	};
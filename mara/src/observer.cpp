@@ -0,0 +1,231 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#include "mara_p.h"
+
+namespace mara
+{
+	ObserverRegistry::ObserverRegistry()
+		: m_allocator(NULL)
+		, m_current(0)
+		, m_foldedCapacity(0)
+		, m_stamps(NULL)
+		, m_states(NULL)
+		, m_stamp(0)
+	{
+		base::memSet(m_numObservers, 0, sizeof(m_numObservers) );
+		base::memSet(m_events, 0, sizeof(m_events) );
+		base::memSet(m_folded, 0, sizeof(m_folded) );
+		base::memSet(m_numFolded, 0, sizeof(m_numFolded) );
+	}
+
+	void ObserverRegistry::init(base::AllocatorI* _allocator)
+	{
+		m_allocator = _allocator;
+
+		m_stamps = (U32*)base::alloc(m_allocator, MARA_CONFIG_MAX_ENTITIES * sizeof(U32) );
+		m_states = (U8*)base::alloc(m_allocator, MARA_CONFIG_MAX_ENTITIES);
+		base::memSet(m_stamps, 0, MARA_CONFIG_MAX_ENTITIES * sizeof(U32) );
+		m_stamp = 0;
+	}
+
+	void ObserverRegistry::shutdown()
+	{
+		for (U32 ii = 0; ii < 2; ++ii)
+		{
+			for (U32 jj = 0; jj < MARA_CONFIG_MAX_COMPONENT_TYPES; ++jj)
+			{
+				base::free(m_allocator, m_events[ii][jj].m_events);
+			}
+		}
+
+		base::memSet(m_events, 0, sizeof(m_events) );
+
+		base::free(m_allocator, m_folded[0]);
+		base::free(m_allocator, m_folded[1]);
+		base::free(m_allocator, m_stamps);
+		base::free(m_allocator, m_states);
+		base::memSet(m_folded, 0, sizeof(m_folded) );
+		m_foldedCapacity = 0;
+		m_stamps = NULL;
+		m_states = NULL;
+	}
+
+	ObserverHandle ObserverRegistry::registerObserver(ComponentType _type, ObserverFn _fn, void* _userData)
+	{
+		ObserverHandle handle = { m_observerHandle.alloc() };
+		if (!isValid(handle) )
+		{
+			BASE_TRACE("Failed to create observer handle.");
+			return handle;
+		}
+
+		ObserverRef& ref = m_observers[handle.idx];
+		ref.m_type = _type;
+		ref.m_fn = _fn;
+		ref.m_userData = _userData;
+
+		++m_numObservers[_type.idx];
+		m_observed.set(_type);
+
+		return handle;
+	}
+
+	void ObserverRegistry::destroyObserver(ObserverHandle _handle)
+	{
+		const ComponentType type = m_observers[_handle.idx].m_type;
+		if (0 == --m_numObservers[type.idx])
+		{
+			m_observed.unset(type);
+		}
+
+		m_observerHandle.free(_handle.idx);
+	}
+
+	void ObserverRegistry::push(U32 _type, U32 _removed, const EntityHandle* _entities, U32 _num)
+	{
+		Events& events = m_events[m_current][_type];
+		const U32 num = events.m_num + _num;
+		if (num > events.m_capacity)
+		{
+			events.m_capacity = base::max<U32>(base::max<U32>(events.m_capacity * 2, 64), num);
+			events.m_events = (U32*)base::realloc(m_allocator, events.m_events, events.m_capacity * sizeof(U32) );
+		}
+
+		for (U32 ii = 0; ii < _num; ++ii)
+		{
+			events.m_events[events.m_num + ii] = _entities[ii].idx | _removed;
+		}
+
+		events.m_num = num;
+	}
+
+	void ObserverRegistry::fold(const Events& _events)
+	{
+		enum
+		{
+			FirstRemoved = 1 << 0,
+			LastAdded    = 1 << 1,
+		};
+
+		if (_events.m_num > m_foldedCapacity)
+		{
+			m_foldedCapacity = base::max<U32>(m_foldedCapacity * 2, _events.m_num);
+			m_folded[0] = (EntityHandle*)base::realloc(m_allocator, m_folded[0], m_foldedCapacity * sizeof(EntityHandle) );
+			m_folded[1] = (EntityHandle*)base::realloc(m_allocator, m_folded[1], m_foldedCapacity * sizeof(EntityHandle) );
+		}
+
+		if (m_stamp >= UINT32_MAX - 2)
+		{
+			base::memSet(m_stamps, 0, MARA_CONFIG_MAX_ENTITIES * sizeof(U32) );
+			m_stamp = 0;
+		}
+
+		m_stamp += 2;
+		const U32 seen = m_stamp;
+		const U32 done = m_stamp + 1;
+
+		// Events of same entity alternate, first event tells if entity had component
+		// before this frame, last one if it has it now.
+		for (U32 ii = 0; ii < _events.m_num; ++ii)
+		{
+			const U32 idx = _events.m_events[ii] & ~kRemovedBit;
+			const bool removed = 0 != (_events.m_events[ii] & kRemovedBit);
+
+			if (seen != m_stamps[idx])
+			{
+				m_stamps[idx] = seen;
+				m_states[idx] = removed ? FirstRemoved : 0;
+			}
+
+			m_states[idx] = U8( (m_states[idx] & FirstRemoved) | (removed ? 0 : LastAdded) );
+		}
+
+		m_numFolded[0] = 0;
+		m_numFolded[1] = 0;
+
+		// Entity that had component and has it again, was removed and added again, or was
+		// destroyed and its handle reused. It's reported in both lists.
+		for (U32 ii = 0; ii < _events.m_num; ++ii)
+		{
+			const U32 idx = _events.m_events[ii] & ~kRemovedBit;
+			if (seen != m_stamps[idx])
+			{
+				continue;
+			}
+
+			m_stamps[idx] = done;
+
+			const EntityHandle handle = { U16(idx) };
+			if (0 != (m_states[idx] & FirstRemoved) )
+			{
+				m_folded[1][m_numFolded[1]++] = handle;
+			}
+
+			if (0 != (m_states[idx] & LastAdded) )
+			{
+				m_folded[0][m_numFolded[0]++] = handle;
+			}
+		}
+	}
+
+	void ObserverRegistry::recordChanged(EntityHandle _entity, const ComponentMask& _oldMask, const ComponentMask& _newMask)
+	{
+		for (U32 ww = 0; ww < ComponentMask::kNumWords; ++ww)
+		{
+			for (U64 bits = (_oldMask.m_bits[ww] ^ _newMask.m_bits[ww]) & m_observed.m_bits[ww]; 0 != bits; bits &= bits - 1)
+			{
+				const U32 type = ww * 64 + U32(base::uint64_cnttz(bits) );
+				const U32 removed = 0 != (_newMask.m_bits[ww] & (U64(1) << (type % 64) ) ) ? 0 : kRemovedBit;
+				push(type, removed, &_entity, 1);
+			}
+		}
+	}
+
+	void ObserverRegistry::recordCreated(const EntityHandle* _entities, U32 _num, const ComponentMask& _types)
+	{
+		for (U32 ww = 0; ww < ComponentMask::kNumWords; ++ww)
+		{
+			for (U64 bits = _types.m_bits[ww] & m_observed.m_bits[ww]; 0 != bits; bits &= bits - 1)
+			{
+				push(ww * 64 + U32(base::uint64_cnttz(bits) ), 0, _entities, _num);
+			}
+		}
+	}
+
+	void ObserverRegistry::dispatch()
+	{
+		// Observers can change components while handling events, those go to other buffer.
+		Events* events = m_events[m_current];
+		m_current ^= 1;
+
+		for (U32 type = 0; type < MARA_CONFIG_MAX_COMPONENT_TYPES; ++type)
+		{
+			if (0 == events[type].m_num)
+			{
+				continue;
+			}
+
+			fold(events[type]);
+			events[type].m_num = 0;
+
+			if (0 == m_numFolded[0]
+			&&  0 == m_numFolded[1])
+			{
+				continue;
+			}
+
+			for (U16 ii = 0, num = m_observerHandle.getNumHandles(); ii < num; ++ii)
+			{
+				const ObserverRef& ref = m_observers[m_observerHandle.getHandleAt(ii)];
+				if (type == ref.m_type.idx)
+				{
+					ref.m_fn(ref.m_type, m_folded[0], m_numFolded[0], m_folded[1], m_numFolded[1], ref.m_userData);
+				}
+			}
+		}
+	}
+
+} // namespace mara
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#ifndef MARA_OBSERVER_H_HEADER_GUARD
+#define MARA_OBSERVER_H_HEADER_GUARD
+
+#include <mara/mara.h>
+
+namespace mara
+{
+	struct ObserverRef
+	{
+		ComponentType m_type;
+		ObserverFn m_fn;
+		void* m_userData;
+	};
+
+	/// Collects component add and remove events of observed component types
+	/// during the frame, and delivers them once per frame as one batch per type.
+	/// Events of each entity are folded to net change before delivery. Events
+	/// are double buffered, events recorded while dispatching are delivered
+	/// next frame.
+	///
+	struct ObserverRegistry
+	{
+		/// Events of one component type in order of recording. Entry is entity
+		/// index, with `kRemovedBit` set if component was removed.
+		struct Events
+		{
+			U32* m_events;
+			U32 m_num;
+			U32 m_capacity;
+		};
+
+		static const U32 kRemovedBit = 0x10000;
+
+		ObserverRegistry();
+
+		void init(base::AllocatorI* _allocator);
+		void shutdown();
+
+		ObserverHandle registerObserver(ComponentType _type, ObserverFn _fn, void* _userData);
+		void destroyObserver(ObserverHandle _handle);
+
+		/// Record signature change of single entity.
+		void record(EntityHandle _entity, const ComponentMask& _oldMask, const ComponentMask& _newMask)
+		{
+			bool observed = false;
+			for (U32 ii = 0; ii < ComponentMask::kNumWords; ++ii)
+			{
+				observed |= 0 != ( (_oldMask.m_bits[ii] ^ _newMask.m_bits[ii]) & m_observed.m_bits[ii]);
+			}
+
+			if (observed)
+			{
+				recordChanged(_entity, _oldMask, _newMask);
+			}
+		}
+
+		void recordChanged(EntityHandle _entity, const ComponentMask& _oldMask, const ComponentMask& _newMask);
+
+		/// Record entities created with same component types.
+		void recordCreated(const EntityHandle* _entities, U32 _num, const ComponentMask& _types);
+
+		/// Call observers with events recorded since last dispatch.
+		void dispatch();
+
+		void push(U32 _type, U32 _removed, const EntityHandle* _entities, U32 _num);
+
+		/// Fold events to net change of each entity into `m_folded`.
+		void fold(const Events& _events);
+
+		base::AllocatorI* m_allocator;
+
+		base::HandleAllocT<MARA_CONFIG_MAX_OBSERVERS> m_observerHandle;
+		ObserverRef m_observers[MARA_CONFIG_MAX_OBSERVERS];
+		U16 m_numObservers[MARA_CONFIG_MAX_COMPONENT_TYPES];
+		ComponentMask m_observed;
+
+		Events m_events[2][MARA_CONFIG_MAX_COMPONENT_TYPES];
+		U32 m_current; //!< Events buffer being recorded into.
+
+		EntityHandle* m_folded[2]; //!< Added and removed entities of folded type.
+		U32 m_numFolded[2];
+		U32 m_foldedCapacity;
+
+		U32* m_stamps; //!< Entity indexed, fold that last saw entity.
+		U8* m_states;  //!< Entity indexed, first and last event of entity.
+		U32 m_stamp;
+	};
+
+} // namespace mara
+
+#endif // MARA_OBSERVER_H_HEADER_GUARD
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#ifndef MARA_PAGED_ARRAY_H_HEADER_GUARD
+#define MARA_PAGED_ARRAY_H_HEADER_GUARD
+
+#include <mara/mara.h>
+
+namespace mara
+{
+	/// Array indexed by handle, with storage committed one page at a time. Only
+	/// page table is sized by `MaxT`, so memory follows highest handle in use.
+	/// Pages are never moved or released before `shutdown`, references to
+	/// elements stay valid while other handles are allocated.
+	///
+	template<typename Ty, U32 MaxT, U32 PageSizeT = MARA_CONFIG_HANDLE_PAGE_SIZE>
+	struct PagedArrayT
+	{
+		BASE_STATIC_ASSERT(0 == (PageSizeT & (PageSizeT - 1) ), "Page size must be power of two.");
+
+		static constexpr U32 kMaxPages = (MaxT + PageSizeT - 1) / PageSizeT;
+
+		PagedArrayT()
+			: m_allocator(NULL)
+			, m_numPages(0)
+		{
+			base::memSet(m_pages, 0, sizeof(m_pages) );
+		}
+
+		~PagedArrayT()
+		{
+			shutdown();
+		}
+
+		void init(base::AllocatorI* _allocator)
+		{
+			m_allocator = _allocator;
+		}
+
+		void shutdown()
+		{
+			for (U32 ii = 0; ii < kMaxPages; ++ii)
+			{
+				Ty* page = m_pages[ii];
+				if (NULL != page)
+				{
+					for (U32 jj = 0; jj < PageSizeT; ++jj)
+					{
+						page[jj].~Ty();
+					}
+
+					base::free(m_allocator, page, alignof(Ty) );
+					m_pages[ii] = NULL;
+				}
+			}
+
+			m_numPages = 0;
+		}
+
+		/// Make sure element `_idx` is backed by memory. New pages are value
+		/// initialized. Must be called when handle is allocated, before it's
+		/// accessed with `operator[]`.
+		Ty& commit(U32 _idx)
+		{
+			BASE_ASSERT(_idx < MaxT, "Index %d out of range.", _idx);
+
+			Ty*& page = m_pages[_idx / PageSizeT];
+			if (NULL == page)
+			{
+				page = (Ty*)base::alloc(m_allocator, PageSizeT * sizeof(Ty), alignof(Ty) );
+				for (U32 ii = 0; ii < PageSizeT; ++ii)
+				{
+					::new (&page[ii]) Ty();
+				}
+
+				m_numPages = base::max<U32>(m_numPages, _idx / PageSizeT + 1);
+			}
+
+			return page[_idx % PageSizeT];
+		}
+
+		bool isCommitted(U32 _idx) const
+		{
+			return _idx < MaxT && NULL != m_pages[_idx / PageSizeT];
+		}
+
+		/// Number of elements up to end of last committed page.
+		U32 getSize() const
+		{
+			return base::min<U32>(m_numPages * PageSizeT, MaxT);
+		}
+
+		Ty& operator[](U32 _idx)
+		{
+			BASE_ASSERT(isCommitted(_idx), "Index %d is not committed.", _idx);
+			return m_pages[_idx / PageSizeT][_idx % PageSizeT];
+		}
+
+		const Ty& operator[](U32 _idx) const
+		{
+			BASE_ASSERT(isCommitted(_idx), "Index %d is not committed.", _idx);
+			return m_pages[_idx / PageSizeT][_idx % PageSizeT];
+		}
+
+		base::AllocatorI* m_allocator;
+		Ty* m_pages[kMaxPages];
+		U32 m_numPages; //!< One past highest committed page.
+	};
+
+} // namespace mara
+
+#endif // MARA_PAGED_ARRAY_H_HEADER_GUARD
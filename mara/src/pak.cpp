@@ -0,0 +1,683 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#include "mara_p.h"
+
+#if BASE_PLATFORM_WINDOWS
+#	include <windows.h>
+#elif BASE_PLATFORM_POSIX
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif // BASE_PLATFORM_*
+
+namespace mara
+{
+	struct PakMapping
+	{
+		const U8* m_data;
+		I64 m_size;
+		I32 m_refCount;
+		bool m_mapped; //!< File view, otherwise heap memory.
+
+#if BASE_PLATFORM_WINDOWS
+		HANDLE m_file;
+		HANDLE m_map;
+#endif // BASE_PLATFORM_WINDOWS
+	};
+
+	static PakMapping* pakMap(const base::FilePath& _filePath)
+	{
+#if BASE_PLATFORM_WINDOWS
+		HANDLE file = CreateFileA(_filePath.getCPtr(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+		if (INVALID_HANDLE_VALUE == file)
+		{
+			return NULL;
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size)
+		||  0 == size.QuadPart)
+		{
+			CloseHandle(file);
+			return NULL;
+		}
+
+		HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (NULL == map)
+		{
+			CloseHandle(file);
+			return NULL;
+		}
+
+		void* data = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+		if (NULL == data)
+		{
+			CloseHandle(map);
+			CloseHandle(file);
+			return NULL;
+		}
+
+		PakMapping* mapping = BASE_NEW(entry::getAllocator(), PakMapping);
+		mapping->m_data = (const U8*)data;
+		mapping->m_size = size.QuadPart;
+		mapping->m_refCount = 1;
+		mapping->m_mapped = true;
+		mapping->m_file = file;
+		mapping->m_map = map;
+		return mapping;
+#elif BASE_PLATFORM_POSIX
+		const int fd = ::open(_filePath.getCPtr(), O_RDONLY);
+		if (-1 == fd)
+		{
+			return NULL;
+		}
+
+		struct stat st;
+		if (0 != fstat(fd, &st)
+		||  0 == st.st_size)
+		{
+			::close(fd);
+			return NULL;
+		}
+
+		void* data = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+		// Mapping keeps file referenced, descriptor is not needed anymore.
+		::close(fd);
+
+		if (MAP_FAILED == data)
+		{
+			return NULL;
+		}
+
+		PakMapping* mapping = BASE_NEW(entry::getAllocator(), PakMapping);
+		mapping->m_data = (const U8*)data;
+		mapping->m_size = I64(st.st_size);
+		mapping->m_refCount = 1;
+		mapping->m_mapped = true;
+		return mapping;
+#else
+		BASE_UNUSED(_filePath);
+		return NULL;
+#endif // BASE_PLATFORM_*
+	}
+
+	static PakMapping* pakMemoryCreate(U32 _size)
+	{
+		PakMapping* mapping = BASE_NEW(entry::getAllocator(), PakMapping);
+		mapping->m_data = (const U8*)base::alloc(entry::getAllocator(), base::max<U32>(_size, 1), 16);
+		mapping->m_size = _size;
+		mapping->m_refCount = 1;
+		mapping->m_mapped = false;
+		return mapping;
+	}
+
+	static void pakMappingRelease(PakMapping* _mapping)
+	{
+		if (0 != base::atomicSubAndFetch<I32>(&_mapping->m_refCount, 1) )
+		{
+			return;
+		}
+
+		if (_mapping->m_mapped)
+		{
+#if BASE_PLATFORM_WINDOWS
+			UnmapViewOfFile(_mapping->m_data);
+			CloseHandle(_mapping->m_map);
+			CloseHandle(_mapping->m_file);
+#elif BASE_PLATFORM_POSIX
+			munmap(const_cast<U8*>(_mapping->m_data), size_t(_mapping->m_size) );
+#endif // BASE_PLATFORM_*
+		}
+		else
+		{
+			base::free(entry::getAllocator(), const_cast<U8*>(_mapping->m_data), 16);
+		}
+
+		BASE_DELETE(entry::getAllocator(), _mapping);
+	}
+
+	static void pakMappingReleaseFn(void* _ptr, void* _userData)
+	{
+		BASE_UNUSED(_ptr);
+		pakMappingRelease( (PakMapping*)_userData);
+	}
+
+	static const graphics::Memory* pakMappingRef(PakMapping* _mapping, I64 _offset, U32 _size)
+	{
+		BASE_ASSERT(_offset + _size <= _mapping->m_size, "Reference out of bounds.");
+
+		base::atomicAddAndFetch<I32>(&_mapping->m_refCount, 1);
+		return graphics::makeRef(&_mapping->m_data[_offset], _size, pakMappingReleaseFn, _mapping);
+	}
+
+	struct PakDecompress
+	{
+		const U8* m_src;
+		const U32* m_srcOffsets; //!< Offset of each block, plus end of last one.
+		const U32* m_storedSizes;
+		U8* m_dst;
+		U32 m_size;
+		U32 m_blockSize;
+		volatile I32 m_numFailed;
+	};
+
+	static void pakDecompressBlocks(U32 _begin, U32 _end, void* _userData)
+	{
+		PakDecompress& pd = *(PakDecompress*)_userData;
+
+		for (U32 ii = _begin; ii < _end; ++ii)
+		{
+			const U8* src = &pd.m_src[pd.m_srcOffsets[ii] ];
+			const U32 srcSize = pd.m_srcOffsets[ii + 1] - pd.m_srcOffsets[ii];
+			U8* dst = &pd.m_dst[ii * pd.m_blockSize];
+			const U32 dstSize = base::min<U32>(pd.m_blockSize, pd.m_size - ii * pd.m_blockSize);
+
+			bool ok;
+			if (0 != (pd.m_storedSizes[ii] & UINT32_C(0x80000000) ) )
+			{
+				ok = srcSize == dstSize;
+				if (ok)
+				{
+					base::memCopy(dst, src, dstSize);
+				}
+			}
+			else
+			{
+				ok = lzDecompress(dst, dstSize, src, srcSize);
+			}
+
+			if (!ok)
+			{
+				base::atomicAddAndFetch<I32>(&pd.m_numFailed, 1);
+			}
+		}
+	}
+
+	/// Decompress entry stored in `_src` into new memory.
+	static PakMapping* pakDecompress(const U8* _src, U32 _srcSize, U32 _size, JobSystem* _jobSystem)
+	{
+		U32 blockSize = 0;
+		if (_srcSize >= sizeof(U32) )
+		{
+			base::memCopy(&blockSize, _src, sizeof(U32) );
+		}
+
+		if (0 == blockSize)
+		{
+			return NULL;
+		}
+
+		const U32 numBlocks  = (_size + blockSize - 1) / blockSize;
+		const U64 headerSize = sizeof(U32) + U64(numBlocks) * sizeof(U32);
+		if (headerSize > _srcSize)
+		{
+			return NULL;
+		}
+
+		U32* storedSizes = (U32*)base::alloc(entry::getAllocator(), (2 * numBlocks + 1) * sizeof(U32) );
+		U32* srcOffsets  = storedSizes + numBlocks;
+		base::memCopy(storedSizes, &_src[sizeof(U32)], numBlocks * sizeof(U32) );
+
+		U64 offset = headerSize;
+		for (U32 ii = 0; ii < numBlocks; ++ii)
+		{
+			srcOffsets[ii] = U32(base::min<U64>(offset, _srcSize) );
+			offset += storedSizes[ii] & UINT32_C(0x7fffffff);
+		}
+
+		srcOffsets[numBlocks] = U32(base::min<U64>(offset, _srcSize) );
+
+		PakMapping* memory = NULL;
+		if (offset <= _srcSize)
+		{
+			memory = pakMemoryCreate(_size);
+
+			PakDecompress pd;
+			pd.m_src = _src;
+			pd.m_srcOffsets = srcOffsets;
+			pd.m_storedSizes = storedSizes;
+			pd.m_dst = const_cast<U8*>(memory->m_data);
+			pd.m_size = _size;
+			pd.m_blockSize = blockSize;
+			pd.m_numFailed = 0;
+
+			if (1 < numBlocks
+			&&  NULL != _jobSystem
+			&&  _jobSystem->canSubmit() )
+			{
+				JobCounter counter;
+				_jobSystem->parallelFor(0, numBlocks, 1, pakDecompressBlocks, &pd, &counter);
+				_jobSystem->wait(&counter);
+			}
+			else
+			{
+				pakDecompressBlocks(0, numBlocks, &pd);
+			}
+
+			if (0 != pd.m_numFailed)
+			{
+				pakMappingRelease(memory);
+				memory = NULL;
+			}
+		}
+
+		base::free(entry::getAllocator(), storedSizes);
+		return memory;
+	}
+
+	PakFile::PakFile()
+		: m_mapping(NULL)
+		, m_toc(NULL)
+		, m_numEntries(0)
+		, m_size(0)
+		, m_open(false)
+	{
+#if BASE_PLATFORM_WINDOWS
+		m_file = INVALID_HANDLE_VALUE;
+#elif BASE_PLATFORM_POSIX
+		m_fd = -1;
+#endif // BASE_PLATFORM_*
+	}
+
+	bool PakFile::open(const base::FilePath& _filePath, bool _mapped)
+	{
+		BASE_ASSERT(!m_open, "Pak is already open.");
+
+		if (_mapped)
+		{
+			m_mapping = pakMap(_filePath);
+			if (NULL != m_mapping)
+			{
+				m_size = m_mapping->m_size;
+			}
+			else
+			{
+				BASE_TRACE("Failed to map pak %s, falling back to file reader.", _filePath.getCPtr() );
+			}
+		}
+
+		if (NULL == m_mapping)
+		{
+#if BASE_PLATFORM_WINDOWS
+			m_file = CreateFileA(_filePath.getCPtr(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+			if (INVALID_HANDLE_VALUE == m_file)
+			{
+				return false;
+			}
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(m_file, &size) )
+			{
+				CloseHandle(m_file);
+				m_file = INVALID_HANDLE_VALUE;
+				return false;
+			}
+
+			m_size = size.QuadPart;
+#elif BASE_PLATFORM_POSIX
+			m_fd = ::open(_filePath.getCPtr(), O_RDONLY);
+			if (-1 == m_fd)
+			{
+				return false;
+			}
+
+			struct stat st;
+			if (0 != fstat(m_fd, &st) )
+			{
+				::close(m_fd);
+				m_fd = -1;
+				return false;
+			}
+
+			m_size = I64(st.st_size);
+#else
+			if (!base::open(&m_reader, _filePath, base::ErrorIgnore{}) )
+			{
+				return false;
+			}
+
+			m_size = base::getSize(&m_reader);
+#endif // BASE_PLATFORM_*
+		}
+
+		m_open = true;
+
+		PakHeader header;
+		if (I32(sizeof(PakHeader) ) != read(0, &header, sizeof(PakHeader), base::ErrorIgnore{})
+		||  kPakMagic != header.magic
+		||  kPakVersion != header.version
+		||  I64(sizeof(PakHeader) ) + I64(header.numEntries) * I64(sizeof(PakEntryRef) ) > m_size)
+		{
+			BASE_TRACE("Pak %s is not valid pak, or was written by different version.", _filePath.getCPtr() );
+			close();
+			return false;
+		}
+
+		m_numEntries = header.numEntries;
+
+		if (NULL != m_mapping)
+		{
+			m_toc = (const PakEntryRef*)&m_mapping->m_data[sizeof(PakHeader)];
+		}
+		else
+		{
+			const I32 tocSize = I32(m_numEntries * sizeof(PakEntryRef) );
+			PakEntryRef* toc = (PakEntryRef*)base::alloc(entry::getAllocator(), base::max<I32>(tocSize, 1) );
+			m_toc = toc;
+
+			if (tocSize != read(sizeof(PakHeader), toc, tocSize, base::ErrorIgnore{}) )
+			{
+				BASE_TRACE("Failed to read table of contents of pak %s.", _filePath.getCPtr() );
+				close();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void PakFile::close()
+	{
+		if (!m_open)
+		{
+			return;
+		}
+
+		if (NULL != m_mapping)
+		{
+			pakMappingRelease(m_mapping);
+			m_mapping = NULL;
+		}
+		else
+		{
+			base::free(entry::getAllocator(), const_cast<PakEntryRef*>(m_toc) );
+
+#if BASE_PLATFORM_WINDOWS
+			CloseHandle(m_file);
+			m_file = INVALID_HANDLE_VALUE;
+#elif BASE_PLATFORM_POSIX
+			::close(m_fd);
+			m_fd = -1;
+#else
+			base::close(&m_reader);
+#endif // BASE_PLATFORM_*
+		}
+
+		m_toc = NULL;
+		m_numEntries = 0;
+		m_size = 0;
+		m_open = false;
+	}
+
+	I32 PakFile::read(I64 _offset, void* _data, I32 _size, base::Error* _err)
+	{
+		if (NULL != m_mapping)
+		{
+			const I64 remainder = base::max<I64>(m_size - _offset, 0);
+			const I32 size = I32(base::min<I64>(_size, remainder) );
+			base::memCopy(_data, &m_mapping->m_data[_offset], size);
+
+			if (size != _size)
+			{
+				BASE_ERROR_SET(_err, base::kErrorReaderWriterEof, "PakFile: EOF.");
+			}
+
+			return size;
+		}
+
+#if BASE_PLATFORM_WINDOWS || BASE_PLATFORM_POSIX
+		// Positional reads leave no shared state behind, concurrent reads of
+		// same pak don't need lock.
+		U8* data = (U8*)_data;
+		I32 total = 0;
+		while (total < _size)
+		{
+			const I64 offset = _offset + total;
+
+#	if BASE_PLATFORM_WINDOWS
+			OVERLAPPED overlapped = {};
+			overlapped.Offset     = DWORD(U64(offset) );
+			overlapped.OffsetHigh = DWORD(U64(offset) >> 32);
+
+			DWORD num = 0;
+			if (!ReadFile(m_file, &data[total], DWORD(_size - total), &num, &overlapped)
+			||  0 == num)
+			{
+				break;
+			}
+#	else
+			const ssize_t num = ::pread(m_fd, &data[total], size_t(_size - total), off_t(offset) );
+			if (0 > num
+			&&  EINTR == errno)
+			{
+				continue;
+			}
+
+			if (0 >= num)
+			{
+				break;
+			}
+#	endif // BASE_PLATFORM_WINDOWS
+
+			total += I32(num);
+		}
+
+		if (total != _size)
+		{
+			BASE_ERROR_SET(_err, base::kErrorReaderWriterEof, "PakFile: EOF.");
+		}
+
+		return total;
+#else
+		base::MutexScope scope(m_lock);
+		base::seek(&m_reader, _offset, base::Whence::Begin);
+		return base::read(&m_reader, _data, _size, _err);
+#endif // BASE_PLATFORM_*
+	}
+
+	const graphics::Memory* PakFile::makeRef(I64 _offset, U32 _size)
+	{
+		BASE_ASSERT(NULL != m_mapping, "Pak is not mapped.");
+		return pakMappingRef(m_mapping, _offset, _size);
+	}
+
+	const PakEntryRef* PakFile::find(U32 _hash) const
+	{
+		U32 first = 0;
+		U32 count = m_numEntries;
+
+		while (0 < count)
+		{
+			const U32 step = count / 2;
+			const U32 mid  = first + step;
+
+			if (m_toc[mid].hash < _hash)
+			{
+				first = mid + 1;
+				count -= step + 1;
+			}
+			else
+			{
+				count = step;
+			}
+		}
+
+		return first < m_numEntries && _hash == m_toc[first].hash
+			? &m_toc[first]
+			: NULL
+			;
+	}
+
+	PakReader::PakReader(PakFile* _pak, I64 _offset)
+		: m_pak(_pak)
+		, m_memory(NULL)
+		, m_pos(_offset)
+	{
+	}
+
+	PakReader::~PakReader()
+	{
+		if (NULL != m_memory)
+		{
+			pakMappingRelease(m_memory);
+		}
+	}
+
+	bool PakReader::open(const PakEntryRef& _entry, JobSystem* _jobSystem)
+	{
+		if (NULL != m_memory)
+		{
+			pakMappingRelease(m_memory);
+			m_memory = NULL;
+		}
+
+		m_pos = _entry.offset;
+
+		if (0 == (_entry.flags & MARA_PAK_ENTRY_COMPRESSED) )
+		{
+			return true;
+		}
+
+		if (_entry.offset + _entry.compressedSize > m_pak->getSize() )
+		{
+			return false;
+		}
+
+		// Compressed data is used in place when mapped, otherwise read in one go.
+		if (m_pak->isMapped() )
+		{
+			m_memory = pakDecompress(&m_pak->m_mapping->m_data[_entry.offset], _entry.compressedSize, _entry.size, _jobSystem);
+		}
+		else
+		{
+			U8* data = (U8*)base::alloc(entry::getAllocator(), base::max<U32>(_entry.compressedSize, 1) );
+
+			if (I32(_entry.compressedSize) == m_pak->read(_entry.offset, data, I32(_entry.compressedSize), base::ErrorIgnore{}) )
+			{
+				m_memory = pakDecompress(data, _entry.compressedSize, _entry.size, _jobSystem);
+			}
+
+			base::free(entry::getAllocator(), data);
+		}
+
+		m_pos = 0;
+		return NULL != m_memory;
+	}
+
+	I64 PakReader::seek(I64 _offset, base::Whence::Enum _whence)
+	{
+		const I64 size = NULL != m_memory
+			? m_memory->m_size
+			: m_pak->getSize()
+			;
+
+		switch (_whence)
+		{
+		case base::Whence::Begin:   m_pos = _offset;        break;
+		case base::Whence::Current: m_pos += _offset;       break;
+		case base::Whence::End:     m_pos = size - _offset; break;
+		}
+
+		m_pos = base::clamp<I64>(m_pos, 0, size);
+		return m_pos;
+	}
+
+	I32 PakReader::read(void* _data, I32 _size, base::Error* _err)
+	{
+		if (NULL != m_memory)
+		{
+			const I32 size = I32(base::min<I64>(_size, m_memory->m_size - m_pos) );
+			base::memCopy(_data, &m_memory->m_data[m_pos], size);
+			m_pos += size;
+
+			if (size != _size)
+			{
+				BASE_ERROR_SET(_err, base::kErrorReaderWriterEof, "PakReader: EOF.");
+			}
+
+			return size;
+		}
+
+		const I32 size = m_pak->read(m_pos, _data, _size, _err);
+		m_pos += size;
+		return size;
+	}
+
+	const graphics::Memory* PakReader::readMemory(U32 _size, base::Error* _err)
+	{
+		PakMapping* memory = NULL != m_memory
+			? m_memory
+			: m_pak->m_mapping
+			;
+
+		if (NULL != memory
+		&&  m_pos + _size <= memory->m_size)
+		{
+			const graphics::Memory* mem = pakMappingRef(memory, m_pos, _size);
+			m_pos += _size;
+			return mem;
+		}
+
+		const graphics::Memory* mem = graphics::alloc(_size);
+		read(mem->data, I32(_size), _err);
+		return mem;
+	}
+
+	U32 pakWriteCompressed(base::WriterI* _writer, const void* _data, U32 _size, U32 _blockSize, base::Error* _err)
+	{
+		const U32 numBlocks  = (_size + _blockSize - 1) / _blockSize;
+		const U32 headerSize = sizeof(U32) + numBlocks * sizeof(U32);
+		if (headerSize >= _size)
+		{
+			return 0;
+		}
+
+		// Blocks are compressed into scratch first, entry is written only if it got smaller.
+		U32* storedSizes = (U32*)base::alloc(entry::getAllocator(), numBlocks * sizeof(U32) );
+		U8* scratch = (U8*)base::alloc(entry::getAllocator(), numBlocks * lzCompressBound(_blockSize) );
+
+		const U8* src = (const U8*)_data;
+		U32 total = headerSize;
+		U32 offset = 0;
+		for (U32 ii = 0; ii < numBlocks && total < _size; ++ii)
+		{
+			const U32 size = base::min<U32>(_blockSize, _size - ii * _blockSize);
+			U32 stored = lzCompress(&scratch[offset], lzCompressBound(size), &src[ii * _blockSize], size);
+
+			if (0 == stored
+			||  stored >= size)
+			{
+				base::memCopy(&scratch[offset], &src[ii * _blockSize], size);
+				storedSizes[ii] = size | UINT32_C(0x80000000);
+				stored = size;
+			}
+			else
+			{
+				storedSizes[ii] = stored;
+			}
+
+			offset += stored;
+			total  += stored;
+		}
+
+		U32 written = 0;
+		if (total < _size)
+		{
+			base::write(_writer, &_blockSize, sizeof(U32), _err);
+			base::write(_writer, storedSizes, numBlocks * sizeof(U32), _err);
+			base::write(_writer, scratch, offset, _err);
+			written = total;
+		}
+
+		base::free(entry::getAllocator(), scratch);
+		base::free(entry::getAllocator(), storedSizes);
+		return written;
+	}
+
+} // namespace mara
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#ifndef MARA_PAK_H_HEADER_GUARD
+#define MARA_PAK_H_HEADER_GUARD
+
+#include <mara/mara.h>
+
+#include <base/file.h>
+#include <base/mutex.h>
+
+#define MARA_PAK_ENTRY_COMPRESSED UINT32_C(0x00000001) //!< Entry is stored as independently compressed blocks.
+
+namespace mara
+{
+	struct JobSystem;
+
+	/// Pak starts with header followed by table of contents, `numEntries`
+	/// entries sorted by hash. Table is read, or used directly from mapping,
+	/// as single block and searched in place.
+	///
+	struct PakHeader
+	{
+		U32 magic;
+		U32 version;
+		U32 numEntries;
+		U32 reserved;
+	};
+
+	static const U32 kPakMagic   = BASE_MAKEFOURCC('M', 'P', 'A', 'K');
+	static const U32 kPakVersion = 1;
+
+	/// Location of resource inside pak.
+	///
+	/// Compressed entry starts with block size (U32) and table of stored size
+	/// (U32) of each block, followed by block data. Stored size with top bit
+	/// set marks block kept uncompressed.
+	///
+	struct PakEntryRef
+	{
+		U32 hash;           //!< Hash of resource path.
+		U32 flags;          //!< `MARA_PAK_ENTRY_*` flags.
+		I64 offset;
+		U32 size;           //!< Uncompressed size.
+		U32 compressedSize; //!< Size stored in pak, same as `size` if entry is not compressed.
+	};
+
+	/// Read-only memory of whole mapped pak file, or of decompressed entry.
+	/// Reference counted, owner holds one reference and every `graphics::Memory`
+	/// referencing it holds another, so memory outlives `unloadPak` until
+	/// graphics is done with last payload.
+	///
+	struct PakMapping;
+
+	/// Open pak file. Either mapped, and then reads are plain memory copies and
+	/// payloads can reference mapping directly, or read with positional reads
+	/// that don't share file position, so any number of threads can read
+	/// different entries at the same time.
+	///
+	struct PakFile
+	{
+		PakFile();
+
+		/// Open pak at `_filePath`. When `_mapped` is true and platform supports
+		/// it, whole file is mapped, otherwise pak falls back to file reader.
+		/// Fails if header doesn't match current pak version.
+		bool open(const base::FilePath& _filePath, bool _mapped);
+
+		///
+		void close();
+
+		/// Read `_size` bytes at absolute `_offset` into `_data`. Thread safe,
+		/// only serialized on platforms without positional reads.
+		I32 read(I64 _offset, void* _data, I32 _size, base::Error* _err);
+
+		/// Memory referencing `_size` bytes at `_offset` directly inside mapping.
+		/// Pak must be mapped.
+		const graphics::Memory* makeRef(I64 _offset, U32 _size);
+
+		/// Returns entry of resource with path `_hash`, or NULL if pak doesn't
+		/// contain it. Binary search over table of contents.
+		const PakEntryRef* find(U32 _hash) const;
+
+		///
+		bool isMapped() const
+		{
+			return NULL != m_mapping;
+		}
+
+		///
+		I64 getSize() const
+		{
+			return m_size;
+		}
+
+#if BASE_PLATFORM_WINDOWS
+		void* m_file;       //!< File HANDLE, read at explicit offsets.
+#elif BASE_PLATFORM_POSIX
+		I32 m_fd;           //!< Read with `pread`.
+#else
+		base::FileReader m_reader;
+		base::Mutex m_lock; //!< Guards file reader position.
+#endif // BASE_PLATFORM_*
+		PakMapping* m_mapping;
+		const PakEntryRef* m_toc; //!< Points into mapping, or owned copy when not mapped.
+		U32 m_numEntries;
+		I64 m_size;
+		bool m_open;
+	};
+
+	/// Reader over pak file data, tracking its own position so entries can be
+	/// read without disturbing each other.
+	///
+	struct PakReader : public base::ReaderSeekerI
+	{
+		/// Reader over raw pak bytes, starting at `_offset`.
+		PakReader(PakFile* _pak, I64 _offset);
+
+		virtual ~PakReader();
+
+		/// Position reader at start of entry. Compressed entry is decompressed
+		/// into memory owned by reader first. Blocks are decompressed in
+		/// parallel on `_jobSystem` if calling thread can submit jobs to it.
+		bool open(const PakEntryRef& _entry, JobSystem* _jobSystem);
+
+		virtual I64 seek(I64 _offset = 0, base::Whence::Enum _whence = base::Whence::Current) override;
+		virtual I32 read(void* _data, I32 _size, base::Error* _err) override;
+
+		/// Read `_size` bytes of payload. Mapped pak or decompressed entry
+		/// returns reference into memory without copying, otherwise payload is
+		/// read into new memory.
+		const graphics::Memory* readMemory(U32 _size, base::Error* _err);
+
+		PakFile* m_pak;
+		PakMapping* m_memory; //!< Decompressed entry, NULL when reading directly from pak.
+		I64 m_pos;
+	};
+
+	/// Write `_size` bytes of `_data` as compressed entry, split into blocks of
+	/// `_blockSize` bytes.
+	///
+	/// @returns Number of bytes written, or 0 if data doesn't compress, and
+	///   nothing was written.
+	///
+	U32 pakWriteCompressed(base::WriterI* _writer, const void* _data, U32 _size, U32 _blockSize, base::Error* _err);
+
+	/// Payload read from generic reader, always copied.
+	inline const graphics::Memory* readMemory(base::ReaderSeekerI* _reader, U32 _size, base::Error* _err)
+	{
+		const graphics::Memory* mem = graphics::alloc(_size);
+		base::read(_reader, mem->data, _size, _err);
+		return mem;
+	}
+
+	/// Payload read from pak, zero-copy when pak is mapped.
+	inline const graphics::Memory* readMemory(PakReader* _reader, U32 _size, base::Error* _err)
+	{
+		return _reader->readMemory(_size, _err);
+	}
+
+} // namespace mara
+
+#endif // MARA_PAK_H_HEADER_GUARD
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#include "mara_p.h"
+
+namespace mara
+{
+	ResourceLoader::ResourceLoader()
+		: m_allocator(NULL)
+		, m_jobSystem(NULL)
+		, m_threads(NULL)
+		, m_numThreads(0)
+		, m_pendingHead(NULL)
+		, m_pendingTail(NULL)
+		, m_completed(NULL)
+		, m_numInFlight(0)
+		, m_exit(false)
+	{
+	}
+
+	void ResourceLoader::init(base::AllocatorI* _allocator, U32 _numThreads, JobSystem* _jobSystem)
+	{
+		m_allocator = _allocator;
+		m_jobSystem = _jobSystem;
+		m_numThreads = base::max<U32>(_numThreads, 1);
+		m_exit = false;
+	}
+
+	void ResourceLoader::shutdown()
+	{
+		if (NULL != m_threads)
+		{
+			m_exit = true;
+			m_pendingSem.post(m_numThreads);
+
+			for (U32 ii = 0; ii < m_numThreads; ++ii)
+			{
+				m_threads[ii].shutdown();
+				m_threads[ii].~Thread();
+			}
+
+			base::free(m_allocator, m_threads);
+			m_threads = NULL;
+		}
+
+		// Threads exit without draining queue, nothing is published after shutdown.
+		LoadRequest* lists[] = { m_pendingHead, m_completed };
+		for (U32 ii = 0; ii < BASE_COUNTOF(lists); ++ii)
+		{
+			for (LoadRequest* request = lists[ii]; NULL != request;)
+			{
+				LoadRequest* next = request->m_next;
+				delete request->m_resource;
+				release(request);
+				request = next;
+			}
+		}
+
+		m_pendingHead = NULL;
+		m_pendingTail = NULL;
+		m_completed = NULL;
+		m_numInFlight = 0;
+	}
+
+	void ResourceLoader::start()
+	{
+		m_threads = (base::Thread*)base::alloc(m_allocator, m_numThreads * sizeof(base::Thread) );
+		for (U32 ii = 0; ii < m_numThreads; ++ii)
+		{
+			base::Thread* thread = BASE_PLACEMENT_NEW(&m_threads[ii], base::Thread);
+			thread->init(threadFunc, this, 0, "mara loader");
+		}
+	}
+
+	LoadRequest* ResourceLoader::load(U16 _handle, U8 _type, ResourceI* _resource, ResourceReadFn _readFn, PakFile* _pak, const PakEntryRef& _entry)
+	{
+		// Threads are started by first request, so applications not loading
+		// asynchronously don't pay for them.
+		if (NULL == m_threads)
+		{
+			start();
+		}
+
+		LoadRequest* request = BASE_NEW(m_allocator, LoadRequest);
+		request->m_resource = _resource;
+		request->m_readFn = _readFn;
+		request->m_pak = _pak;
+		request->m_entry = _entry;
+		request->m_next = NULL;
+		request->m_handle = _handle;
+		request->m_type = _type;
+		request->m_ok = false;
+		request->m_cancelled = false;
+
+		base::atomicAddAndFetch<I32>(&m_numInFlight, 1);
+
+		{
+			base::MutexScope scope(m_lock);
+
+			if (NULL == m_pendingTail)
+			{
+				m_pendingHead = request;
+			}
+			else
+			{
+				m_pendingTail->m_next = request;
+			}
+
+			m_pendingTail = request;
+		}
+
+		m_pendingSem.post();
+		return request;
+	}
+
+	void ResourceLoader::cancel(LoadRequest* _request)
+	{
+		_request->m_cancelled = true;
+	}
+
+	LoadRequest* ResourceLoader::collect()
+	{
+		base::MutexScope scope(m_lock);
+
+		LoadRequest* request = m_completed;
+		if (NULL != request)
+		{
+			m_completed = request->m_next;
+			request->m_next = NULL;
+		}
+
+		return request;
+	}
+
+	void ResourceLoader::release(LoadRequest* _request)
+	{
+		BASE_DELETE(m_allocator, _request);
+	}
+
+	void ResourceLoader::waitCompleted()
+	{
+		if (0 != m_numInFlight)
+		{
+			m_completedSem.wait();
+		}
+	}
+
+	void ResourceLoader::waitIdle()
+	{
+		while (0 != m_numInFlight)
+		{
+			m_completedSem.wait();
+		}
+	}
+
+	I32 ResourceLoader::threadFunc(base::Thread* _thread, void* _userData)
+	{
+		BASE_UNUSED(_thread);
+
+		ResourceLoader* loader = (ResourceLoader*)_userData;
+
+		if (!loader->m_jobSystem->attach() )
+		{
+			BASE_TRACE("Loader thread failed to attach to job system, entries are decompressed serially.");
+		}
+
+		for (;;)
+		{
+			loader->m_pendingSem.wait();
+
+			if (loader->m_exit)
+			{
+				break;
+			}
+
+			LoadRequest* request;
+			{
+				base::MutexScope scope(loader->m_lock);
+
+				request = loader->m_pendingHead;
+				if (NULL == request)
+				{
+					continue;
+				}
+
+				loader->m_pendingHead = request->m_next;
+				if (NULL == loader->m_pendingHead)
+				{
+					loader->m_pendingTail = NULL;
+				}
+			}
+
+			PakReader reader(request->m_pak, 0);
+			request->m_ok = reader.open(request->m_entry, loader->m_jobSystem)
+				&& request->m_readFn(request->m_resource, &reader)
+				;
+
+			{
+				base::MutexScope scope(loader->m_lock);
+
+				request->m_next = loader->m_completed;
+				loader->m_completed = request;
+			}
+
+			base::atomicSubAndFetch<I32>(&loader->m_numInFlight, 1);
+			loader->m_completedSem.post();
+		}
+
+		return 0;
+	}
+
+} // namespace mara
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#ifndef MARA_RESOURCE_LOADER_H_HEADER_GUARD
+#define MARA_RESOURCE_LOADER_H_HEADER_GUARD
+
+#include <mara/mara.h>
+
+#include <base/thread.h>
+#include <base/semaphore.h>
+#include <base/mutex.h>
+
+#include "pak.h"
+
+namespace mara
+{
+	struct JobSystem;
+
+	/// Deserializes resource from pak reader, returns false on error.
+	typedef bool (*ResourceReadFn)(ResourceI* _resource, PakReader* _reader);
+
+	struct LoadRequest
+	{
+		ResourceI* m_resource;
+		ResourceReadFn m_readFn;
+		PakFile* m_pak;
+		PakEntryRef m_entry;
+		LoadRequest* m_next;
+		U16 m_handle;
+		U8 m_type;        //!< Resource type, opaque to loader.
+		bool m_ok;
+		bool m_cancelled; //!< Resource was destroyed before request completed.
+	};
+
+	/// Reads and deserializes pak entries on dedicated loader threads, so file
+	/// I/O never blocks the main thread or job workers. Requests are submitted
+	/// and completed requests collected on main thread only.
+	///
+	struct ResourceLoader
+	{
+		ResourceLoader();
+
+		/// Loader threads attach to `_jobSystem`, so they can decompress
+		/// entries in parallel.
+		void init(base::AllocatorI* _allocator, U32 _numThreads, JobSystem* _jobSystem);
+		void shutdown();
+
+		/// Queue read of pak entry into `_resource`.
+		LoadRequest* load(U16 _handle, U8 _type, ResourceI* _resource, ResourceReadFn _readFn, PakFile* _pak, const PakEntryRef& _entry);
+
+		/// Mark request as cancelled, its resource is deleted when collected.
+		void cancel(LoadRequest* _request);
+
+		/// Returns completed request or NULL. Returned request must be released
+		/// with `release`.
+		LoadRequest* collect();
+
+		///
+		void release(LoadRequest* _request);
+
+		/// Block until at least one request completes since last wait.
+		void waitCompleted();
+
+		/// Block until all queued requests are completed.
+		void waitIdle();
+
+		///
+		U32 getNumInFlight() const
+		{
+			return U32(m_numInFlight);
+		}
+
+		void start();
+
+		static I32 threadFunc(base::Thread* _thread, void* _userData);
+
+		base::AllocatorI* m_allocator;
+		JobSystem* m_jobSystem;
+		base::Thread* m_threads;
+		U32 m_numThreads;
+
+		base::Mutex m_lock;
+		base::Semaphore m_pendingSem;
+		base::Semaphore m_completedSem;
+		LoadRequest* m_pendingHead;
+		LoadRequest* m_pendingTail;
+		LoadRequest* m_completed;
+		volatile I32 m_numInFlight;
+		volatile bool m_exit;
+	};
+
+} // namespace mara
+
+#endif // MARA_RESOURCE_LOADER_H_HEADER_GUARD
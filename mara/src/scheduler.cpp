@@ -0,0 +1,144 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#include "mara_p.h"
+
+namespace mara
+{
+	static bool isConflicting(const SystemRef& _a, const SystemRef& _b)
+	{
+		return maskIntersects(_a.m_write, _b.m_read | _b.m_write)
+			|| maskIntersects(_b.m_write, _a.m_read)
+			;
+	}
+
+	SystemScheduler::SystemScheduler()
+		: m_numSystems(0)
+		, m_jobSystem(NULL)
+	{
+	}
+
+	void SystemScheduler::init(JobSystem* _jobSystem)
+	{
+		m_jobSystem = _jobSystem;
+
+		for (U16 ii = 0; ii < MARA_CONFIG_MAX_SYSTEMS; ++ii)
+		{
+			m_tasks[ii].m_scheduler = this;
+			m_tasks[ii].m_system = ii;
+		}
+	}
+
+	void SystemScheduler::shutdown()
+	{
+		m_jobSystem = NULL;
+	}
+
+	SystemHandle SystemScheduler::registerSystem(const char* _name, SystemFn _fn, const ComponentMask& _read, const ComponentMask& _write, void* _userData)
+	{
+		SystemHandle handle = { m_systemHandle.alloc() };
+
+		if (isValid(handle))
+		{
+			SystemRef& sr = m_systems[handle.idx];
+			sr.m_name = _name;
+			sr.m_fn = _fn;
+			sr.m_userData = _userData;
+			sr.m_read = _read;
+			sr.m_write = _write;
+
+			m_order[m_numSystems++] = handle.idx;
+
+			return handle;
+		}
+
+		BASE_TRACE("Failed to create system handle.");
+		return MARA_INVALID_HANDLE;
+	}
+
+	void SystemScheduler::destroySystem(SystemHandle _handle)
+	{
+		for (U16 ii = 0; ii < m_numSystems; ++ii)
+		{
+			if (m_order[ii] == _handle.idx)
+			{
+				// Keep registration order, it decides direction of dependencies.
+				base::memMove(&m_order[ii], &m_order[ii + 1], (m_numSystems - ii - 1) * sizeof(U16) );
+				--m_numSystems;
+
+				m_systemHandle.free(_handle.idx);
+				return;
+			}
+		}
+
+		BASE_WARN(false, "System %d is not registered.", _handle.idx);
+	}
+
+	void SystemScheduler::push(U16 _system)
+	{
+		m_jobSystem->run(systemJob, &m_tasks[_system], &m_counter);
+	}
+
+	void SystemScheduler::systemJob(void* _userData)
+	{
+		const Task* task = (const Task*)_userData;
+		SystemScheduler* scheduler = task->m_scheduler;
+		const U16 system = task->m_system;
+
+		const SystemRef& sr = scheduler->m_systems[scheduler->m_order[system] ];
+		{
+			MARA_PROFILER_SCOPE(sr.m_name, 0xff00ffff);
+			sr.m_fn(sr.m_userData);
+		}
+
+		// Dependents are dispatched before this job completes, counter can't reach zero early.
+		for (U16 ii = 0, num = scheduler->m_numDependents[system]; ii < num; ++ii)
+		{
+			const U16 dependent = scheduler->m_dependents[system][ii];
+			if (0 == base::atomicSubAndFetch<I32>(&scheduler->m_pending[dependent], 1) )
+			{
+				scheduler->push(dependent);
+			}
+		}
+	}
+
+	void SystemScheduler::run()
+	{
+		if (0 == m_numSystems)
+		{
+			return;
+		}
+
+		// Build dependency graph, indices are positions in registration order.
+		for (U16 jj = 0; jj < m_numSystems; ++jj)
+		{
+			const SystemRef& sr = m_systems[m_order[jj] ];
+
+			m_numDependents[jj] = 0;
+			m_pending[jj] = 0;
+
+			for (U16 ii = 0; ii < jj; ++ii)
+			{
+				if (isConflicting(m_systems[m_order[ii] ], sr) )
+				{
+					m_dependents[ii][m_numDependents[ii]++] = jj;
+					++m_pending[jj];
+				}
+			}
+		}
+
+		for (U16 ii = 0; ii < m_numSystems; ++ii)
+		{
+			if (0 == m_pending[ii])
+			{
+				push(ii);
+			}
+		}
+
+		// Calling thread helps out until every system finished.
+		m_jobSystem->wait(&m_counter);
+	}
+
+} // namespace mara
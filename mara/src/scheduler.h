@@ -0,0 +1,75 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#ifndef MARA_SCHEDULER_H_HEADER_GUARD
+#define MARA_SCHEDULER_H_HEADER_GUARD
+
+#include <mara/mara.h>
+
+#include "job.h"
+
+namespace mara
+{
+	struct SystemRef
+	{
+		const char* m_name;
+		SystemFn m_fn;
+		void* m_userData;
+		ComponentMask m_read;
+		ComponentMask m_write;
+	};
+
+	/// Runs registered systems once per frame. Each frame a dependency graph is
+	/// built from declared component access, a system depends on every earlier
+	/// registered system it conflicts with. Systems without pending dependencies
+	/// are dispatched as jobs, finishing system dispatches dependents that
+	/// became ready.
+	///
+	struct SystemScheduler
+	{
+		SystemScheduler();
+
+		void init(JobSystem* _jobSystem);
+		void shutdown();
+
+		SystemHandle registerSystem(const char* _name, SystemFn _fn, const ComponentMask& _read, const ComponentMask& _write, void* _userData);
+		void destroySystem(SystemHandle _handle);
+
+		/// Run all systems and wait for them to finish.
+		void run();
+
+		U16 getNumSystems() const
+		{
+			return m_numSystems;
+		}
+
+		static void systemJob(void* _userData);
+
+		void push(U16 _system);
+
+		base::HandleAllocT<MARA_CONFIG_MAX_SYSTEMS> m_systemHandle;
+		SystemRef m_systems[MARA_CONFIG_MAX_SYSTEMS];
+
+		U16 m_order[MARA_CONFIG_MAX_SYSTEMS]; //!< Systems in registration order.
+		U16 m_numSystems;
+
+		U16 m_dependents[MARA_CONFIG_MAX_SYSTEMS][MARA_CONFIG_MAX_SYSTEMS];
+		U16 m_numDependents[MARA_CONFIG_MAX_SYSTEMS];
+		volatile I32 m_pending[MARA_CONFIG_MAX_SYSTEMS];
+
+		struct Task
+		{
+			SystemScheduler* m_scheduler;
+			U16 m_system;
+		};
+
+		Task m_tasks[MARA_CONFIG_MAX_SYSTEMS];
+		JobCounter m_counter;
+		JobSystem* m_jobSystem;
+	};
+
+} // namespace mara
+
+#endif // MARA_SCHEDULER_H_HEADER_GUARD
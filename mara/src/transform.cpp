@@ -0,0 +1,549 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#include "mara_p.h"
+
+namespace mara
+{
+	static const U32 kTransformGrainSize = 256;
+
+	/// 4x4 matrix multiply, `_result` = `_a` * `_b`. All matrices must be 16 byte aligned.
+	static void mtxMulAligned(F32* _result, const F32* _a, const F32* _b)
+	{
+#if MARA_SIMD_SSE
+		const __m128 b0 = _mm_load_ps(&_b[ 0]);
+		const __m128 b1 = _mm_load_ps(&_b[ 4]);
+		const __m128 b2 = _mm_load_ps(&_b[ 8]);
+		const __m128 b3 = _mm_load_ps(&_b[12]);
+
+		for (U32 ii = 0; ii < 16; ii += 4)
+		{
+			__m128 row = _mm_mul_ps(_mm_set1_ps(_a[ii + 0]), b0);
+			row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(_a[ii + 1]), b1) );
+			row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(_a[ii + 2]), b2) );
+			row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(_a[ii + 3]), b3) );
+			_mm_store_ps(&_result[ii], row);
+		}
+#elif MARA_SIMD_NEON
+		const float32x4_t b0 = vld1q_f32(&_b[ 0]);
+		const float32x4_t b1 = vld1q_f32(&_b[ 4]);
+		const float32x4_t b2 = vld1q_f32(&_b[ 8]);
+		const float32x4_t b3 = vld1q_f32(&_b[12]);
+
+		for (U32 ii = 0; ii < 16; ii += 4)
+		{
+			float32x4_t row = vmulq_n_f32(b0, _a[ii + 0]);
+			row = vmlaq_n_f32(row, b1, _a[ii + 1]);
+			row = vmlaq_n_f32(row, b2, _a[ii + 2]);
+			row = vmlaq_n_f32(row, b3, _a[ii + 3]);
+			vst1q_f32(&_result[ii], row);
+		}
+#else
+		base::mtxMul(_result, _a, _b);
+#endif // MARA_SIMD_SSE
+	}
+
+	TransformSystem::TransformSystem()
+		: m_allocator(NULL)
+		, m_jobSystem(NULL)
+		, m_local(NULL)
+		, m_world(NULL)
+		, m_parent(NULL)
+		, m_parentEntity(NULL)
+		, m_entity(NULL)
+		, m_dirty(NULL)
+		, m_num(0)
+		, m_capacity(0)
+		, m_numDirty(0)
+		, m_sorted(true)
+		, m_numLevels(0)
+		, m_index(NULL)
+		, m_indexSize(0)
+		, m_firstChild(NULL)
+		, m_nextSibling(NULL)
+		, m_prevSibling(NULL)
+	{
+	}
+
+	void TransformSystem::init(base::AllocatorI* _allocator, JobSystem* _jobSystem)
+	{
+		m_allocator = _allocator;
+		m_jobSystem = _jobSystem;
+	}
+
+	void TransformSystem::shutdown()
+	{
+		base::free(m_allocator, m_local, 16);
+		base::free(m_allocator, m_world, 16);
+		base::free(m_allocator, m_parent);
+		base::free(m_allocator, m_parentEntity);
+		base::free(m_allocator, m_entity);
+		base::free(m_allocator, m_dirty);
+		base::free(m_allocator, m_index);
+		base::free(m_allocator, m_firstChild);
+		base::free(m_allocator, m_nextSibling);
+		base::free(m_allocator, m_prevSibling);
+
+		m_local = NULL;
+		m_world = NULL;
+		m_parent = NULL;
+		m_parentEntity = NULL;
+		m_entity = NULL;
+		m_dirty = NULL;
+		m_num = 0;
+		m_capacity = 0;
+		m_numDirty = 0;
+		m_numLevels = 0;
+		m_sorted = true;
+		m_index = NULL;
+		m_indexSize = 0;
+		m_firstChild = NULL;
+		m_nextSibling = NULL;
+		m_prevSibling = NULL;
+	}
+
+	void TransformSystem::grow(U32 _capacity)
+	{
+		// Aligned memory can't be reallocated in place, copy matrices over.
+		F32* local = (F32*)base::alloc(m_allocator, _capacity * 16 * sizeof(F32), 16);
+		F32* world = (F32*)base::alloc(m_allocator, _capacity * 16 * sizeof(F32), 16);
+		if (0 != m_num)
+		{
+			base::memCopy(local, m_local, m_num * 16 * sizeof(F32) );
+			base::memCopy(world, m_world, m_num * 16 * sizeof(F32) );
+		}
+
+		base::free(m_allocator, m_local, 16);
+		base::free(m_allocator, m_world, 16);
+		m_local = local;
+		m_world = world;
+
+		m_parent       = (U32*)base::realloc(m_allocator, m_parent, _capacity * sizeof(U32) );
+		m_parentEntity = (EntityHandle*)base::realloc(m_allocator, m_parentEntity, _capacity * sizeof(EntityHandle) );
+		m_entity       = (EntityHandle*)base::realloc(m_allocator, m_entity, _capacity * sizeof(EntityHandle) );
+		m_dirty        = (U8*)base::realloc(m_allocator, m_dirty, _capacity * sizeof(U8) );
+		m_capacity = _capacity;
+	}
+
+	bool TransformSystem::add(EntityHandle _entity, EntityHandle _parent)
+	{
+		if (has(_entity) )
+		{
+			BASE_WARN(false, "Entity already has transform.");
+			return false;
+		}
+
+		if (m_num == m_capacity)
+		{
+			grow(base::min<U32>(base::max<U32>(m_capacity * 2, 256), MARA_CONFIG_MAX_ENTITIES) );
+		}
+
+		if (_entity.idx >= m_indexSize)
+		{
+			const U32 indexSize = base::max<U32>(base::max<U32>(m_indexSize * 2, 256), _entity.idx + 1);
+			m_index       = (U32*)base::realloc(m_allocator, m_index, indexSize * sizeof(U32) );
+			m_firstChild  = (EntityHandle*)base::realloc(m_allocator, m_firstChild, indexSize * sizeof(EntityHandle) );
+			m_nextSibling = (EntityHandle*)base::realloc(m_allocator, m_nextSibling, indexSize * sizeof(EntityHandle) );
+			m_prevSibling = (EntityHandle*)base::realloc(m_allocator, m_prevSibling, indexSize * sizeof(EntityHandle) );
+
+			const U32 num = indexSize - m_indexSize;
+			base::memSet(&m_index[m_indexSize], 0xff, num * sizeof(U32) );
+			base::memSet(&m_firstChild[m_indexSize], 0xff, num * sizeof(EntityHandle) );
+			base::memSet(&m_nextSibling[m_indexSize], 0xff, num * sizeof(EntityHandle) );
+			base::memSet(&m_prevSibling[m_indexSize], 0xff, num * sizeof(EntityHandle) );
+			m_indexSize = indexSize;
+		}
+
+		const U32 idx = m_num++;
+		base::mtxIdentity(&m_local[idx * 16]);
+		base::mtxIdentity(&m_world[idx * 16]);
+		m_parent[idx] = UINT32_MAX;
+		m_parentEntity[idx] = MARA_INVALID_HANDLE;
+		m_entity[idx] = _entity;
+		m_dirty[idx] = 1;
+		m_index[_entity.idx] = idx;
+
+		++m_numDirty;
+		m_sorted = false;
+
+		if (isValid(_parent) )
+		{
+			return setParent(_entity, _parent);
+		}
+
+		return true;
+	}
+
+	void TransformSystem::remove(EntityHandle _entity)
+	{
+		const U32 idx = find(_entity);
+		if (UINT32_MAX == idx)
+		{
+			return;
+		}
+
+		unlink(_entity);
+
+		// Swap remove, order is restored by sort on next update.
+		const U32 last = --m_num;
+		if (idx != last)
+		{
+			base::memCopy(&m_local[idx * 16], &m_local[last * 16], 16 * sizeof(F32) );
+			base::memCopy(&m_world[idx * 16], &m_world[last * 16], 16 * sizeof(F32) );
+			m_parentEntity[idx] = m_parentEntity[last];
+			m_entity[idx] = m_entity[last];
+			m_dirty[idx] = m_dirty[last];
+			m_index[m_entity[idx].idx] = idx;
+		}
+
+		// Children become roots.
+		for (EntityHandle child = m_firstChild[_entity.idx]; isValid(child);)
+		{
+			const EntityHandle next = m_nextSibling[child.idx];
+			const U32 childIdx = m_index[child.idx];
+
+			m_parentEntity[childIdx] = MARA_INVALID_HANDLE;
+			m_dirty[childIdx] = 1;
+			m_nextSibling[child.idx] = MARA_INVALID_HANDLE;
+			m_prevSibling[child.idx] = MARA_INVALID_HANDLE;
+
+			child = next;
+		}
+
+		m_firstChild[_entity.idx] = MARA_INVALID_HANDLE;
+		m_index[_entity.idx] = UINT32_MAX;
+
+		m_numDirty = m_num;
+		m_sorted = false;
+	}
+
+	bool TransformSystem::setParent(EntityHandle _entity, EntityHandle _parent)
+	{
+		const U32 idx = find(_entity);
+		if (UINT32_MAX == idx)
+		{
+			return false;
+		}
+
+		if (isValid(_parent) )
+		{
+			// Walk up from new parent, hierarchy must stay acyclic. Levels above entity are
+			// counted, so whole subtree can be checked against depth limit.
+			U32 depth = 0;
+			for (EntityHandle ancestor = _parent; isValid(ancestor); ancestor = m_parentEntity[m_index[ancestor.idx] ], ++depth)
+			{
+				if (!has(ancestor) )
+				{
+					BASE_WARN(false, "Parent entity doesn't have transform.");
+					return false;
+				}
+
+				if (ancestor.idx == _entity.idx)
+				{
+					BASE_WARN(false, "Entity can't be parented to itself or its descendant.");
+					return false;
+				}
+			}
+
+			if (depth + getHeight(_entity) >= MARA_CONFIG_MAX_TRANSFORM_DEPTH)
+			{
+				BASE_WARN(false, "Transform hierarchy too deep, increase MARA_CONFIG_MAX_TRANSFORM_DEPTH.");
+				return false;
+			}
+		}
+
+		unlink(_entity);
+		m_parentEntity[idx] = _parent;
+		link(_entity, _parent);
+		if (0 == m_dirty[idx])
+		{
+			m_dirty[idx] = 1;
+			++m_numDirty;
+		}
+
+		m_sorted = false;
+		return true;
+	}
+
+	U32 TransformSystem::getHeight(EntityHandle _entity) const
+	{
+		// Depth first walk over child and sibling links, climbing back through parents.
+		U32 height = 0;
+		U32 depth = 0;
+		EntityHandle node = _entity;
+		for (;;)
+		{
+			if (isValid(m_firstChild[node.idx]) )
+			{
+				node = m_firstChild[node.idx];
+				height = base::max<U32>(height, ++depth);
+				continue;
+			}
+
+			while (node.idx != _entity.idx
+			&&     !isValid(m_nextSibling[node.idx]) )
+			{
+				node = m_parentEntity[m_index[node.idx] ];
+				--depth;
+			}
+
+			if (node.idx == _entity.idx)
+			{
+				return height;
+			}
+
+			node = m_nextSibling[node.idx];
+		}
+	}
+
+	void TransformSystem::link(EntityHandle _entity, EntityHandle _parent)
+	{
+		if (!isValid(_parent) )
+		{
+			return;
+		}
+
+		const EntityHandle next = m_firstChild[_parent.idx];
+		if (isValid(next) )
+		{
+			m_prevSibling[next.idx] = _entity;
+		}
+
+		m_nextSibling[_entity.idx] = next;
+		m_prevSibling[_entity.idx] = MARA_INVALID_HANDLE;
+		m_firstChild[_parent.idx] = _entity;
+	}
+
+	void TransformSystem::unlink(EntityHandle _entity)
+	{
+		const EntityHandle parent = m_parentEntity[m_index[_entity.idx] ];
+		if (!isValid(parent) )
+		{
+			return;
+		}
+
+		const EntityHandle prev = m_prevSibling[_entity.idx];
+		const EntityHandle next = m_nextSibling[_entity.idx];
+
+		if (isValid(prev) )
+		{
+			m_nextSibling[prev.idx] = next;
+		}
+		else
+		{
+			m_firstChild[parent.idx] = next;
+		}
+
+		if (isValid(next) )
+		{
+			m_prevSibling[next.idx] = prev;
+		}
+
+		m_nextSibling[_entity.idx] = MARA_INVALID_HANDLE;
+		m_prevSibling[_entity.idx] = MARA_INVALID_HANDLE;
+	}
+
+	EntityHandle TransformSystem::getParent(EntityHandle _entity) const
+	{
+		const U32 idx = find(_entity);
+		if (UINT32_MAX == idx)
+		{
+			EntityHandle invalid = MARA_INVALID_HANDLE;
+			return invalid;
+		}
+
+		return m_parentEntity[idx];
+	}
+
+	void TransformSystem::setLocal(EntityHandle _entity, const F32* _mtx)
+	{
+		const U32 idx = find(_entity);
+		if (UINT32_MAX == idx)
+		{
+			return;
+		}
+
+		base::memCopy(&m_local[idx * 16], _mtx, 16 * sizeof(F32) );
+		if (0 == m_dirty[idx])
+		{
+			// Systems may write local matrices of different entities concurrently.
+			m_dirty[idx] = 1;
+			base::atomicAddAndFetch<U32>(&m_numDirty, 1);
+		}
+	}
+
+	const F32* TransformSystem::getLocal(EntityHandle _entity) const
+	{
+		const U32 idx = find(_entity);
+		return UINT32_MAX != idx ? &m_local[idx * 16] : NULL;
+	}
+
+	const F32* TransformSystem::getWorld(EntityHandle _entity) const
+	{
+		const U32 idx = find(_entity);
+		return UINT32_MAX != idx ? &m_world[idx * 16] : NULL;
+	}
+
+	void TransformSystem::sort()
+	{
+		m_sorted = true;
+		m_numLevels = 0;
+
+		if (0 == m_num)
+		{
+			return;
+		}
+
+		// Depth of every node, walking up until node with known depth is found.
+		U16* depth = (U16*)base::alloc(m_allocator, m_num * sizeof(U16) );
+		U32* stack = (U32*)base::alloc(m_allocator, MARA_CONFIG_MAX_TRANSFORM_DEPTH * sizeof(U32) );
+		base::memSet(depth, 0xff, m_num * sizeof(U16) );
+
+		U32 count[MARA_CONFIG_MAX_TRANSFORM_DEPTH] = {};
+		for (U32 ii = 0; ii < m_num; ++ii)
+		{
+			U32 num = 0;
+			U32 node = ii;
+			U16 nodeDepth = 0;
+			while (UINT16_MAX == depth[node])
+			{
+				BASE_ASSERT(num < MARA_CONFIG_MAX_TRANSFORM_DEPTH, "Transform hierarchy deeper than MARA_CONFIG_MAX_TRANSFORM_DEPTH.");
+				stack[num++] = node;
+
+				const EntityHandle parent = m_parentEntity[node];
+				if (!isValid(parent) )
+				{
+					break;
+				}
+
+				node = m_index[parent.idx];
+				if (UINT16_MAX != depth[node])
+				{
+					nodeDepth = depth[node] + 1;
+				}
+			}
+
+			while (0 != num)
+			{
+				const U32 top = stack[--num];
+				BASE_ASSERT(nodeDepth < MARA_CONFIG_MAX_TRANSFORM_DEPTH, "Transform hierarchy deeper than MARA_CONFIG_MAX_TRANSFORM_DEPTH.");
+				depth[top] = nodeDepth++;
+				++count[depth[top] ];
+			}
+		}
+
+		// Counting sort by depth, order within level is kept.
+		U32 levelBegin[MARA_CONFIG_MAX_TRANSFORM_DEPTH];
+		U32 offset = 0;
+		for (U32 ii = 0; ii < MARA_CONFIG_MAX_TRANSFORM_DEPTH; ++ii)
+		{
+			levelBegin[ii] = offset;
+			offset += count[ii];
+			m_levelEnd[ii] = offset;
+
+			if (0 != count[ii])
+			{
+				m_numLevels = ii + 1;
+			}
+		}
+
+		F32* local = (F32*)base::alloc(m_allocator, m_capacity * 16 * sizeof(F32), 16);
+		F32* world = (F32*)base::alloc(m_allocator, m_capacity * 16 * sizeof(F32), 16);
+		EntityHandle* parentEntity = (EntityHandle*)base::alloc(m_allocator, m_capacity * sizeof(EntityHandle) );
+		EntityHandle* entity = (EntityHandle*)base::alloc(m_allocator, m_capacity * sizeof(EntityHandle) );
+		U8* dirty = (U8*)base::alloc(m_allocator, m_capacity * sizeof(U8) );
+
+		for (U32 ii = 0; ii < m_num; ++ii)
+		{
+			const U32 dst = levelBegin[depth[ii] ]++;
+			base::memCopy(&local[dst * 16], &m_local[ii * 16], 16 * sizeof(F32) );
+			base::memCopy(&world[dst * 16], &m_world[ii * 16], 16 * sizeof(F32) );
+			parentEntity[dst] = m_parentEntity[ii];
+			entity[dst] = m_entity[ii];
+			dirty[dst] = m_dirty[ii];
+			m_index[entity[dst].idx] = dst;
+		}
+
+		base::free(m_allocator, m_local, 16);
+		base::free(m_allocator, m_world, 16);
+		base::free(m_allocator, m_parentEntity);
+		base::free(m_allocator, m_entity);
+		base::free(m_allocator, m_dirty);
+		base::free(m_allocator, stack);
+		base::free(m_allocator, depth);
+
+		m_local = local;
+		m_world = world;
+		m_parentEntity = parentEntity;
+		m_entity = entity;
+		m_dirty = dirty;
+
+		for (U32 ii = 0; ii < m_num; ++ii)
+		{
+			m_parent[ii] = isValid(m_parentEntity[ii]) ? m_index[m_parentEntity[ii].idx] : UINT32_MAX;
+		}
+	}
+
+	void TransformSystem::updateRange(U32 _begin, U32 _end, void* _userData)
+	{
+		TransformSystem* ts = (TransformSystem*)_userData;
+
+		for (U32 ii = _begin; ii < _end; ++ii)
+		{
+			const U32 parent = ts->m_parent[ii];
+			if (UINT32_MAX == parent)
+			{
+				if (0 != ts->m_dirty[ii])
+				{
+					base::memCopy(&ts->m_world[ii * 16], &ts->m_local[ii * 16], 16 * sizeof(F32) );
+				}
+			}
+			else if (0 != ts->m_dirty[ii]
+				 ||  0 != ts->m_dirty[parent])
+			{
+				// Parent is on previous level, already finished. Dirty flag carries over to children.
+				ts->m_dirty[ii] = 1;
+				mtxMulAligned(&ts->m_world[ii * 16], &ts->m_local[ii * 16], &ts->m_world[parent * 16]);
+			}
+		}
+	}
+
+	void TransformSystem::update()
+	{
+		if (!m_sorted)
+		{
+			sort();
+		}
+
+		if (0 == m_numDirty)
+		{
+			return;
+		}
+
+		MARA_PROFILER_SCOPE("mara::TransformSystem::update", 0xff00ffff);
+
+		for (U32 level = 0; level < m_numLevels; ++level)
+		{
+			const U32 begin = 0 == level ? 0 : m_levelEnd[level - 1];
+			const U32 end = m_levelEnd[level];
+
+			if (NULL != m_jobSystem
+			&&  end - begin > kTransformGrainSize)
+			{
+				JobCounter counter;
+				m_jobSystem->parallelFor(begin, end, kTransformGrainSize, updateRange, this, &counter);
+				m_jobSystem->wait(&counter);
+			}
+			else
+			{
+				updateRange(begin, end, this);
+			}
+		}
+
+		base::memSet(m_dirty, 0, m_num);
+		m_numDirty = 0;
+	}
+
+} // namespace mara
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2023 Marcus Madland. All rights reserved.
+ * License: https://github.com/MarcusMadland/mara/blob/main/LICENSE
+ */
+
+#ifndef MARA_TRANSFORM_H_HEADER_GUARD
+#define MARA_TRANSFORM_H_HEADER_GUARD
+
+#include <mara/mara.h>
+
+namespace mara
+{
+	struct JobSystem;
+
+	/// Parent/child transform hierarchy. Nodes are stored sorted by depth, so
+	/// world matrices can be computed one level at a time, with every node of
+	/// a level processed in parallel. Only nodes with dirty local matrix, or
+	/// with dirty ancestor, are recomputed.
+	///
+	struct TransformSystem
+	{
+		TransformSystem();
+
+		void init(base::AllocatorI* _allocator, JobSystem* _jobSystem);
+		void shutdown();
+
+		bool add(EntityHandle _entity, EntityHandle _parent);
+		void remove(EntityHandle _entity);
+		bool has(EntityHandle _entity) const
+		{
+			return UINT32_MAX != find(_entity);
+		}
+
+		/// Node index of entity, UINT32_MAX if entity has no transform.
+		U32 find(EntityHandle _entity) const
+		{
+			return _entity.idx < m_indexSize ? m_index[_entity.idx] : UINT32_MAX;
+		}
+
+		bool setParent(EntityHandle _entity, EntityHandle _parent);
+		EntityHandle getParent(EntityHandle _entity) const;
+
+		void setLocal(EntityHandle _entity, const F32* _mtx);
+		const F32* getLocal(EntityHandle _entity) const;
+		const F32* getWorld(EntityHandle _entity) const;
+
+		/// Recompute world matrices of dirty subtrees.
+		void update();
+
+		U32 getNum() const
+		{
+			return m_num;
+		}
+
+		/// Number of levels below entity, 0 for leaf.
+		U32 getHeight(EntityHandle _entity) const;
+
+		void link(EntityHandle _entity, EntityHandle _parent);
+		void unlink(EntityHandle _entity);
+		void grow(U32 _capacity);
+		void sort();
+		static void updateRange(U32 _begin, U32 _end, void* _userData);
+
+		base::AllocatorI* m_allocator;
+		JobSystem* m_jobSystem;
+
+		F32* m_local;                 //!< Local matrices, 16 floats per node.
+		F32* m_world;                 //!< World matrices, 16 floats per node.
+		U32* m_parent;                //!< Index of parent node, UINT32_MAX for roots. Valid when sorted.
+		EntityHandle* m_parentEntity; //!< Parent entity, invalid for roots.
+		EntityHandle* m_entity;
+		U8* m_dirty;                  //!< Non zero if world matrix must be recomputed.
+
+		U32 m_num;
+		U32 m_capacity;
+		U32 m_numDirty;
+		bool m_sorted;
+
+		U32 m_levelEnd[MARA_CONFIG_MAX_TRANSFORM_DEPTH];
+		U32 m_numLevels;
+
+		U32* m_index;     //!< Entity to node index, sized by highest entity with transform.
+		U32 m_indexSize;
+
+		// Child lists, indexed by entity like `m_index`, so they don't move when nodes are sorted.
+		EntityHandle* m_firstChild;
+		EntityHandle* m_nextSibling;
+		EntityHandle* m_prevSibling;
+	};
+
+} // namespace mara
+
+#endif // MARA_TRANSFORM_H_HEADER_GUARD